@@ -0,0 +1,163 @@
+// 连接池借还的竞争测试：8~64 个线程争抢 8 个连接
+// 1. list: 原来的 Sem + Mutex + std::list<MYSQL*>，每次 push_back 都会分配节点
+// 2. lock_free: Lock_Free_Stack 的无锁快路径 + 信号量慢路径（Connection_Pool 现在的实现）
+// 3. sticky: 每个线程独占一个连接，借还不访问共享状态（线程数多于连接数时其余线程走 lock_free）
+// 用法: ./bench/conn_pool_bench [每个线程的借还次数]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <atomic>
+#include <list>
+#include <vector>
+#include <pthread.h>
+#include "../lock/locker.h"
+#include "../lock/lock_free_stack.h"
+
+
+static const int POOL_SIZE = 8;     // 与 main.cpp 中的连接数一致
+static int iterations = 200000;
+
+
+// 1. 原来的实现
+class List_Pool {
+private:
+    std::list<void*> m_list;
+    Mutex m_mutex;
+    Sem m_sem;
+
+public:
+    List_Pool(int size) : m_sem(size) {
+        for (int i = 0; i < size; ++i) m_list.push_back((void*)(long)(i + 1));
+    }
+
+    void* get() {
+        m_sem.wait_sem();
+        m_mutex.lock();
+        void* conn = m_list.front();
+        m_list.pop_front();
+        m_mutex.unlock();
+        return conn;
+    }
+
+    void release(void* conn) {
+        m_mutex.lock();
+        m_list.push_back(conn);
+        m_mutex.unlock();
+        m_sem.post_sem();
+    }
+};
+
+
+// 2. 无锁实现
+class Stack_Pool {
+private:
+    Lock_Free_Stack<void*> m_stack;
+    std::atomic<int> m_bound;
+    int m_size;
+
+public:
+    Stack_Pool(int size) : m_stack(size), m_bound(0), m_size(size) {
+        for (int i = 0; i < size; ++i) m_stack.push((void*)(long)(i + 1));
+    }
+
+    // 与 Connection_Pool::bindThreadConnection() 一样，至少留一个共享连接
+    bool try_bind(void*& conn) {
+        if (++m_bound >= m_size || !m_stack.try_pop(conn)) {
+            --m_bound;
+            return false;
+        }
+        return true;
+    }
+
+    void* get() {
+        void* conn = NULL;
+        m_stack.pop_wait(conn);
+        return conn;
+    }
+
+    void release(void* conn) { m_stack.push(conn); }
+};
+
+
+// 3. 每次借到连接后模拟一小段查询的工作量
+static void simulate_query() {
+    for (volatile int i = 0; i < 50; ++i) {}
+}
+
+struct Bench_Arg {
+    int mode;
+    void* pool;
+};
+
+static void* bench_thread(void* arg) {
+    Bench_Arg* bench = (Bench_Arg*)arg;
+
+    if (bench->mode == 0) {
+        List_Pool* pool = (List_Pool*)bench->pool;
+        for (int i = 0; i < iterations; ++i) {
+            void* conn = pool->get();
+            simulate_query();
+            pool->release(conn);
+        }
+    }
+    else {
+        Stack_Pool* pool = (Stack_Pool*)bench->pool;
+        void* sticky = NULL;
+        if (bench->mode == 2) pool->try_bind(sticky);
+
+        for (int i = 0; i < iterations; ++i) {
+            void* conn = sticky ? sticky : pool->get();
+            simulate_query();
+            if (conn != sticky) pool->release(conn);
+        }
+
+        if (sticky) pool->release(sticky);
+    }
+
+    return NULL;
+}
+
+
+// 4. 运行一轮，返回每秒的借还次数
+static double run(int mode, int thread_num) {
+    List_Pool list_pool(POOL_SIZE);
+    Stack_Pool stack_pool(POOL_SIZE);
+
+    Bench_Arg arg;
+    arg.mode = mode;
+    arg.pool = (mode == 0) ? (void*)&list_pool : (void*)&stack_pool;
+
+    std::vector<pthread_t> tids(thread_num);
+    struct timespec begin, end;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+
+    for (int i = 0; i < thread_num; ++i) {
+        pthread_create(&tids[i], NULL, bench_thread, &arg);
+    }
+    for (int i = 0; i < thread_num; ++i) {
+        pthread_join(tids[i], NULL);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double seconds = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+    return (double)thread_num * iterations / seconds;
+}
+
+
+int main(int argc, char* argv[]) {
+    if (argc > 1) iterations = atoi(argv[1]);
+
+    const char* names[3] = {"list", "lock_free", "sticky"};
+    int threads[4] = {8, 16, 32, 64};
+
+    printf("%-10s %8s %16s\n", "mode", "threads", "ops/sec");
+    for (int t = 0; t < 4; ++t) {
+        for (int mode = 0; mode < 3; ++mode) {
+            printf("%-10s %8d %16.0f\n", names[mode], threads[t], run(mode, threads[t]));
+        }
+    }
+
+    return 0;
+}
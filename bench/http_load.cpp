@@ -0,0 +1,876 @@
+// HTTP 压测工具：多个线程，每个线程一个 epoll 和一个 timerfd，管理一部分连接
+// 1. 连接：keep-alive 时一个连接上连续发请求；close 时每个请求新建一个连接，等服务器写完应答关闭后再建下一个
+//    pipeline 为 keep-alive 时每个连接上最多同时未完成的请求数
+// 2. 请求：按比例混合 GET 静态文件（默认 /judge.html）、POST /2CGISQL.cgi 登录、POST /3CGISQL.cgi 注册，
+//    与 do_request() 的 url 规则相同；登录用开始前注册的用户，注册每次用一个新的用户名
+// 3. 发送节奏：rate > 0 时为开环，每个连接按固定间隔安排计划发送时间（总速率为 rate），不管之前的请求有没有完成；
+//    连接上未完成的请求达到 pipeline 时推迟发送，但延迟仍然从计划发送时间算起（修正 coordinated omission：
+//    服务器卡住的这段时间里本该发出的请求都计入等待时间，而不是只有卡住的那一个）；
+//    rate = 0 时为闭环，收到应答就发下一个，延迟从实际发送时间算起
+// 4. 直方图与 /metrics 相同（metrics/metrics.h，相对误差不超过 1/16），输出 req/s、p50/p99/p999，开环时再输出没有修正的 p99 作对比
+// 5. --suite：在回环地址上启动服务器（server 端口 local，工作目录为临时目录，DOC_ROOT 指向 ./root），
+//    依次运行一组场景：先用闭环测出最大吞吐，再以它的 50%、90% 做开环
+// 注意：服务器每次只处理读缓冲区中的第一个请求，keep-alive 时写完应答就清空读缓冲区，同一次读到的后续请求会被丢掉，
+//       所以 pipeline 大于 1 时后面的请求会超时（计入 timeout），套件中不测 pipeline
+// 用法:
+//   ./bench/http_load [-t 线程数] [-c 连接数] [-d 秒数] [-r 总速率 req/s，0 为闭环] [-p pipeline] [-k 1|0 (keep-alive|close)]
+//                     [-m get:login:register，默认 1:0:0] [-u GET 的路径] 主机:端口
+//   ./bench/http_load --suite [服务器程序，默认 ./main] [每个场景的秒数，默认 5]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <sys/wait.h>
+#include <deque>
+#include <string>
+#include <vector>
+#include "../metrics/metrics.h"
+
+using namespace std;
+
+
+static const long long REQUEST_TIMEOUT_NS = 2000000000LL;     // 连接上超过这个时间没有任何进展时，未完成的请求计为超时
+static const char* LOGIN_USER = "http_load";
+static const char* LOGIN_PASSWORD = "http_load";
+
+
+static long long now_ns() {
+    return metrics_now_ns();
+}
+
+
+// 1. 请求的种类
+enum Request_Kind {
+    REQ_GET = 0,
+    REQ_LOGIN,
+    REQ_REGISTER,
+    REQ_KIND_NUM
+};
+
+static const char* KIND_NAMES[REQ_KIND_NUM] = {"get", "login", "register"};
+
+
+// 2. 一个场景的参数
+struct Load_Config {
+    const char* name;
+    int threads;
+    int connections;
+    double duration_s;
+    double rate;                        // 2.1 总速率（req/s），0 为闭环
+    int pipeline;                       // 2.2 keep-alive 时每个连接上最多同时未完成的请求数
+    bool keep_alive;
+    int mix[REQ_KIND_NUM];              // 2.3 get:login:register 的比例
+    const char* get_url;
+};
+
+
+// 3. 一个场景的结果（所有线程合并）
+struct Load_Result {
+    Histogram_Snapshot latency;                 // 3.1 开环时从计划发送时间算起，闭环时从实际发送时间算起
+    Histogram_Snapshot raw;                     // 3.2 从实际发送时间算起
+    Histogram_Snapshot kinds[REQ_KIND_NUM];     // 3.3 按请求种类分开，同 latency
+    unsigned long long completed;
+    unsigned long long non_2xx;
+    unsigned long long status_503;
+    unsigned long long errors;                  // 3.4 连接失败、连接被关闭时还有未完成的请求
+    unsigned long long timeouts;
+    double elapsed_s;
+
+    Load_Result() : completed(0), non_2xx(0), status_503(0), errors(0), timeouts(0), elapsed_s(0) {}
+
+    double rps() const { return elapsed_s > 0 ? completed / elapsed_s : 0; }
+};
+
+
+// 4. 一个未完成的请求
+struct Pending {
+    long long intended_ns;              // 4.1 计划发送的时间
+    long long sent_ns;                  // 4.2 实际交给 send() 的时间，0 表示还在等连接建立
+    int kind;
+};
+
+
+// 5. 一个连接
+struct Load_Conn {
+    int index;                          // 5.1 在线程的连接数组中的下标（epoll 事件中带着它）
+    int global;                         // 5.1 在所有连接中的序号，决定开环时第一个请求的计划发送时间
+    int fd;
+    unsigned int gen;                   // 5.2 每次新建 socket 加一，过滤掉已经关闭的 socket 在同一批 epoll 事件中剩下的事件
+    bool connected;
+    bool closing;                       // 5.3 close 模式：应答读完，等服务器关闭
+    bool want_out;
+    long long next_ns;                  // 5.4 开环：下一个请求的计划发送时间
+    long long progress_ns;              // 5.5 最后一次建立连接、读到数据或者空闲时发出请求的时间，用于超时
+    deque<Pending> pending;
+    string out;
+    size_t out_off;
+    char in[8192];
+    int in_len;
+    long long body_left;                // 5.6 当前应答还没有读到的消息体字节数，-1 表示在读头部
+    int status;
+    bool close_after;                   // 5.7 当前应答带有 Connection: close
+};
+
+
+// 6. 一个线程
+struct Load_Worker {
+    const Load_Config* config;
+    struct sockaddr_in addr;
+    int id;
+    pthread_t tid;
+    int epollfd;
+    int timerfd;
+    long long armed_ns;
+    long long start_ns;
+    long long end_ns;
+    long long interval_ns;              // 6.1 开环：每个连接两个请求之间的间隔
+    unsigned long long rng;
+    unsigned long long register_seq;
+    int mix_total;
+    vector<Load_Conn> conns;
+
+    Latency_Histogram latency;
+    Latency_Histogram raw;
+    Latency_Histogram kinds[REQ_KIND_NUM];
+    unsigned long long completed;
+    unsigned long long non_2xx;
+    unsigned long long status_503;
+    unsigned long long errors;
+    unsigned long long timeouts;
+    long long last_done_ns;
+};
+
+
+// 7. 拼接请求
+static void build_request(Load_Worker* w, int kind, string& out) {
+    const Load_Config* config = w->config;
+    char host[64];
+    snprintf(host, sizeof(host), "%s:%d", inet_ntoa(w->addr.sin_addr), ntohs(w->addr.sin_port));
+    const char* connection = config->keep_alive ? "keep-alive" : "close";
+
+    char buf[512];
+    if (kind == REQ_GET) {
+        snprintf(buf, sizeof(buf), "GET %s HTTP/1.1\r\nHost: %s\r\nConnection: %s\r\nUser-Agent: http_load\r\n\r\n",
+                 config->get_url, host, connection);
+    }
+    else {
+        char body[128];
+        if (kind == REQ_LOGIN) snprintf(body, sizeof(body), "user=%s&password=%s", LOGIN_USER, LOGIN_PASSWORD);
+        else snprintf(body, sizeof(body), "user=u%d_%d_%llu&password=http_load", (int)getpid(), w->id, ++w->register_seq);
+
+        snprintf(buf, sizeof(buf), "POST /%cCGISQL.cgi HTTP/1.1\r\nHost: %s\r\nConnection: %s\r\nUser-Agent: http_load\r\n"
+                 "Content-Type: application/x-www-form-urlencoded\r\nContent-Length: %d\r\n\r\n%s",
+                 kind == REQ_LOGIN ? '2' : '3', host, connection, (int)strlen(body), body);
+    }
+    out += buf;
+}
+
+
+static int pick_kind(Load_Worker* w) {
+    w->rng ^= w->rng << 13;
+    w->rng ^= w->rng >> 7;
+    w->rng ^= w->rng << 17;
+
+    int r = (int)(w->rng % w->mix_total);
+    for (int k = 0; k < REQ_KIND_NUM; ++k) {
+        if (r < w->config->mix[k]) return k;
+        r -= w->config->mix[k];
+    }
+    return REQ_GET;
+}
+
+
+// 8. 连接的建立、关闭和 epoll 事件
+static void update_events(Load_Worker* w, Load_Conn& c) {
+    bool want_out = !c.connected || c.out_off < c.out.size();
+    if (want_out == c.want_out) return;
+
+    struct epoll_event event;
+    event.data.u64 = ((unsigned long long)c.index << 32) | c.gen;
+    event.events = want_out ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+    epoll_ctl(w->epollfd, EPOLL_CTL_MOD, c.fd, &event);
+    c.want_out = want_out;
+}
+
+// 8.1 failed 为 true 时，未完成的请求计为错误
+static void conn_close(Load_Worker* w, Load_Conn& c, bool failed) {
+    if (c.fd >= 0) {
+        epoll_ctl(w->epollfd, EPOLL_CTL_DEL, c.fd, NULL);
+        close(c.fd);
+        c.fd = -1;
+    }
+    if (failed) w->errors += c.pending.size();
+    c.pending.clear();
+    c.out.clear();
+    c.out_off = 0;
+    c.in_len = 0;
+    c.body_left = -1;
+    c.connected = false;
+    c.closing = false;
+}
+
+static bool conn_open(Load_Worker* w, Load_Conn& c) {
+    c.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (c.fd < 0) {
+        conn_close(w, c, true);
+        return false;
+    }
+    int on = 1;
+    setsockopt(c.fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+    if (connect(c.fd, (struct sockaddr*)&w->addr, sizeof(w->addr)) < 0 && errno != EINPROGRESS) {
+        conn_close(w, c, true);
+        return false;
+    }
+
+    ++c.gen;
+    c.connected = false;
+    c.want_out = true;
+    c.progress_ns = now_ns();
+
+    struct epoll_event event;
+    event.data.u64 = ((unsigned long long)c.index << 32) | c.gen;
+    event.events = EPOLLIN | EPOLLOUT;
+    epoll_ctl(w->epollfd, EPOLL_CTL_ADD, c.fd, &event);
+    return true;
+}
+
+
+// 9. 把缓冲的请求写出去，发送缓冲区满时等 EPOLLOUT
+static void conn_flush(Load_Worker* w, Load_Conn& c) {
+    if (c.fd < 0 || !c.connected) return;
+
+    long long now = now_ns();
+    for (size_t i = c.pending.size(); i > 0 && c.pending[i - 1].sent_ns == 0; --i) c.pending[i - 1].sent_ns = now;
+
+    while (c.out_off < c.out.size()) {
+        ssize_t n = send(c.fd, c.out.data() + c.out_off, c.out.size() - c.out_off, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            conn_close(w, c, true);
+            return;
+        }
+        c.out_off += n;
+    }
+    if (c.out_off == c.out.size()) {
+        c.out.clear();
+        c.out_off = 0;
+    }
+    update_events(w, c);
+}
+
+
+// 10. 发出到期的请求：开环时按计划发送时间，闭环时把连接上的请求数补到 pipeline
+static void conn_issue(Load_Worker* w, Load_Conn& c, long long now) {
+    if (c.closing) return;
+
+    const Load_Config* config = w->config;
+    int limit = config->keep_alive ? config->pipeline : 1;
+    bool added = false;
+    bool idle = c.pending.empty();
+
+    while ((int)c.pending.size() < limit) {
+        long long intended = now;
+        if (config->rate > 0) {
+            if (c.next_ns > now || c.next_ns >= w->end_ns) break;
+            intended = c.next_ns;
+            c.next_ns += w->interval_ns;
+        }
+        else if (now >= w->end_ns) break;
+
+        Pending p = {intended, 0, pick_kind(w)};
+        build_request(w, p.kind, c.out);
+        c.pending.push_back(p);
+        added = true;
+    }
+
+    if (!added) return;
+
+    // 空闲的长连接上 progress_ns 是上一个应答的时间，超时从这个请求开始算
+    if (idle) c.progress_ns = now;
+    if (c.fd < 0 && !conn_open(w, c)) return;
+    conn_flush(w, c);
+}
+
+
+// 11. 一个应答读完
+static void conn_complete(Load_Worker* w, Load_Conn& c, long long now) {
+    if (c.pending.empty()) {
+        // 没有发过的请求收到了应答（例如过载时主线程直接回复的 503）
+        ++w->errors;
+        conn_close(w, c, false);
+        return;
+    }
+
+    Pending p = c.pending.front();
+    c.pending.pop_front();
+
+    w->latency.record(now - p.intended_ns);
+    w->raw.record(now - p.sent_ns);
+    w->kinds[p.kind].record(now - p.intended_ns);
+    ++w->completed;
+    if (c.status < 200 || c.status >= 300) ++w->non_2xx;
+    if (c.status == 503) ++w->status_503;
+    w->last_done_ns = now;
+
+    if (!w->config->keep_alive || c.close_after) {
+        // 服务器写完就关闭：剩下的请求不会有应答；等服务器先关闭，TIME_WAIT 留在服务器一端
+        w->errors += c.pending.size();
+        c.pending.clear();
+        c.out.clear();
+        c.out_off = 0;
+        c.closing = true;
+        return;
+    }
+    conn_issue(w, c, now);
+}
+
+
+// 12. 解析读到的应答：只看状态码、Content-Length 和 Connection，消息体直接丢掉
+static bool conn_parse(Load_Worker* w, Load_Conn& c, long long now) {
+    while (c.fd >= 0 && c.in_len > 0) {
+        if (c.body_left < 0) {
+            c.in[c.in_len] = '\0';
+            char* end = strstr(c.in, "\r\n\r\n");
+            if (end == NULL) return c.in_len < (int)sizeof(c.in) - 1;
+
+            c.status = 0;
+            sscanf(c.in, "HTTP/1.%*d %d", &c.status);
+            c.body_left = 0;
+            c.close_after = false;
+
+            *end = '\0';
+            for (char* line = strstr(c.in, "\r\n"); line != NULL; line = strstr(line, "\r\n")) {
+                line += 2;
+                if (strncasecmp(line, "Content-Length:", 15) == 0) c.body_left = atoll(line + 15);
+                else if (strncasecmp(line, "Connection:", 11) == 0) c.close_after = strstr(line + 11, "close") != NULL;
+            }
+
+            int header_len = end + 4 - c.in;
+            c.in_len -= header_len;
+            memmove(c.in, c.in + header_len, c.in_len);
+        }
+
+        int take = c.body_left < c.in_len ? (int)c.body_left : c.in_len;
+        c.body_left -= take;
+        c.in_len -= take;
+        memmove(c.in, c.in + take, c.in_len);
+        if (c.body_left > 0) return true;
+
+        c.body_left = -1;
+        conn_complete(w, c, now);
+    }
+    return true;
+}
+
+
+static void conn_readable(Load_Worker* w, Load_Conn& c) {
+    while (c.fd >= 0) {
+        ssize_t n = recv(c.fd, c.in + c.in_len, sizeof(c.in) - 1 - c.in_len, 0);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+            conn_close(w, c, true);
+            return;
+        }
+        if (n == 0) {
+            // 服务器关闭连接：还有未完成的请求时计为错误（例如读缓冲区清空后被丢掉的 pipeline 请求超时之前）
+            conn_close(w, c, !c.pending.empty());
+            return;
+        }
+
+        long long now = now_ns();
+        c.progress_ns = now;
+        c.in_len += n;
+        if (!conn_parse(w, c, now)) {
+            // 头部比读缓冲区还大
+            conn_close(w, c, true);
+            return;
+        }
+    }
+}
+
+
+static void conn_writable(Load_Worker* w, Load_Conn& c) {
+    if (!c.connected) {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if (getsockopt(c.fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0 || err != 0) {
+            conn_close(w, c, true);
+            return;
+        }
+        c.connected = true;
+    }
+    conn_flush(w, c);
+}
+
+
+// 13. 线程的主循环：每一轮检查超时、发出到期的请求，把 timerfd 定到最近的计划发送时间，然后等 epoll 事件
+static void* load_worker(void* arg) {
+    Load_Worker* w = (Load_Worker*)arg;
+    const Load_Config* config = w->config;
+
+    for (size_t i = 0; i < w->conns.size(); ++i) {
+        Load_Conn& c = w->conns[i];
+        if (config->rate > 0) c.next_ns = w->start_ns + (long long)(c.global * 1e9 / config->rate);
+    }
+
+    int limit = config->keep_alive ? config->pipeline : 1;
+    struct epoll_event events[256];
+
+    while (true) {
+        long long now = now_ns();
+        long long wake = (now < w->end_ns) ? w->end_ns : LLONG_MAX;
+        bool active = false;
+
+        for (size_t i = 0; i < w->conns.size(); ++i) {
+            Load_Conn& c = w->conns[i];
+            if ((!c.pending.empty() || c.closing) && now - c.progress_ns > REQUEST_TIMEOUT_NS) {
+                w->timeouts += c.pending.size();
+                conn_close(w, c, false);
+            }
+
+            conn_issue(w, c, now);
+
+            if (!c.pending.empty() || c.closing) {
+                active = true;
+                if (c.progress_ns + REQUEST_TIMEOUT_NS < wake) wake = c.progress_ns + REQUEST_TIMEOUT_NS + 1;
+            }
+            if (config->rate > 0 && (int)c.pending.size() < limit && !c.closing && c.next_ns < w->end_ns && c.next_ns < wake) {
+                wake = c.next_ns;
+            }
+        }
+        if (now >= w->end_ns && !active) break;
+
+        if (wake != w->armed_ns) {
+            struct itimerspec spec;
+            memset(&spec, 0, sizeof(spec));
+            spec.it_value.tv_sec = wake / 1000000000LL;
+            spec.it_value.tv_nsec = wake % 1000000000LL;
+            timerfd_settime(w->timerfd, TFD_TIMER_ABSTIME, &spec, NULL);
+            w->armed_ns = wake;
+        }
+
+        int n = epoll_wait(w->epollfd, events, 256, -1);
+        for (int i = 0; i < n; ++i) {
+            unsigned long long data = events[i].data.u64;
+            if (data == ~0ULL) {
+                unsigned long long expirations;
+                if (::read(w->timerfd, &expirations, sizeof(expirations)) < 0) { }
+                w->armed_ns = 0;
+                continue;
+            }
+
+            Load_Conn& c = w->conns[data >> 32];
+            if (c.fd < 0 || c.gen != (unsigned int)data) continue;
+
+            if (events[i].events & (EPOLLOUT | EPOLLERR)) conn_writable(w, c);
+            if (c.fd >= 0 && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) conn_readable(w, c);
+        }
+    }
+
+    for (size_t i = 0; i < w->conns.size(); ++i) conn_close(w, w->conns[i], false);
+    return NULL;
+}
+
+
+// 14. keep-alive 时先把所有连接建立好再开始计时，连接建立的时间（例如服务器 listen 队列满时 SYN 重传）不计入请求的延迟
+static void connect_all(vector<Load_Worker*>& workers) {
+    long long deadline = now_ns() + REQUEST_TIMEOUT_NS;
+    for (size_t t = 0; t < workers.size(); ++t) {
+        for (size_t i = 0; i < workers[t]->conns.size(); ++i) conn_open(workers[t], workers[t]->conns[i]);
+    }
+
+    struct epoll_event events[256];
+    for (size_t t = 0; t < workers.size(); ++t) {
+        Load_Worker* w = workers[t];
+        while (now_ns() < deadline) {
+            bool connecting = false;
+            for (size_t i = 0; i < w->conns.size() && !connecting; ++i) connecting = w->conns[i].fd >= 0 && !w->conns[i].connected;
+            if (!connecting) break;
+
+            int n = epoll_wait(w->epollfd, events, 256, 10);
+            for (int i = 0; i < n; ++i) {
+                unsigned long long data = events[i].data.u64;
+                if (data == ~0ULL) continue;
+                Load_Conn& c = w->conns[data >> 32];
+                if (c.fd >= 0 && c.gen == (unsigned int)data && (events[i].events & (EPOLLOUT | EPOLLERR))) conn_writable(w, c);
+            }
+        }
+    }
+}
+
+
+// 15. 运行一个场景
+static bool run_load(const Load_Config& config, const struct sockaddr_in& addr, Load_Result& result) {
+    int threads = config.threads < config.connections ? config.threads : config.connections;
+    vector<Load_Worker*> workers;
+
+    int mix_total = 0;
+    for (int k = 0; k < REQ_KIND_NUM; ++k) mix_total += config.mix[k];
+    if (threads <= 0 || mix_total <= 0) return false;
+
+    for (int t = 0; t < threads; ++t) {
+        Load_Worker* w = new Load_Worker();
+        w->config = &config;
+        w->addr = addr;
+        w->id = t;
+        w->epollfd = epoll_create1(0);
+        w->timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+        w->armed_ns = 0;
+        w->interval_ns = config.rate > 0 ? (long long)(config.connections * 1e9 / config.rate) : 0;
+        w->rng = 0x9e3779b97f4a7c15ULL * (t + 1);
+        w->register_seq = 0;
+        w->mix_total = mix_total;
+        w->completed = w->non_2xx = w->status_503 = w->errors = w->timeouts = 0;
+        w->last_done_ns = 0;
+
+        struct epoll_event event;
+        event.data.u64 = ~0ULL;
+        event.events = EPOLLIN;
+        epoll_ctl(w->epollfd, EPOLL_CTL_ADD, w->timerfd, &event);
+
+        // 连接交错地分给各个线程，开环时每个线程的发送时间也是均匀的
+        for (int i = t; i < config.connections; i += threads) {
+            Load_Conn c;
+            c.index = (int)w->conns.size();
+            c.global = i;
+            c.fd = -1;
+            c.gen = 0;
+            c.connected = c.closing = c.want_out = c.close_after = false;
+            c.next_ns = 0;
+            c.progress_ns = 0;
+            c.out_off = 0;
+            c.in_len = 0;
+            c.body_left = -1;
+            c.status = 0;
+            w->conns.push_back(c);
+        }
+        workers.push_back(w);
+    }
+
+    if (config.keep_alive) connect_all(workers);
+
+    long long start = now_ns() + 10000000LL;
+    long long end = start + (long long)(config.duration_s * 1e9);
+    for (int t = 0; t < threads; ++t) {
+        workers[t]->start_ns = start;
+        workers[t]->end_ns = end;
+        pthread_create(&workers[t]->tid, NULL, load_worker, workers[t]);
+    }
+
+    long long last_done = end;
+    result = Load_Result();
+    for (int t = 0; t < threads; ++t) {
+        Load_Worker* w = workers[t];
+        pthread_join(w->tid, NULL);
+
+        result.latency.merge(w->latency);
+        result.raw.merge(w->raw);
+        for (int k = 0; k < REQ_KIND_NUM; ++k) result.kinds[k].merge(w->kinds[k]);
+        result.completed += w->completed;
+        result.non_2xx += w->non_2xx;
+        result.status_503 += w->status_503;
+        result.errors += w->errors;
+        result.timeouts += w->timeouts;
+        if (w->last_done_ns > last_done) last_done = w->last_done_ns;
+
+        close(w->epollfd);
+        close(w->timerfd);
+        delete w;
+    }
+    result.elapsed_s = (last_done - start) / 1e9;
+    return true;
+}
+
+
+// 16. 输出：每个场景一行，延迟的单位为毫秒；混合请求时再按种类各输出一行
+static void print_header() {
+    printf("%-44s %10s %9s %9s %9s %9s %8s %8s\n", "scenario", "req/s", "p50(ms)", "p99(ms)", "p999(ms)", "raw p99",
+           "non-2xx", "errors");
+}
+
+static void print_result(const Load_Config& config, const Load_Result& r) {
+    char raw[32] = "-";
+    if (config.rate > 0) snprintf(raw, sizeof(raw), "%.3f", r.raw.percentile(99) / 1e6);
+
+    printf("%-44s %10.0f %9.3f %9.3f %9.3f %9s %8llu %8llu\n", config.name, r.rps(), r.latency.percentile(50) / 1e6,
+           r.latency.percentile(99) / 1e6, r.latency.percentile(99.9) / 1e6, raw, r.non_2xx, r.errors + r.timeouts);
+
+    int kinds = 0;
+    for (int k = 0; k < REQ_KIND_NUM; ++k) kinds += config.mix[k] > 0;
+    for (int k = 0; k < REQ_KIND_NUM && kinds > 1; ++k) {
+        const Histogram_Snapshot& h = r.kinds[k];
+        if (h.count == 0) continue;
+        printf("  %-42s %10.0f %9.3f %9.3f %9.3f\n", KIND_NAMES[k], r.elapsed_s > 0 ? h.count / r.elapsed_s : 0,
+               h.percentile(50) / 1e6, h.percentile(99) / 1e6, h.percentile(99.9) / 1e6);
+    }
+    if (r.status_503 > 0 || r.timeouts > 0) printf("  503: %llu, timeouts: %llu\n", r.status_503, r.timeouts);
+    fflush(stdout);
+}
+
+
+// 17. 阻塞地发一个请求（Connection: close），返回状态码，失败时返回 -1
+static int http_once(const struct sockaddr_in& addr, const char* request) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+
+    struct timeval timeout = {2, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    if (connect(fd, (const struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+        send(fd, request, strlen(request), MSG_NOSIGNAL) != (ssize_t)strlen(request)) {
+        close(fd);
+        return -1;
+    }
+
+    char head[64] = {0};
+    char buf[4096];
+    int len = 0;
+    ssize_t n;
+    while ((n = recv(fd, buf, sizeof(buf), 0)) > 0) {
+        int k = (int)sizeof(head) - 1 - len;
+        if (k > n) k = (int)n;
+        memcpy(head + len, buf, k);
+        len += k;
+    }
+    close(fd);
+
+    int status = -1;
+    sscanf(head, "HTTP/1.%*d %d", &status);
+    return status;
+}
+
+// 17.1 注册登录用的用户，已经存在时服务器返回 registerError.html，状态码同样是 200
+static int register_login_user(const struct sockaddr_in& addr) {
+    char body[128], request[512];
+    snprintf(body, sizeof(body), "user=%s&password=%s", LOGIN_USER, LOGIN_PASSWORD);
+    snprintf(request, sizeof(request), "POST /3CGISQL.cgi HTTP/1.1\r\nHost: %s:%d\r\nConnection: close\r\n"
+             "Content-Type: application/x-www-form-urlencoded\r\nContent-Length: %d\r\n\r\n%s",
+             inet_ntoa(addr.sin_addr), ntohs(addr.sin_port), (int)strlen(body), body);
+    return http_once(addr, request);
+}
+
+
+static bool parse_addr(const char* text, struct sockaddr_in& addr) {
+    char host[64];
+    int port = 0;
+    if (sscanf(text, "%63[^:]:%d", host, &port) != 2 || port <= 0 || port > 65535) return false;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    return inet_pton(AF_INET, strcmp(host, "localhost") == 0 ? "127.0.0.1" : host, &addr.sin_addr) == 1;
+}
+
+// 让内核分配一个空闲端口
+static int free_port() {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+
+    int port = 0;
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0 && getsockname(fd, (struct sockaddr*)&addr, &len) == 0) {
+        port = ntohs(addr.sin_port);
+    }
+    close(fd);
+    return port;
+}
+
+
+// 18. 套件：启动服务器，依次运行各个场景，最后用 SIGTERM 停止服务器
+static int run_suite(const char* server, double duration) {
+    char server_path[PATH_MAX], doc_root[PATH_MAX];
+    if (realpath(server, server_path) == NULL) {
+        fprintf(stderr, "server %s is not found, build it first: make main\n", server);
+        return 1;
+    }
+    const char* doc_env = getenv("DOC_ROOT");
+    if (doc_env != NULL) snprintf(doc_root, sizeof(doc_root), "%s", doc_env);
+    else if (realpath("./root", doc_root) == NULL) {
+        fprintf(stderr, "./root is not found, run in the repository or set DOC_ROOT\n");
+        return 1;
+    }
+
+    // 18.1 服务器的工作目录：日志、本地存储的用户表、标准输出都放在这里
+    char work_dir[] = "/tmp/http_load.XXXXXX";
+    char path[PATH_MAX];
+    if (mkdtemp(work_dir) == NULL) {
+        fprintf(stderr, "mkdtemp is error, errno: %d\n", errno);
+        return 1;
+    }
+    snprintf(path, sizeof(path), "%s/log", work_dir);
+    mkdir(path, 0755);
+
+    int port = free_port();
+    pid_t pid = fork();
+    if (pid == 0) {
+        snprintf(path, sizeof(path), "%s/server.out", work_dir);
+        int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (chdir(work_dir) < 0 || fd < 0) _exit(127);
+        dup2(fd, STDOUT_FILENO);
+        dup2(fd, STDERR_FILENO);
+        setenv("DOC_ROOT", doc_root, 1);
+
+        char port_text[16];
+        snprintf(port_text, sizeof(port_text), "%d", port);
+        execl(server_path, server_path, port_text, "local", (char*)NULL);
+        _exit(127);
+    }
+
+    // 18.2 等服务器开始监听
+    struct sockaddr_in addr;
+    char addr_text[32];
+    snprintf(addr_text, sizeof(addr_text), "127.0.0.1:%d", port);
+    parse_addr(addr_text, addr);
+
+    bool ready = false;
+    for (int i = 0; i < 200 && !ready; ++i) {
+        int status;
+        if (waitpid(pid, &status, WNOHANG) == pid) break;
+
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        ready = connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0;
+        close(fd);
+        if (!ready) usleep(50000);
+    }
+    if (!ready) {
+        fprintf(stderr, "server is not ready, see %s/server.out\n", work_dir);
+        kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+        return 1;
+    }
+
+    printf("server: %s %d local, pid %d, doc_root %s, work dir %s\n", server_path, port, (int)pid, doc_root, work_dir);
+    if (register_login_user(addr) != 200) printf("register login user is error, login requests will get logError.html\n");
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads = cpus >= 8 ? 4 : (cpus >= 2 ? (int)cpus / 2 : 1);
+    printf("load threads: %d, %.0fs per scenario\n\n", threads, duration);
+    print_header();
+
+    // 18.3 闭环：最大吞吐
+    Load_Config get_keep = {"GET keep-alive closed-loop c=64", threads, 64, duration, 0, 1, true, {1, 0, 0}, "/judge.html"};
+    Load_Config get_close = {"GET close closed-loop c=16", threads, 16, duration, 0, 1, false, {1, 0, 0}, "/judge.html"};
+    Load_Config mix_keep = {"GET/login/register 8:1:1 closed-loop c=64", threads, 64, duration, 0, 1, true, {8, 1, 1}, "/judge.html"};
+
+    Load_Result get_keep_result, get_close_result, mix_keep_result;
+    run_load(get_keep, addr, get_keep_result);
+    print_result(get_keep, get_keep_result);
+    run_load(get_close, addr, get_close_result);
+    print_result(get_close, get_close_result);
+    run_load(mix_keep, addr, mix_keep_result);
+    print_result(mix_keep, mix_keep_result);
+
+    // 18.4 开环：最大吞吐的 50%、90%，延迟从计划发送时间算起
+    struct {
+        const Load_Config* base;
+        double max_rps;
+        double load;
+    } open_loops[] = {
+        {&get_keep, get_keep_result.rps(), 0.5}, {&get_keep, get_keep_result.rps(), 0.9}, {&mix_keep, mix_keep_result.rps(), 0.5}
+    };
+
+    for (size_t i = 0; i < sizeof(open_loops) / sizeof(open_loops[0]); ++i) {
+        Load_Config config = *open_loops[i].base;
+        config.rate = open_loops[i].max_rps * open_loops[i].load;
+        if (config.rate < 1) continue;
+
+        char name[128];
+        snprintf(name, sizeof(name), "%s open-loop %.0f%% (%.0f/s)", config.mix[REQ_LOGIN] > 0 ? "GET/login/register" : "GET",
+                 open_loops[i].load * 100, config.rate);
+        config.name = name;
+
+        Load_Result result;
+        run_load(config, addr, result);
+        print_result(config, result);
+    }
+
+    // 18.5 停止服务器
+    kill(pid, SIGTERM);
+    int status;
+    bool exited = false;
+    for (int i = 0; i < 60 && !exited; ++i) {
+        exited = waitpid(pid, &status, WNOHANG) == pid;
+        if (!exited) usleep(50000);
+    }
+    if (!exited) {
+        kill(pid, SIGKILL);
+        waitpid(pid, &status, 0);
+    }
+    printf("\nserver output and logs: %s\n", work_dir);
+    return 0;
+}
+
+
+static void usage(const char* name) {
+    printf("Usage: %s [-t threads] [-c connections] [-d seconds] [-r rate, 0 = closed loop] [-p pipeline] [-k 1|0]\n"
+           "       %*s [-m get:login:register] [-u url] host:port\n"
+           "       %s --suite [server, default ./main] [seconds per scenario, default 5]\n",
+           name, (int)strlen(name), "", name);
+}
+
+
+int main(int argc, char* argv[]) {
+    signal(SIGPIPE, SIG_IGN);
+
+    if (argc >= 2 && strcmp(argv[1], "--suite") == 0) {
+        return run_suite(argc >= 3 ? argv[2] : "./main", argc >= 4 ? atof(argv[3]) : 5);
+    }
+
+    Load_Config config = {"", 2, 64, 10, 0, 1, true, {1, 0, 0}, "/judge.html"};
+    int opt;
+    while ((opt = getopt(argc, argv, "t:c:d:r:p:k:m:u:")) != -1) {
+        switch (opt) {
+        case 't': config.threads = atoi(optarg); break;
+        case 'c': config.connections = atoi(optarg); break;
+        case 'd': config.duration_s = atof(optarg); break;
+        case 'r': config.rate = atof(optarg); break;
+        case 'p': config.pipeline = atoi(optarg); break;
+        case 'k': config.keep_alive = atoi(optarg) != 0; break;
+        case 'm': sscanf(optarg, "%d:%d:%d", &config.mix[REQ_GET], &config.mix[REQ_LOGIN], &config.mix[REQ_REGISTER]); break;
+        case 'u': config.get_url = optarg; break;
+        default: usage(argv[0]); return 1;
+        }
+    }
+
+    struct sockaddr_in addr;
+    if (optind >= argc || !parse_addr(argv[optind], addr) || config.threads <= 0 || config.connections <= 0 ||
+        config.duration_s <= 0 || config.rate < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (config.pipeline < 1) config.pipeline = 1;
+
+    char name[128];
+    snprintf(name, sizeof(name), "%d:%d:%d %s c=%d p=%d %s", config.mix[REQ_GET], config.mix[REQ_LOGIN], config.mix[REQ_REGISTER],
+             config.keep_alive ? "keep-alive" : "close", config.connections, config.pipeline, config.rate > 0 ? "open-loop" : "closed-loop");
+    config.name = name;
+
+    if (config.mix[REQ_LOGIN] > 0 && register_login_user(addr) != 200) printf("register login user is error\n");
+
+    print_header();
+    Load_Result result;
+    if (!run_load(config, addr, result)) {
+        usage(argv[0]);
+        return 1;
+    }
+    print_result(config, result);
+    return 0;
+}
@@ -0,0 +1,156 @@
+// 日志吞吐测试：N 个线程同时调用 LOG_INFO，每个线程写 iterations 行，输出每秒写入的行数
+// 1. sync: 同步写，每行加锁格式化并写进日志文件，同时输出到标准输出（重定向到 /dev/null）
+// 2. queue: 日志队列，格式化到预先分配的槽位，写线程按批写出；槽位用完时丢弃（输出丢弃的行数）
+// 3. buffered: 每个线程一个双缓冲区，不加锁，刷盘线程批量写出
+// 4. binary: 二进制日志，只拷贝原始参数和时间戳计数器，使用缓冲模式的缓冲区
+// 5. off: 运行时级别为 warn，LOG_INFO 只剩一次级别比较（输出的是每秒调用次数）
+// 6. access: 访问日志（Access_Log，combined 格式加处理时间和数据库时间），每次写一条完整的访问记录
+// bytes/line 是日志文件（所有段）的总大小除以行数
+// Log 是单例，每种模式、每个线程数在一个子进程中测试；计时包括最后 flush() 把日志全部写出的时间
+// 用法: ./bench/log_bench [每个线程写的行数] [日志目录，默认 /tmp]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include <glob.h>
+#include "../log/log.h"
+#include "../log/access_log.h"
+
+
+static int iterations = 100000;
+static const char* log_dir = "/tmp";
+
+
+static long long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+
+static void* writer(void* arg) {
+    long id = (long)arg;
+    for (int i = 0; i < iterations; ++i) {
+        LOG_INFO("log bench, thread: %ld, line: %d, fd: %d, url: %s", id, i, i & 1023, "/judge.html");
+    }
+    return NULL;
+}
+
+
+static void* access_writer(void* arg) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(0x7f000001);
+
+    Access_Record record = {&addr, "GET", "/judge.html", "HTTP/1.1", 200, 1234, 1400, 85, 0, NULL,
+                            "Mozilla/5.0 (X11; Linux x86_64) log_bench"};
+    for (int i = 0; i < iterations; ++i) {
+        record.duration_us = i & 1023;
+        Access_Log::get_instance()->write(record);
+    }
+    return NULL;
+}
+
+
+// 在子进程中测试一种模式，通过管道把耗时和丢弃的行数传回父进程
+struct Result {
+    double seconds;
+    unsigned long long dropped;
+};
+
+static Result run(const char* mode, int thread_num) {
+    Result result = {0, 0};
+    int pipefd[2];
+    if (pipe(pipefd) != 0) return result;
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(pipefd[0]);
+        int devnull = open("/dev/null", O_WRONLY);
+        dup2(devnull, STDOUT_FILENO);
+
+        char file_name[256];
+        snprintf(file_name, sizeof(file_name), "%s/log_bench_%s_%d", log_dir, mode, thread_num);
+
+        long long begin = now_ns();
+        if (strcmp(mode, "access") == 0) Access_Log::get_instance()->init(file_name, "combined %D %{db}D");
+        else if (mode[0] == 's') Log::get_instance()->init(file_name, 2000, 100000000, 0);
+        else if (mode[0] == 'q') Log::get_instance()->init(file_name, 2000, 100000000, 4096);
+        else {
+            if (strcmp(mode, "binary") == 0) Log::set_binary(true);
+            Log::get_instance()->init(file_name, 2000, 100000000, 0, 64 * 1024);
+        }
+        if (mode[0] == 'o') Log::set_level(LOG_LEVEL_WARN);
+
+        pthread_t tids[64];
+        void* (*func)(void*) = strcmp(mode, "access") == 0 ? access_writer : writer;
+        for (long i = 0; i < thread_num; ++i) pthread_create(&tids[i], NULL, func, (void*)i);
+        for (int i = 0; i < thread_num; ++i) pthread_join(tids[i], NULL);
+
+        Log::get_instance()->flush();
+        Access_Log::get_instance()->flush();
+        result.seconds = (now_ns() - begin) / 1e9;
+        result.dropped = Log::get_instance()->dropped() + Access_Log::get_instance()->dropped();
+
+        if (write(pipefd[1], &result, sizeof(result)) != sizeof(result)) _exit(1);
+        exit(0);
+    }
+
+    close(pipefd[1]);
+    if (read(pipefd[0], &result, sizeof(result)) != sizeof(result)) result.seconds = 0;
+    close(pipefd[0]);
+    waitpid(pid, NULL, 0);
+    return result;
+}
+
+
+// 一次测试写出的所有日志文件的总大小
+static long long log_bytes(const char* mode, int thread_num) {
+    // 线程数后面是文件名结尾或者非数字（.bin、分段的 _1），避免 _1 匹配到 _16
+    char pattern[256];
+    glob_t files;
+    snprintf(pattern, sizeof(pattern), "%s/*log_bench_%s_%d", log_dir, mode, thread_num);
+    int ret = glob(pattern, 0, NULL, &files);
+    snprintf(pattern, sizeof(pattern), "%s/*log_bench_%s_%d[!0-9]*", log_dir, mode, thread_num);
+    ret = glob(pattern, ret == 0 ? GLOB_APPEND : 0, NULL, &files) == 0 ? 0 : ret;
+
+    long long bytes = 0;
+    if (ret == 0) {
+        for (size_t i = 0; i < files.gl_pathc; ++i) {
+            struct stat st;
+            if (stat(files.gl_pathv[i], &st) == 0 && strstr(files.gl_pathv[i], ".fmt") == NULL) bytes += st.st_size;
+        }
+        globfree(&files);
+    }
+    return bytes;
+}
+
+
+int main(int argc, char* argv[]) {
+    if (argc >= 2) iterations = atoi(argv[1]);
+    if (argc >= 3) log_dir = argv[2];
+
+    const char* modes[] = {"sync", "queue", "buffered", "binary", "off", "access"};
+    int thread_nums[] = {1, 2, 4, 8, 16, 32};
+
+    printf("%-9s %8s %14s %12s %11s\n", "mode", "threads", "lines/sec", "dropped", "bytes/line");
+    for (int m = 0; m < 6; ++m) {
+        for (int t = 0; t < 6; ++t) {
+            Result result = run(modes[m], thread_nums[t]);
+            double lines = (double)iterations * thread_nums[t];
+            printf("%-9s %8d %14.0f %12llu %11.1f\n", modes[m], thread_nums[t],
+                   result.seconds > 0 ? lines / result.seconds : 0, result.dropped,
+                   log_bytes(modes[m], thread_nums[t]) / lines);
+            fflush(stdout);
+        }
+    }
+
+    return 0;
+}
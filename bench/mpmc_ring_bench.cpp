@@ -0,0 +1,195 @@
+// 队列的吞吐和入队延迟测试：P 个生产者、P 个消费者共享一个容量为 1024 的队列
+// 1. list: 原来 ThreadPool 的 Mutex + Sem + std::list，每次 push 都会分配节点并 post 信号量
+// 2. cond: 原来 Block_Queue 的 Mutex + Cond 循环数组，每次 push 都 broadcast
+// 3. ring: Mpmc_Ring，无锁，只在消费者睡眠时才唤醒
+// 入队延迟包括队列满时等待的时间，输出 p50/p99
+// 用法: ./bench/mpmc_ring_bench [每个生产者的入队次数]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sched.h>
+#include <algorithm>
+#include <list>
+#include <vector>
+#include <pthread.h>
+#include "../lock/locker.h"
+#include "../lock/mpmc_ring.h"
+
+
+static const int CAPACITY = 1024;
+static int iterations = 200000;
+
+
+static long long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+
+// 1. 原来 ThreadPool 的队列
+class List_Queue {
+private:
+    std::list<long> m_list;
+    Mutex m_mutex;
+    Sem m_sem;
+
+public:
+    void push(long item) {
+        while (true) {
+            m_mutex.lock();
+            if ((int)m_list.size() < CAPACITY) break;
+            m_mutex.unlock();
+            sched_yield();
+        }
+        m_list.push_back(item);
+        m_mutex.unlock();
+        m_sem.post_sem();
+    }
+
+    long pop() {
+        m_sem.wait_sem();
+        m_mutex.lock();
+        long item = m_list.front();
+        m_list.pop_front();
+        m_mutex.unlock();
+        return item;
+    }
+};
+
+
+// 2. 原来的 Block_Queue
+class Cond_Queue {
+private:
+    long m_arr[CAPACITY];
+    int m_size, m_front, m_back;
+    Mutex m_mutex;
+    Cond m_cond;
+
+public:
+    Cond_Queue() : m_size(0), m_front(0), m_back(0) {}
+
+    void push(long item) {
+        while (true) {
+            m_mutex.lock();
+            if (m_size < CAPACITY) break;
+            m_cond.broadcast_cond();
+            m_mutex.unlock();
+            sched_yield();
+        }
+        m_arr[m_back] = item;
+        m_back = (m_back + 1) % CAPACITY;
+        ++m_size;
+        m_cond.broadcast_cond();
+        m_mutex.unlock();
+    }
+
+    long pop() {
+        m_mutex.lock();
+        while (m_size <= 0) m_cond.wait_cond(m_mutex.get());
+        long item = m_arr[m_front];
+        m_front = (m_front + 1) % CAPACITY;
+        --m_size;
+        m_mutex.unlock();
+        return item;
+    }
+};
+
+
+// 3. Mpmc_Ring
+class Ring_Queue {
+private:
+    Mpmc_Ring<long> m_ring;
+
+public:
+    Ring_Queue() : m_ring(CAPACITY) {}
+
+    void push(long item) { m_ring.push_wait(item); }
+
+    long pop() {
+        long item = 0;
+        m_ring.pop_wait(item);
+        return item;
+    }
+};
+
+
+// 4. 生产者记录每次入队的延迟；消费者取到 -1 时退出
+template<typename Queue>
+struct Bench_Arg {
+    Queue* queue;
+    std::vector<long long> latency;
+};
+
+template<typename Queue>
+static void* producer(void* arg) {
+    Bench_Arg<Queue>* bench = (Bench_Arg<Queue>*)arg;
+    bench->latency.resize(iterations);
+
+    for (int i = 0; i < iterations; ++i) {
+        long long begin = now_ns();
+        bench->queue->push(i);
+        bench->latency[i] = now_ns() - begin;
+    }
+    return NULL;
+}
+
+template<typename Queue>
+static void* consumer(void* arg) {
+    Bench_Arg<Queue>* bench = (Bench_Arg<Queue>*)arg;
+    while (bench->queue->pop() >= 0) {}
+    return NULL;
+}
+
+
+// 5. 运行一轮
+template<typename Queue>
+static void run(const char* name, int thread_num) {
+    Queue* queue = new Queue();
+    std::vector<Bench_Arg<Queue> > producers(thread_num), consumers(thread_num);
+    std::vector<pthread_t> producer_tids(thread_num), consumer_tids(thread_num);
+
+    long long begin = now_ns();
+    for (int i = 0; i < thread_num; ++i) {
+        consumers[i].queue = queue;
+        pthread_create(&consumer_tids[i], NULL, consumer<Queue>, &consumers[i]);
+    }
+    for (int i = 0; i < thread_num; ++i) {
+        producers[i].queue = queue;
+        pthread_create(&producer_tids[i], NULL, producer<Queue>, &producers[i]);
+    }
+
+    for (int i = 0; i < thread_num; ++i) pthread_join(producer_tids[i], NULL);
+    for (int i = 0; i < thread_num; ++i) queue->push(-1);
+    for (int i = 0; i < thread_num; ++i) pthread_join(consumer_tids[i], NULL);
+
+    double seconds = (now_ns() - begin) / 1e9;
+
+    std::vector<long long> latency;
+    for (int i = 0; i < thread_num; ++i) {
+        latency.insert(latency.end(), producers[i].latency.begin(), producers[i].latency.end());
+    }
+    std::sort(latency.begin(), latency.end());
+
+    size_t n = latency.size();
+    printf("%-6s %8d %14.0f %10lld %10lld\n", name, thread_num, n / seconds, latency[n / 2], latency[n * 99 / 100]);
+    delete queue;
+}
+
+
+int main(int argc, char* argv[]) {
+    if (argc > 1) iterations = atoi(argv[1]);
+    if (iterations <= 0) return 1;
+
+    int threads[4] = {1, 2, 4, 8};
+
+    printf("%-6s %8s %14s %10s %10s\n", "queue", "P=C", "ops/sec", "p50(ns)", "p99(ns)");
+    for (int t = 0; t < 4; ++t) {
+        run<List_Queue>("list", threads[t]);
+        run<Cond_Queue>("cond", threads[t]);
+        run<Ring_Queue>("ring", threads[t]);
+    }
+
+    return 0;
+}
@@ -0,0 +1,157 @@
+// 线程池的吞吐和排队延迟测试：一个生产者线程（相当于主线程）不断投递小任务，8~64 个工作线程处理
+// 1. shared: ThreadPool，所有线程共享一个无锁环形队列 Mpmc_Ring
+// 2. stealing: Work_Stealing_Pool，每个线程一个 Chase_Lev_Deque，空闲线程窃取，futex 睡眠
+// 排队延迟 = 任务开始执行的时间 - append() 的时间，输出 p50/p99/p999
+// 最后模拟登录风暴：一半的任务是需要 1ms 的慢任务，比较有/没有只处理快队列的线程时，快任务的排队延迟
+// 用法: ./bench/thread_pool_bench [每轮的任务数] [每个任务的工作量]
+
+// 屏蔽日志：append() 中的 LOG_INFO 会成为瓶颈，而且这里没有初始化 Log
+#define LOG_H
+#define LOG_DEBUG(format, ...)
+#define LOG_INFO(format, ...)
+#define LOG_WARN(format, ...)
+#define LOG_ERROR(format, ...)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <vector>
+#include "../threadpool/thread_pool.h"
+#include "../threadpool/work_stealing_pool.h"
+
+
+static const int MAX_REQUESTS = 1000;   // 与 main.cpp 中的队列长度一致
+static int task_num = 200000;
+static int task_work = 200;
+
+static std::atomic<int> finished(0);
+
+
+static long long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+
+// 1. 测试用的任务，接口与 HTTP_Conn 相同
+struct Bench_Task {
+    int m_sockfd;
+    long long append_ns;        // append() 的时间
+    long long delay_ns;         // 排队延迟
+    int slow_us;                // 大于 0 时是慢任务，第一次 process() 返回 false，在慢队列中睡眠 slow_us
+    bool routed;                // 是否已经被分到慢队列
+
+    bool process() {
+        if (routed) {
+            usleep(slow_us);
+            finished.fetch_add(1, std::memory_order_release);
+            return true;
+        }
+
+        delay_ns = now_ns() - append_ns;
+        if (slow_us > 0) {
+            routed = true;
+            return false;
+        }
+
+        for (volatile int i = 0; i < task_work; ++i) {}
+        finished.fetch_add(1, std::memory_order_release);
+        return true;
+    }
+};
+
+
+// 2. 运行一轮：投递所有任务并等待完成，队列满时重试
+// 线程池的析构函数不会等待工作线程退出，所以这里不释放线程池
+template<typename Pool>
+static void run(const char* name, int thread_num) {
+    Pool* pool = new Pool(thread_num, MAX_REQUESTS);
+    std::vector<Bench_Task> tasks(task_num);
+
+    finished.store(0);
+    long long begin = now_ns();
+
+    for (int i = 0; i < task_num; ++i) {
+        tasks[i].m_sockfd = i;
+        tasks[i].slow_us = 0;
+        tasks[i].routed = false;
+        tasks[i].append_ns = now_ns();
+        while (!pool->append(&tasks[i])) {
+            cpu_relax();
+            tasks[i].append_ns = now_ns();
+        }
+    }
+    while (finished.load(std::memory_order_acquire) < task_num) cpu_relax();
+
+    double seconds = (now_ns() - begin) / 1e9;
+
+    std::vector<long long> delays(task_num);
+    for (int i = 0; i < task_num; ++i) delays[i] = tasks[i].delay_ns;
+    std::sort(delays.begin(), delays.end());
+
+    printf("%-10s %8d %14.0f %10.1f %10.1f %10.1f\n", name, thread_num, task_num / seconds,
+           delays[task_num / 2] / 1000.0, delays[(long long)task_num * 99 / 100] / 1000.0,
+           delays[(long long)task_num * 999 / 1000] / 1000.0);
+}
+
+
+// 3. 登录风暴：每 200us 投递一个任务，一半是慢任务，只统计快任务的排队延迟
+template<typename Pool>
+static void run_storm(const char* name, int fast_threads) {
+    const int storm_num = 5000;
+    Pool* pool = new Pool(8, MAX_REQUESTS, NULL, NULL, fast_threads);
+    std::vector<Bench_Task> tasks(storm_num);
+
+    finished.store(0);
+    long long next = now_ns();
+    for (int i = 0; i < storm_num; ++i) {
+        while (now_ns() < next) cpu_relax();
+        next += 200000;
+
+        tasks[i].m_sockfd = i;
+        tasks[i].slow_us = (i % 2) ? 1000 : 0;
+        tasks[i].routed = false;
+        tasks[i].append_ns = now_ns();
+        while (!pool->append(&tasks[i])) {
+            cpu_relax();
+            tasks[i].append_ns = now_ns();
+        }
+    }
+    while (finished.load(std::memory_order_acquire) < storm_num) cpu_relax();
+
+    std::vector<long long> delays;
+    for (int i = 0; i < storm_num; i += 2) delays.push_back(tasks[i].delay_ns);
+    std::sort(delays.begin(), delays.end());
+
+    size_t n = delays.size();
+    printf("%-10s %12d %10.1f %10.1f %10.1f\n", name, fast_threads, delays[n / 2] / 1000.0,
+           delays[n * 99 / 100] / 1000.0, delays[n * 999 / 1000] / 1000.0);
+}
+
+
+int main(int argc, char* argv[]) {
+    if (argc > 1) task_num = atoi(argv[1]);
+    if (argc > 2) task_work = atoi(argv[2]);
+    if (task_num <= 0) return 1;
+
+    int threads[4] = {8, 16, 32, 64};
+
+    printf("%-10s %8s %14s %10s %10s %10s\n", "pool", "threads", "tasks/sec", "p50(us)", "p99(us)", "p999(us)");
+    for (int t = 0; t < 4; ++t) {
+        run<ThreadPool<Bench_Task> >("shared", threads[t]);
+        run<Work_Stealing_Pool<Bench_Task> >("stealing", threads[t]);
+    }
+
+    printf("\nlogin storm, 8 threads, fast task queueing delay\n");
+    printf("%-10s %12s %10s %10s %10s\n", "pool", "fast_threads", "p50(us)", "p99(us)", "p999(us)");
+    for (int fast_threads = 0; fast_threads <= 2; fast_threads += 2) {
+        run_storm<ThreadPool<Bench_Task> >("shared", fast_threads);
+        run_storm<Work_Stealing_Pool<Bench_Task> >("stealing", fast_threads);
+    }
+
+    return 0;
+}
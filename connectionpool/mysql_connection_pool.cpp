@@ -3,6 +3,9 @@
 
 
 
+thread_local MYSQL* Connection_Pool::t_stickyConn = NULL;
+
+
 // 1. 单例模式
 Connection_Pool* Connection_Pool::getInstance() {
     static Connection_Pool conn_pool;
@@ -20,6 +23,8 @@ void Connection_Pool::init(string url, string user, string pw, string dbname, in
     MaxConn = maxconn;
 
     m_mutex.lock();
+    m_connStack = new Lock_Free_Stack<MYSQL*>(maxconn);
+
     for (int i = 0; i < maxconn; ++i) {
         MYSQL* mysql = mysql_init(NULL);
         if (mysql == NULL) {
@@ -34,31 +39,36 @@ void Connection_Pool::init(string url, string user, string pw, string dbname, in
             continue;
         }
 
-        m_connList.push_back(mysql);
+        m_connStack->push(mysql);
         ++FreeConn;
     }
 
     LOG_INFO("create connection pool num: %d, failed num: %d", FreeConn, maxconn - FreeConn);
-
-    m_sem = Sem(FreeConn);
     m_mutex.unlock();
 }
 
 
 // 3. 当有请求时，从数据库连接池中返回一个可用连接，更新使用和空闲连接数
 MYSQL* Connection_Pool::getConnection() {
-    if ((m_connList.size() == 0) || (FreeConn == 0)) return NULL;
+    Metrics::count(COUNTER_DB_CHECKOUTS);
 
-    m_sem.wait_sem();
-    m_mutex.lock();
+    // 3.1 当前线程独占了一个连接，直接使用，不碰共享状态
+    if (t_stickyConn != NULL) {
+        SERVER_PROBE2(db_get, t_stickyConn, 1);
+        return t_stickyConn;
+    }
+
+    if (FreeConn == 0) {
+        SERVER_PROBE2(db_get, (MYSQL*)NULL, 0);
+        return NULL;
+    }
 
-    MYSQL* mysql = m_connList.front();
-    m_connList.pop_front();
+    // 3.2 先无锁出栈，没有空闲连接时才在信号量上等待
+    MYSQL* mysql = NULL;
+    m_connStack->pop_wait(mysql);
 
-    --FreeConn;
     ++UseConn;
-
-    m_mutex.unlock();
+    SERVER_PROBE2(db_get, mysql, 0);
     return mysql;
 }
 
@@ -67,33 +77,74 @@ MYSQL* Connection_Pool::getConnection() {
 bool Connection_Pool::releaseConnection(MYSQL* conn) {
     if (conn == NULL) return false;
 
-    m_mutex.lock();
+    // 4.1 独占连接不归还，继续留给当前线程
+    if (conn == t_stickyConn) {
+        SERVER_PROBE2(db_release, conn, 1);
+        return true;
+    }
 
-    m_connList.push_back(conn);
-    ++FreeConn;
+    SERVER_PROBE2(db_release, conn, 0);
     --UseConn;
+    if (m_connStack == NULL) {
+        // 连接池已经销毁，直接关闭
+        mysql_close(conn);
+        return true;
+    }
 
-    m_mutex.unlock();
-    m_sem.post_sem();
+    m_connStack->push(conn);
 
     return true;
 }
 
 
+// 5. 让当前线程独占一个连接，只尝试无锁出栈，不会阻塞
+// 5. 至少保留一个连接给没有独占连接的线程（例如主线程、线程数多于连接数时的其余工作线程）
+bool Connection_Pool::bindThreadConnection() {
+    if (t_stickyConn != NULL) return true;
+
+    if (++BoundConn >= FreeConn) {
+        --BoundConn;
+        return false;
+    }
+
+    MYSQL* mysql = NULL;
+    if (!m_connStack->try_pop(mysql)) {
+        --BoundConn;
+        return false;
+    }
+
+    ++UseConn;
+    t_stickyConn = mysql;
+    return true;
+}
+
+// 6. 归还当前线程独占的连接
+void Connection_Pool::unbindThreadConnection() {
+    if (t_stickyConn == NULL) return;
+
+    MYSQL* mysql = t_stickyConn;
+    t_stickyConn = NULL;
+    --BoundConn;
+
+    releaseConnection(mysql);
+}
+
 
-// 5. 销毁所有的数据库连接池
+// 7. 销毁所有的数据库连接池，被线程独占的连接由 unbindThreadConnection() 归还后才会被关闭
 void Connection_Pool::destroyConnPool() {
     m_mutex.lock();
 
-    if (m_connList.size() > 0) {
-        for (auto mysql : m_connList) {
+    if (m_connStack != NULL) {
+        MYSQL* mysql = NULL;
+        while (m_connStack->try_pop(mysql)) {
             mysql_close(mysql);
         }
 
         FreeConn = 0;
         UseConn = 0;
 
-        m_connList.clear();
+        delete m_connStack;
+        m_connStack = NULL;
     }
 
     m_mutex.unlock();
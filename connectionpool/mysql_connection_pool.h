@@ -7,12 +7,15 @@
 #include <string>
 #include <cstring>
 #include <stdlib.h>
-#include <list>
+#include <atomic>
 #include <pthread.h>
 #include <mysql/mysql.h>
 
 #include "../lock/locker.h"
+#include "../lock/lock_free_stack.h"
 #include "../log/log.h"
+#include "../metrics/metrics.h"
+#include "../metrics/probes.h"
 
 using namespace std;
 
@@ -22,13 +25,14 @@ using namespace std;
 class Connection_Pool {
 private:
     // 1. 成员变量
-    unsigned int MaxConn;       // 1.1 最大的连接数
-    unsigned int UseConn;       // 1.2 当前已使用的连接数
-    unsigned int FreeConn;      // 1.3 当前空闲的连接数
+    unsigned int MaxConn;                       // 1.1 最大的连接数
+    std::atomic<unsigned int> UseConn;          // 1.2 当前已使用的连接数
+    unsigned int FreeConn;                      // 1.3 成功建立的连接数，空闲数 = FreeConn - UseConn
+    std::atomic<unsigned int> BoundConn;        // 1.4 被工作线程独占（sticky）的连接数
 
-    list<MYSQL*> m_connList;    // 1.4 连接池
-    Mutex m_mutex;              // 1.5 互斥锁
-    Sem m_sem;                  // 1.6 信号量
+    Lock_Free_Stack<MYSQL*>* m_connStack;       // 1.5 连接池：无锁空闲连接栈
+    Mutex m_mutex;                              // 1.6 互斥锁，只在 init/destroy 时使用
+    static thread_local MYSQL* t_stickyConn;    // 1.7 当前线程独占的连接
 
     string m_url;               // 1.7 主机地址
     unsigned int m_db_port;     // 1.8 数据库端口号
@@ -42,7 +46,11 @@ public:
     MYSQL* getConnection();                     // 2.1 获取数据库连接
     bool releaseConnection(MYSQL* conn);        // 2.2 释放连接
     void destroyConnPool();                     // 2.3 销毁所有连接
-    int getFreeConn() { return FreeConn; }      // 2.4 获取当前空闲的连接数
+    int getFreeConn() { return FreeConn - UseConn; }    // 2.4 获取当前空闲的连接数
+
+    // 2.5 线程亲和：让当前线程独占一个连接，之后该线程的 get/release 不再访问共享的空闲栈
+    bool bindThreadConnection();
+    void unbindThreadConnection();
 
     // 3. 单例模式
     static Connection_Pool* getInstance();
@@ -51,7 +59,7 @@ public:
 
 private:
     // 4. 私有化的构造函数
-    Connection_Pool() : MaxConn(0), UseConn(0), FreeConn(0) {}
+    Connection_Pool() : MaxConn(0), UseConn(0), FreeConn(0), BoundConn(0), m_connStack(NULL) {}
     Connection_Pool(const Connection_Pool&) {}
 };
 
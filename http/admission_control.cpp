@@ -0,0 +1,88 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "admission_control.h"
+#include "../metrics/metrics.h"
+
+
+
+// 3. 构造函数：预先生成 503 响应，发送时不需要再格式化
+Admission_Control::Admission_Control(int max_queue, long long max_delay_us, int max_conns, int retry_after)
+    : m_max_queue(max_queue), m_max_delay_us(max_delay_us), m_max_conns(max_conns), m_response_len(0)
+{
+    memset(&m_stats, 0, sizeof(m_stats));
+
+    const char* body = "Service Unavailable\n";
+    m_response_len = snprintf(m_response, sizeof(m_response),
+                              "HTTP/1.1 503 Service Unavailable\r\n"
+                              "Retry-After: %d\r\n"
+                              "Content-Type: text/plain\r\n"
+                              "Content-Length: %d\r\n"
+                              "Connection: close\r\n"
+                              "\r\n"
+                              "%s", retry_after, (int)strlen(body), body);
+}
+
+
+// 4. 更新过载状态：超过阈值时进入过载，两项都降到阈值的一半以下时恢复，避免在阈值附近来回切换
+void Admission_Control::update(int queue_size, long long delay_p95_us) {
+    bool over_delay = m_max_delay_us > 0 && delay_p95_us >= m_max_delay_us;
+    bool under_delay = m_max_delay_us <= 0 || delay_p95_us < m_max_delay_us / 2;
+
+    if (!m_stats.overloaded && (queue_size >= m_max_queue || over_delay)) {
+        m_stats.overloaded = true;
+        LOG_WARN("admission control: overloaded, queue: %d, p95 delay: %lldus", queue_size, delay_p95_us);
+    }
+    else if (m_stats.overloaded && queue_size < m_max_queue / 2 && under_delay) {
+        m_stats.overloaded = false;
+        LOG_WARN("admission control: recovered, queue: %d, p95 delay: %lldus, shed requests: %llu",
+                 queue_size, delay_p95_us, m_stats.shed_requests + m_stats.shed_full);
+    }
+}
+
+
+// 6. 发送 503：响应很小，非阻塞的 send 一次就能放进 socket 的发送缓冲区，发送失败也不重试
+void Admission_Control::shed(int sockfd, bool full) {
+    send_response(sockfd);
+
+    if (full) ++m_stats.shed_full;
+    else ++m_stats.shed_requests;
+}
+
+
+// 7. 连接数达到上限
+void Admission_Control::reject(int connfd) {
+    send_response(connfd);
+    close(connfd);
+    ++m_stats.rejected_conns;
+}
+
+// 6.1 这些 503 不经过 HTTP_Conn::write()，在这里计入按状态码的请求数和发送的字节数
+void Admission_Control::send_response(int sockfd) {
+    ssize_t ret = send(sockfd, m_response, m_response_len, MSG_NOSIGNAL);
+    Metrics::count_status(503);
+    if (ret > 0) Metrics::count(COUNTER_BYTES_SENT, ret);
+}
+
+
+// 8. 暂停 accept
+bool Admission_Control::pause_accept() {
+    if (m_stats.accept_paused) return false;
+
+    m_stats.accept_paused = true;
+    ++m_stats.accept_pauses;
+    LOG_WARN("admission control: too many connections, pause accept");
+    return true;
+}
+
+
+// 9. 恢复 accept：重新加入 epoll 时如果已经有等待的连接，ET 模式下也会立刻触发一次 EPOLLIN
+bool Admission_Control::resume_accept(int user_count) {
+    if (!m_stats.accept_paused || user_count >= m_max_conns * 9 / 10) return false;
+
+    m_stats.accept_paused = false;
+    LOG_WARN("admission control: resume accept, connections: %d", user_count);
+    return true;
+}
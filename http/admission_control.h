@@ -0,0 +1,66 @@
+// 过载保护（准入控制），只由主线程（reactor）调用
+// 1. 线程池排队的任务数或排队延迟的 p95 超过阈值时进入过载状态，降到阈值的一半以下时恢复；
+//    过载时读完的请求不再交给线程池，主线程直接回复预先生成好的 503 + Retry-After 并关闭连接
+// 2. 连接数达到上限时，回复 503 并暂停 accept（把 listenfd 从 epoll 中删除），连接数降到上限的 90% 以下时恢复
+// 3. 统计 回复 503 的请求数 / 拒绝的连接数 / 暂停 accept 的次数；发送的 503 同时计入 Metrics 的按状态码统计
+
+#ifndef ADMISSION_CONTROL_H
+#define ADMISSION_CONTROL_H
+
+#include "../log/log.h"
+
+
+// 1. 统计
+struct Admission_Stats {
+    bool overloaded;                        // 1.1 是否处于过载状态
+    bool accept_paused;                     // 1.2 是否暂停了 accept
+    unsigned long long shed_requests;       // 1.3 过载时回复 503 的请求数
+    unsigned long long shed_full;           // 1.4 线程池队列满，回复 503 的请求数
+    unsigned long long rejected_conns;      // 1.5 连接数达到上限，回复 503 的连接数
+    unsigned long long accept_pauses;       // 1.6 暂停 accept 的次数
+};
+
+
+class Admission_Control {
+private:
+    // 2. 成员变量
+    int m_max_queue;                        // 2.1 排队任务数的阈值
+    long long m_max_delay_us;               // 2.2 排队延迟 p95 的阈值，0 表示不检查
+    int m_max_conns;                        // 2.3 连接数的上限
+    char m_response[256];                   // 2.4 预先生成的 503 响应
+    int m_response_len;
+    Admission_Stats m_stats;                // 2.5 统计
+
+public:
+    // 3. retry_after: Retry-After 头部的秒数
+    Admission_Control(int max_queue, long long max_delay_us, int max_conns, int retry_after);
+
+    // 4. 每轮 epoll_wait 之后根据线程池的状态更新过载状态
+    void update(int queue_size, long long delay_p95_us);
+
+    // 5. 当前是否过载
+    bool overloaded() { return m_stats.overloaded; }
+
+    // 6. 向 sockfd 发送 503（不关闭连接），full 为 true 表示是因为线程池队列满
+    void shed(int sockfd, bool full = false);
+
+    // 7. 连接数达到上限：发送 503 并关闭 connfd
+    void reject(int connfd);
+
+    // 8. 连接数达到上限时暂停 accept：返回 true 表示刚刚进入暂停状态，调用者需要把 listenfd 从 epoll 中删除
+    bool conn_full(int user_count) { return user_count >= m_max_conns; }
+    bool pause_accept();
+
+    // 9. 暂停 accept 时，连接数降到上限的 90% 以下后恢复：返回 true 表示调用者需要重新把 listenfd 加入 epoll
+    bool resume_accept(int user_count);
+
+    // 10. 统计
+    const Admission_Stats& get_stats() { return m_stats; }
+
+private:
+    void send_response(int sockfd);
+};
+
+
+
+#endif
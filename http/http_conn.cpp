@@ -16,11 +16,14 @@ const char* error_500_form = "There was an unusual problem serving the requested
 // 2. 网站的根目录，及你的root文件夹的目录
 const char *doc_root = "/home/mjh/github/TinyWebServer/root";
 
-// 3. 存储数据库中的用户名和密码
-static map<string, string> users;
-static Mutex m_lock;
+// 3. 数据库中的用户名和密码由 User_Table 管理
 static const bool is_et = true;     // 是否设置为et，与 main.cpp 下的 is_et 一起改，如果需要改的话
 
+// 单调时钟，纳秒（访问日志的处理时间和数据库时间，以及各阶段的耗时）
+static long long now_ns() {
+    return metrics_now_ns();
+}
+
 
 
 // 4. 将 fd 设置为 非阻塞
@@ -71,34 +74,6 @@ int HTTP_Conn::m_epollfd = -1;
 int HTTP_Conn::m_user_count = 0;
 
 
-// 9. 将数据库中的所有用户名和密码取出，放入上面的users中
-void HTTP_Conn::init_mysql_result(Connection_Pool* connpool) {
-    // 5.1 初始化mysql连接
-    MYSQL* mysql;
-    ConnectionRAII(&mysql, connpool);
-
-    // 5.2 查询
-    if (mysql_query(mysql, "select username, passwd from user") != 0) {
-        LOG_ERROR("mysql_query() is error: %s", mysql_error(mysql));
-    }
-
-    // 5.3 获取查询结果
-    MYSQL_RES* result = mysql_store_result(mysql);
-    if (result == NULL) LOG_ERROR("mysql_store_result() is error: %s", mysql_error(mysql));
-
-    // 5.4 从结果集中获取每一行，将对应的用户名和密码，存入users中
-    while (MYSQL_ROW row = mysql_fetch_row(result)) {
-        users[row[0]] = row[1];
-    }
-
-    LOG_INFO("database info: ");
-    for (auto info : users) {
-        LOG_INFO("username: %s, password: %s", info.first.c_str(), info.second.c_str());
-    }
-    LOG_INFO(" ");
-}
-
-
 // 10. 关闭连接
 void HTTP_Conn::close_conn(bool read_close) {
     if (read_close && (m_sockfd != -1)) {
@@ -121,12 +96,12 @@ void HTTP_Conn::init(int sockfd, const sockaddr_in& addr) {
     ++m_user_count;
 
     init();
-    LOG_INFO("HTTP_Conn::init() is ok, epollfd: %d, connfd: %d, m_user_count: %d", m_epollfd, m_sockfd, m_user_count);
+    trace(TRACE_ACCEPT);
+    LOG_DEBUG("HTTP_Conn::init() is ok, epollfd: %d, connfd: %d, m_user_count: %d", m_epollfd, m_sockfd, m_user_count);
 }
 
 
 void HTTP_Conn::init() {
-    m_mysql = NULL;
     m_read_idx = 0;     
     m_checked_idx = 0;                                      
     m_start_line = 0;                    
@@ -146,6 +121,25 @@ void HTTP_Conn::init() {
     m_string  = NULL;
     m_bytes_to_send = 0;
     m_bytes_have_send = 0;
+    m_routed = false;
+
+    m_begin_ns = 0;
+    m_db_ns = 0;
+    m_status = 0;
+    m_body_len = 0;
+    m_log_url[0] = '\0';
+    m_referer = NULL;
+    m_user_agent = NULL;
+
+    m_ready_ns = 0;
+    m_queue_ns = 0;
+    m_write_ns = 0;
+    m_body_addr = NULL;
+
+    // accept 的时间对同一个连接上的所有请求有效
+    uint64_t accept_tsc = m_trace.tsc[TRACE_ACCEPT];
+    memset(&m_trace, 0, sizeof(m_trace));
+    m_trace.tsc[TRACE_ACCEPT] = accept_tsc;
 
     //char* m_file_addr = NULL;                                   
     //int m_iv_count = 0;
@@ -159,6 +153,12 @@ void HTTP_Conn::init() {
 // 12. 主线程的读操作
 bool HTTP_Conn::read() {
     if (m_read_idx >= READ_BUF_SIZE) return false;
+    long long begin = (Metrics::enabled() || Access_Log::get_instance()->enabled()) ? now_ns() : 0;
+    if (m_read_idx == 0) {
+        m_begin_ns = begin;
+        trace(TRACE_BEGIN);
+    }
+    int old_read_idx = m_read_idx;
 
     int read_bytes = 0;
 
@@ -170,11 +170,11 @@ bool HTTP_Conn::read() {
                 if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
                     break;
                 }
-                LOG_INFO("client connfd: %d recv is error", m_sockfd);
+                LOG_RATE_LIMITED(LOG_LEVEL_WARN, 10, "client connfd: %d recv is error, errno: %d", m_sockfd, errno);
                 return false;
             }
             else if (read_bytes == 0) {
-                LOG_INFO("client connfd: %d recv is close", m_sockfd);
+                LOG_DEBUG("client connfd: %d recv is close", m_sockfd);
                 return false;
             }
 
@@ -186,13 +186,20 @@ bool HTTP_Conn::read() {
         m_read_idx += read_bytes;
 
         if (read_bytes <= 0) {
-            LOG_INFO("client connfd: %d recv is close or error", m_sockfd);
+            LOG_DEBUG("client connfd: %d recv is close or error", m_sockfd);
             return false;
         }
     }
     
-    LOG_INFO("main thread read ok, recv message: ");
-    LOG_INFO(m_read_buf);
+    LOG_DEBUG("main thread read ok, recv message: %s", m_read_buf);
+    trace(TRACE_READ);
+    SERVER_PROBE2(request_read, m_sockfd, m_read_idx);
+
+    if (Metrics::enabled()) {
+        m_ready_ns = now_ns();
+        Metrics::record(STAGE_READ, m_ready_ns - begin);
+        Metrics::count(COUNTER_BYTES_READ, m_read_idx - old_read_idx);
+    }
     return true;
 }
 
@@ -208,6 +215,7 @@ bool HTTP_Conn::write() {
     // int bytes_have_send = 0;            // 7.1 已经发送的字节数
     // int bytes_to_send = m_write_idx;    // 7.2 需要发送的字节数
     int write_bytes = 0;                // 7.3 一次发送的字节数
+    long long begin = Metrics::enabled() ? now_ns() : 0;
 
     while (true) {
         write_bytes = writev(m_sockfd, m_iv, m_iv_count);
@@ -216,21 +224,24 @@ bool HTTP_Conn::write() {
             // 7.4 发送缓冲区已满，继续监视EPOLLOUT，等待下次发送
             if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
                 modfd(m_epollfd, m_sockfd, EPOLLOUT);
+                if (begin > 0) m_write_ns += now_ns() - begin;
+                SERVER_PROBE2(request_write_blocked, m_sockfd, m_bytes_have_send);
                 return true;
             }
 
             unmap();
-            LOG_INFO("main thread send error");
+            LOG_RATE_LIMITED(LOG_LEVEL_WARN, 10, "main thread send error, connfd: %d, errno: %d", m_sockfd, errno);
             return false;
         }
         
         m_bytes_have_send += write_bytes;
         m_bytes_to_send -= write_bytes;
+        Metrics::count(COUNTER_BYTES_SENT, write_bytes);
 
         if (m_bytes_have_send >= m_iv[0].iov_len)
         {
             m_iv[0].iov_len = 0;
-            m_iv[1].iov_base = m_file_addr + (m_bytes_have_send - m_write_idx);
+            m_iv[1].iov_base = (char*)m_body_addr + (m_bytes_have_send - m_write_idx);
             m_iv[1].iov_len = m_bytes_to_send;
         }
         else
@@ -243,7 +254,17 @@ bool HTTP_Conn::write() {
         if (m_bytes_to_send <= 0) {
             unmap();
             modfd(m_epollfd, m_sockfd, EPOLLIN);
-            LOG_INFO("main thread send ok, send bytes: %d", m_bytes_have_send);
+            LOG_DEBUG("main thread send ok, send bytes: %d", m_bytes_have_send);
+            SERVER_PROBE3(request_done, m_sockfd, m_status, m_bytes_have_send);
+            if (Access_Log::get_instance()->enabled()) log_access();
+            if (Slow_Request_Log::enabled()) capture_slow();
+
+            if (begin > 0) {
+                long long now = now_ns();
+                Metrics::record(STAGE_WRITE, m_write_ns + now - begin);
+                if (m_begin_ns > 0) Metrics::record(STAGE_TOTAL, now - m_begin_ns);
+                Metrics::count_status(m_status);
+            }
 
             if (m_linger) {
                 init();
@@ -259,23 +280,90 @@ bool HTTP_Conn::write() {
 
 
 // 14. 处理客户请求: 由线程池中的工作线程调用，这是处理HTTP请求的入口函数
-void HTTP_Conn::process() {
-    LOG_INFO("process_read() begin");
+// 14. 处理分两步：快队列中的线程先解析请求，需要访问数据库的请求被分到慢队列，由慢队列中的线程执行 do_request()，
+// 14. 这样大量的 登录/注册 请求不会占满所有线程，静态文件请求不用排在它们后面
+bool HTTP_Conn::process() {
+    HTTP_CODE read_ret = NO_REQUEST;
+    bool is_metrics = Metrics::enabled();
+    long long begin = is_metrics ? now_ns() : 0;
+    if (is_metrics) m_queue_ns += begin - m_ready_ns;
+    trace(m_routed ? TRACE_SLOW_PICKUP : TRACE_PICKUP);
+
+    if (!m_routed) {
+        LOG_DEBUG("process_read() begin");
+        read_ret = process_read();
+        LOG_DEBUG("process_read() end, read_ret: %d", read_ret);
+        if (is_metrics) Metrics::record(STAGE_PARSE, now_ns() - begin);
+        trace(TRACE_PARSE);
+
+        if (read_ret == NO_REQUEST) {
+            modfd(m_epollfd, m_sockfd, EPOLLIN);
+            return true;
+        }
+
+        if (read_ret == GET_REQUEST) {
+            if (is_slow_request()) {
+                m_routed = true;
+                if (is_metrics) m_ready_ns = now_ns();
+                return false;
+            }
+            read_ret = run_request();
+        }
+    }
+    else {
+        m_routed = false;
+        read_ret = run_request();
+    }
+
+    bool write_ret = process_write(read_ret);
+    if (!write_ret) {
+        close_conn();
+    }
+    if (is_metrics) Metrics::record(STAGE_QUEUE, m_queue_ns);
+
+    modfd(m_epollfd, m_sockfd, EPOLLOUT);
+    return true;
+}
+
+
+#ifdef CORO_POOL
+// 14.1 协程版本的 process()：解析请求、填充应答在调度线程中执行，
+//      数据库查询（登录/注册）和读入不在 page cache 中的文件会阻塞，交给阻塞线程，期间协程挂起，不占用调度线程
+Coro_Task HTTP_Conn::serve(Coro_Scheduler* scheduler) {
+    bool is_metrics = Metrics::enabled();
+    long long begin = is_metrics ? now_ns() : 0;
+    if (is_metrics) m_queue_ns += begin - m_ready_ns;
+
+    trace(TRACE_PICKUP);
+
     HTTP_CODE read_ret = process_read();
-    LOG_INFO("process_read() end, read_ret: %d", read_ret);
+    LOG_DEBUG("process_read() end, read_ret: %d", read_ret);
+    if (is_metrics) Metrics::record(STAGE_PARSE, now_ns() - begin);
+    trace(TRACE_PARSE);
 
     if (read_ret == NO_REQUEST) {
         modfd(m_epollfd, m_sockfd, EPOLLIN);
-        return;
+        co_return;
+    }
+
+    if (read_ret == GET_REQUEST) {
+        if (is_slow_request()) read_ret = co_await scheduler->offload([this] { trace(TRACE_SLOW_PICKUP); return run_request(); });
+        else read_ret = run_request();
+    }
+
+    if (read_ret == FILE_REQUEST && file_is_cold()) {
+        co_await scheduler->offload([this] { prefault_file(); return 0; });
     }
 
     bool write_ret = process_write(read_ret);
     if (!write_ret) {
         close_conn();
     }
+    if (is_metrics) Metrics::record(STAGE_QUEUE, m_queue_ns);
 
     modfd(m_epollfd, m_sockfd, EPOLLOUT);
 }
+#endif
 
 
 // 15. 解析HTTP请求，由子线程负责处理 
@@ -289,8 +377,8 @@ HTTP_Conn::HTTP_CODE HTTP_Conn::process_read() {
         text = get_line();
         m_start_line = m_checked_idx;
 
-        LOG_INFO("m_check_state: %d, line_status: %d", m_check_state, line_status);
-        LOG_INFO("got 1 http line: %s", text);
+        LOG_DEBUG("m_check_state: %d, line_status: %d", m_check_state, line_status);
+        LOG_DEBUG("got 1 http line: %s", text);
 
         switch (m_check_state) 
         {
@@ -306,7 +394,7 @@ HTTP_Conn::HTTP_CODE HTTP_Conn::process_read() {
             {
                 http_ret = parse_headers(text);
                 if (http_ret == BAD_REQUEST) return BAD_REQUEST;
-                else if (http_ret == GET_REQUEST) return do_request();
+                else if (http_ret == GET_REQUEST) return GET_REQUEST;
 
                 break;
             }
@@ -315,7 +403,7 @@ HTTP_Conn::HTTP_CODE HTTP_Conn::process_read() {
             {
                 http_ret = parse_content(text);
                 if (http_ret == GET_REQUEST) {
-                    return do_request();
+                    return GET_REQUEST;
                 }
 
                 line_status = LINE_OPEN;
@@ -391,6 +479,7 @@ bool HTTP_Conn::process_write(HTTP_CODE ret) {
                 m_iv[1].iov_base = m_file_addr;
                 m_iv[1].iov_len = m_file_stat.st_size;
                 m_iv_count = 2;
+                m_body_addr = m_file_addr;
 
                 m_bytes_to_send = m_write_idx + m_file_stat.st_size;
 
@@ -471,11 +560,11 @@ HTTP_Conn::HTTP_CODE HTTP_Conn::parse_request_line(char* text) {
     // 2. strcasecmp(s1, s2): 比较参数 s1 和 s2 字符串，比较时会自动忽略大小写的差异
     char* method = text;                            // method: "GET"
     if (strcasecmp(method, "GET") == 0) {
-        LOG_INFO("m_method == GET");
+        LOG_DEBUG("m_method == GET");
         m_method = GET;
     }
     else if (strcasecmp(method, "POST") == 0){
-        LOG_INFO("m_method == POST");
+        LOG_DEBUG("m_method == POST");
         m_method = POST;
         m_cgi = 1;
     }
@@ -491,7 +580,7 @@ HTTP_Conn::HTTP_CODE HTTP_Conn::parse_request_line(char* text) {
     m_version += strspn(m_version, " \t");          // m_version: "HTTP/1.1"
 
     if (strcasecmp(m_version, "HTTP/1.1") == 0) {
-        LOG_INFO("HTTP version == 1.1");
+        LOG_DEBUG("HTTP version == 1.1");
     }
     else {
         return BAD_REQUEST;
@@ -512,9 +601,13 @@ HTTP_Conn::HTTP_CODE HTTP_Conn::parse_request_line(char* text) {
         return BAD_REQUEST;
     }
 
+    // 访问日志和慢请求记录请求行中原来的 url
+    if (Access_Log::get_instance()->enabled() || Slow_Request_Log::enabled()) snprintf(m_log_url, FILENAME_LEN, "%s", m_url);
+
     // 当url为/时，显示判断界面
     if (strlen(m_url) == 1) strcat(m_url, "judge.html");    // m_url: "/judge.html"
-    LOG_INFO("m_url: %s", m_url);
+    LOG_DEBUG("m_url: %s", m_url);
+    SERVER_PROBE3(request_line, m_sockfd, (int)m_method, m_url);
 
     m_check_state = CHECK_STATE_HEADER;
     return NO_REQUEST;
@@ -560,7 +653,18 @@ HTTP_Conn::HTTP_CODE HTTP_Conn::parse_headers(char* text) {
         m_host = text;      // m_host: "10.0.0.103"
     }
 
-    // 5. else
+    // 5. Referer 和 User-Agent 只用于访问日志
+    else if (strncasecmp(text, "Referer:", 8) == 0) {
+        text += 8;
+        m_referer = text + strspn(text, " \t");
+    }
+
+    else if (strncasecmp(text, "User-Agent:", 11) == 0) {
+        text += 11;
+        m_user_agent = text + strspn(text, " \t");
+    }
+
+    // 6. else
     else {
         //LOG_INFO("unknow header: %s", text);
     }
@@ -583,13 +687,13 @@ HTTP_Conn::HTTP_CODE HTTP_Conn::parse_content(char* text) {
 HTTP_Conn::HTTP_CODE HTTP_Conn::do_request() {
     // 1. m_real_file = doc_root + m_url
     // doc_root = "/home/mjh/github/TinyWebServer/root", m_url = "/judge.html"
-    LOG_INFO("in do_request(), doc_root: %s, m_url: %s", doc_root, m_url);
+    LOG_DEBUG("in do_request(), doc_root: %s, m_url: %s", doc_root, m_url);
 
     strcpy(m_real_file, doc_root);
     int len = strlen(doc_root);
 
     const char* p = strrchr(m_url, '/');
-    LOG_INFO("*(p + 1) == %c, p: %s", *(p + 1), p);
+    LOG_DEBUG("*(p + 1) == %c, p: %s", *(p + 1), p);
 
     // 2. 处理cgi
     if (m_cgi == 1 && (*(p + 1) == '2' || *(p + 1) == '3'))
@@ -624,29 +728,14 @@ HTTP_Conn::HTTP_CODE HTTP_Conn::do_request() {
         {
             //如果是注册，先检测数据库中是否有重名的
             //没有重名的，进行增加数据
-            char *sql_insert = (char *)malloc(sizeof(char) * 200);
-            strcpy(sql_insert, "INSERT INTO user(username, passwd) VALUES(");
-            strcat(sql_insert, "'");
-            strcat(sql_insert, name);
-            strcat(sql_insert, "', '");
-            strcat(sql_insert, password);
-            strcat(sql_insert, "')");
-
-            if (users.find(name) == users.end())
-            {
+            long long db_begin = now_ns();
+            bool added = User_Table::get_instance()->add_user(name, password);
+            m_db_ns += now_ns() - db_begin;
 
-                m_lock.lock();
-                int res = mysql_query(m_mysql, sql_insert);
-                users.insert(pair<string, string>(name, password));
-                m_lock.unlock();
-
-                if (!res)
-                {
-                    strcpy(m_url, "/log.html");
-                    LOG_INFO("register ok");
-                }
-                else
-                    strcpy(m_url, "/registerError.html");
+            if (added)
+            {
+                strcpy(m_url, "/log.html");
+                LOG_INFO("register ok");
             }
             else
                 strcpy(m_url, "/registerError.html");
@@ -655,7 +744,11 @@ HTTP_Conn::HTTP_CODE HTTP_Conn::do_request() {
         //若浏览器端输入的用户名和密码在表中可以查找到，返回1，否则返回0
         else if (*(p + 1) == '2')
         {
-            if (users.find(name) != users.end() && users[name] == password)
+            long long db_begin = now_ns();
+            bool verified = User_Table::get_instance()->verify(name, password);
+            m_db_ns += now_ns() - db_begin;
+
+            if (verified)
                 strcpy(m_url, "/welcome.html");
             else
                 strcpy(m_url, "/logError.html");
@@ -711,7 +804,7 @@ HTTP_Conn::HTTP_CODE HTTP_Conn::do_request() {
     else {
         strncpy(m_real_file + len, m_url, FILENAME_LEN - len - 1);
     }
-    LOG_INFO("m_real_file: %s", m_real_file);
+    LOG_DEBUG("m_real_file: %s", m_real_file);
 
 
     // 9. 目标文件是否存在, 当前用户是否有读取目标文件的权限, 目标文件是一个目录
@@ -727,6 +820,128 @@ HTTP_Conn::HTTP_CODE HTTP_Conn::do_request() {
     return FILE_REQUEST;
 }
 
+// 17.6 是否是需要访问数据库的请求：与 do_request() 中的判断相同，POST 且 url 的最后一段以 '2'（登录）或 '3'（注册）开头
+bool HTTP_Conn::is_slow_request() {
+    if (m_cgi != 1 || m_url == NULL) return false;
+
+    const char* p = strrchr(m_url, '/');
+    return p != NULL && (*(p + 1) == '2' || *(p + 1) == '3');
+}
+
+
+
+// 17.6 do_request()，并记录 handle 阶段的耗时（静态文件的 stat/mmap，或者登录/注册访问数据库）
+HTTP_Conn::HTTP_CODE HTTP_Conn::run_request() {
+    long long begin = Metrics::enabled() ? now_ns() : 0;
+    HTTP_CODE ret = do_request();
+    if (begin > 0) Metrics::record(STAGE_HANDLE, now_ns() - begin);
+    trace(TRACE_REQUEST);
+    return ret;
+}
+
+
+
+// 17.7 mincore() 检查 mmap 的目标文件是否全部在 page cache 中，不在时 writev 会在缺页中阻塞
+bool HTTP_Conn::file_is_cold() {
+    if (!m_file_addr || m_file_stat.st_size == 0) return false;
+
+    long page = sysconf(_SC_PAGESIZE);
+    size_t pages = (m_file_stat.st_size + page - 1) / page;
+    unsigned char vec[256];
+    if (pages > sizeof(vec)) return true;       // 大文件不逐页检查，直接交给阻塞线程
+
+    if (mincore(m_file_addr, m_file_stat.st_size, vec) != 0) return false;
+    for (size_t i = 0; i < pages; ++i) {
+        if (!(vec[i] & 1)) return true;
+    }
+    return false;
+}
+
+// 17.8 每页读一个字节，在阻塞线程中完成缺页
+void HTTP_Conn::prefault_file() {
+    long page = sysconf(_SC_PAGESIZE);
+    volatile const char* addr = m_file_addr;
+    for (off_t off = 0; off < m_file_stat.st_size; off += page) {
+        (void)addr[off];
+    }
+}
+
+
+// 17.9 应答写完：写一行访问日志（请求行中的 url、状态码、消息体长度、处理时间、数据库时间）
+void HTTP_Conn::log_access() {
+    Access_Record record;
+    record.addr = &m_addr;
+    record.method = (m_method == POST) ? "POST" : "GET";
+    record.url = m_log_url;
+    record.protocol = "HTTP/1.1";
+    record.status = m_status;
+    record.body_bytes = m_body_len;
+    record.sent_bytes = m_bytes_have_send;
+    record.duration_us = m_begin_ns > 0 ? (now_ns() - m_begin_ns) / 1000 : 0;
+    record.db_us = m_db_ns / 1000;
+    record.referer = m_referer;
+    record.user_agent = m_user_agent;
+    Access_Log::get_instance()->write(record);
+}
+
+
+
+// 17.10 请求是不是 GET path：请求行完全匹配，并且头部已经读完（GET 没有消息体）
+bool HTTP_Conn::match_path(const char* path) {
+    int len = strlen(path);
+    if (m_read_idx < 4 + len + 1 || strncmp(m_read_buf, "GET ", 4) != 0 || strncmp(m_read_buf + 4, path, len) != 0) {
+        return false;
+    }
+
+    char c = m_read_buf[4 + len];
+    if (c != ' ' && c != '?') return false;
+    return memmem(m_read_buf, m_read_idx, "\r\n\r\n", 4) != NULL;
+}
+
+
+// 17.11 主线程直接回复：解析请求（保持连接、访问日志需要的头部），200 + body，然后立即写
+//       body 由主线程持有（HTTP_Conn 中不放 std::string，连接数组保持平凡构造，new 时不会写每一页）
+bool HTTP_Conn::reply(const char* content_type, const char* body, int len) {
+    if (process_read() != GET_REQUEST) return false;
+
+    add_status_line(200, ok_200_title);
+    add_response("Content-Type: %s\r\n", content_type);
+    add_headers(len);
+
+    m_iv[0].iov_base = m_write_buf;
+    m_iv[0].iov_len = m_write_idx;
+    m_iv[1].iov_base = (char*)body;
+    m_iv[1].iov_len = len;
+    m_iv_count = 2;
+    m_body_addr = body;
+    m_bytes_to_send = m_write_idx + len;
+
+    return write();
+}
+
+
+
+// 17.12 应答写完：从开始读到写完超过阈值时，把跟踪记录连同 url、客户端地址放进慢请求记录
+void HTTP_Conn::capture_slow() {
+    trace(TRACE_WRITE);
+
+    Slow_Request_Log* slow_log = Slow_Request_Log::get_instance();
+    if (!slow_log->is_slow(m_trace)) return;
+
+    Slow_Request request;
+    request.trace = m_trace;
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    request.wall_ns = ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    request.addr = m_addr;
+    request.sockfd = m_sockfd;
+    request.status = m_status;
+    request.is_post = (m_method == POST);
+    request.bytes = m_bytes_have_send;
+    snprintf(request.url, sizeof(request.url), "%s", m_log_url);
+    slow_log->capture(request);
+}
+
 
 
 // 18. 下面这组函数被process_write()调用，以填充HTTP应答
@@ -755,6 +970,7 @@ bool HTTP_Conn::add_response(const char* format, ...) {
 }
 
 bool HTTP_Conn::add_content_len(int content_len) {
+    m_body_len = content_len;
     return add_response("Content-Length: %d\r\n", content_len);
 }
 
@@ -762,15 +978,22 @@ bool HTTP_Conn::add_linger() {
     return add_response("Connection: %s\r\n", (m_linger == true) ? "keep-alive" : "close");
 }
 
+// Date 头部（RFC 7231 7.1.1.2），值由每个线程的时间缓存按秒格式化
+bool HTTP_Conn::add_date() {
+    return add_response("Date: %s\r\n", Clock_Cache::local().http_date());
+}
+
 bool HTTP_Conn::add_blank_line() {
     return add_response("%s", "\r\n");
 }
 
 bool HTTP_Conn::add_status_line(int status, const char* title) {
+    m_status = status;
     return add_response("%s %d %s\r\n", "HTTP/1.1", status, title);
 }
 
 bool HTTP_Conn::add_headers(int content_len) {
+    add_date();
     add_content_len(content_len);
     add_linger();
     add_blank_line();
@@ -22,12 +22,23 @@
 #include <sys/mman.h>
 #include <sys/uio.h>
 #include <map>
-#include <mysql/mysql.h>
+#include <string>
 #include <fstream>
 
 #include "../log/log.h"
+#include "../log/access_log.h"
+#include "../metrics/metrics.h"
+#include "../metrics/request_trace.h"
+#include "../metrics/probes.h"
 #include "../lock/locker.h"
-#include "../connectionpool/mysql_connection_pool.h"
+#include "../user/user_table.h"
+#ifdef CORO_POOL
+#include "../threadpool/coro_scheduler.h"
+#endif
+
+
+// 1. 网站的根目录（定义在 http_conn.cpp 中），main() 中可以用环境变量 DOC_ROOT 覆盖
+extern const char* doc_root;
 
 
 // 2. 将 fd 设置为 非阻塞
@@ -96,7 +107,6 @@ public:
 public:
     static int m_epollfd;                   // 8. epollfd
     static int m_user_count;                // 9. 记录用户数量
-    MYSQL* m_mysql;                         // 10. 一个mysql连接
     int m_sockfd;                           // 11. 客户的socket
 
 private:
@@ -130,6 +140,21 @@ private:
     char* m_string;                         // 32. 存储请求头数据
     int m_bytes_to_send;                    // 33. 待发送的字节数
     int m_bytes_have_send;                  // 33. 已经发送的字节数
+    bool m_routed;                          // 33. 请求已经解析完毕，被分到慢队列，等待执行 do_request()
+
+    long long m_begin_ns;                   // 34. 访问日志：读到请求第一个字节的时间（单调时钟）
+    long long m_db_ns;                      // 34. 访问日志：do_request() 中访问数据库的时间
+    int m_status;                           // 34. 访问日志：应答的状态码
+    long long m_body_len;                   // 34. 访问日志：应答消息体的长度
+    char m_log_url[FILENAME_LEN];           // 34. 访问日志、慢请求：请求行中的 url（do_request() 会改写 m_url）
+    char* m_referer;                        // 34. 访问日志：Referer 头部
+    char* m_user_agent;                     // 34. 访问日志：User-Agent 头部
+
+    long long m_ready_ns;                   // 34. 指标：请求读完（交给线程池）的时间
+    long long m_queue_ns;                   // 34. 指标：在线程池中排队的时间之和（慢请求排两次队）
+    long long m_write_ns;                   // 34. 指标：主线程写应答的时间之和（发送缓冲区满时分多次写）
+    const char* m_body_addr;                // 34. 消息体（mmap 的文件或者主线程直接回复的 body）的起始位置，部分发送后从这里继续
+    Request_Trace m_trace;                  // 34. 当前请求经过各个时间点时的时间戳计数器，写完时超过阈值的请求放进慢请求记录
 
 
 public:
@@ -140,11 +165,20 @@ public:
 public:
     void init(int sockfd, const sockaddr_in& addr);      // 35. 初始化新接收的连接
     void close_conn(bool read_close = true);             // 36. 关闭连接
-    void process();                                      // 37. 处理客户请求
+    bool process();                                      // 37. 处理客户请求，返回 false 表示需要放到慢队列中继续处理
+#ifdef CORO_POOL
+    Coro_Task serve(Coro_Scheduler* scheduler);          // 37.1 协程版本的 process()，数据库查询和读入冷文件交给阻塞线程
+#endif
     bool read();                                         // 38. 非阻塞读操作
     bool write();                                        // 39. 非阻塞写操作
     sockaddr_in* get_addr() { return &m_addr; }          // 40. 获取地址
-    void init_mysql_result(Connection_Pool* connpool);   // 41. 获取 数据库中的用户名和密码
+    bool match_path(const char* path);                   // 41. 读到的是不是 GET path 的完整请求（由主线程直接回复，不经过线程池）
+    bool reply(const char* content_type, const char* body, int len);  // 41. 主线程直接回复 200 + body（调用者保证写完之前 body 有效），返回 false 表示需要关闭连接
+
+    // 41. 请求跟踪：记下当前请求经过 point 的时间
+    void trace(Trace_Point point) {
+        if (Slow_Request_Log::enabled()) m_trace.tsc[point] = Slow_Request_Log::now();
+    }
 
 private:
     // 42. 初始化连接
@@ -163,6 +197,12 @@ private:
     HTTP_CODE parse_headers(char* text);                // 45.3 分析头部字段
     HTTP_CODE parse_content(char* text);                // 45.4 分析内容字段
     HTTP_CODE do_request();                             // 45.5 分析目标文件的属性
+    HTTP_CODE run_request();                            // 45.5 do_request()，并记录 handle 阶段的耗时
+    bool is_slow_request();                             // 45.6 是否是需要访问数据库的 登录/注册 请求
+    bool file_is_cold();                                // 45.7 mmap 的目标文件是否有页面不在 page cache 中
+    void prefault_file();                               // 45.8 逐页读一次目标文件，把它读入 page cache
+    void log_access();                                  // 45.9 应答写完，写一行访问日志
+    void capture_slow();                                // 45.10 应答写完，超过阈值时放进慢请求记录
     
 
     // 46. 下面这组函数被process_write()调用，以填充HTTP应答
@@ -173,6 +213,7 @@ private:
     bool add_headers(int content_len);
     bool add_content_len(int content_len);
     bool add_linger();
+    bool add_date();
     bool add_blank_line();
 };
 
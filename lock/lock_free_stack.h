@@ -0,0 +1,120 @@
+// 固定容量的无锁栈（Treiber stack），用于数据库连接池的空闲连接链表
+// 1. 节点在构造时一次性分配，push/pop 不再像 std::list 那样每次 new 一个节点
+// 2. 栈顶是 (tag << 32 | index) 打包的 64 位整数，每次 CAS 时 tag + 1，避免 ABA 问题
+// 3. 快路径只有一次 CAS；栈空时才进入慢路径，在信号量上睡眠
+
+#ifndef LOCK_FREE_STACK_H
+#define LOCK_FREE_STACK_H
+
+#include <atomic>
+#include <exception>
+#include <stdint.h>
+#include "locker.h"
+
+
+template<typename T>
+class Lock_Free_Stack {
+private:
+    // 1. 节点：next 是下一个节点在 m_nodes 中的下标
+    struct Node {
+        T value;
+        std::atomic<uint32_t> next;
+    };
+
+    static const uint32_t NIL = 0xffffffffu;
+
+    // 2. 成员变量，两个栈顶各占一个 cache line，避免伪共享
+    Node* m_nodes;                                  // 2.1 预分配的节点数组
+    int m_capacity;                                 // 2.2 容量
+    alignas(64) std::atomic<uint64_t> m_head;       // 2.3 数据栈的栈顶
+    alignas(64) std::atomic<uint64_t> m_free;       // 2.4 空闲节点栈的栈顶
+    alignas(64) std::atomic<int> m_waiters;         // 2.5 在 m_sem 上睡眠（或准备睡眠）的线程数
+    Sem m_sem;                                      // 2.6 慢路径用的信号量，只用来唤醒
+
+
+public:
+    // 3. 构造函数和析构函数
+    Lock_Free_Stack(int capacity) : m_nodes(NULL), m_capacity(capacity), m_head(NIL), m_free(NIL), m_waiters(0)
+    {
+        if (capacity <= 0) throw std::exception();
+
+        m_nodes = new Node[capacity];
+        for (int i = 0; i < capacity; ++i) {
+            m_nodes[i].next.store(i + 1 < capacity ? i + 1 : NIL, std::memory_order_relaxed);
+        }
+        m_free.store(0);
+    }
+
+    ~Lock_Free_Stack() {
+        delete[] m_nodes;
+    }
+
+    // 4. 入栈，栈已满时返回 false；如果有线程在等待，就唤醒一个
+    bool push(const T& value) {
+        uint32_t idx = pop_index(m_free);
+        if (idx == NIL) return false;
+
+        m_nodes[idx].value = value;
+        push_index(m_head, idx);
+
+        // push 与 pop_wait 中的 ++m_waiters 都是 seq_cst，
+        // 所以要么这里看到了等待者，要么等待者在睡眠前的 try_pop 能看到这个元素
+        if (m_waiters.load() > 0) m_sem.post_sem();
+        return true;
+    }
+
+    // 5. 非阻塞出栈，栈空时返回 false
+    bool try_pop(T& value) {
+        uint32_t idx = pop_index(m_head);
+        if (idx == NIL) return false;
+
+        value = m_nodes[idx].value;
+        push_index(m_free, idx);
+        return true;
+    }
+
+    // 6. 阻塞出栈：先走无锁快路径，失败后才在信号量上等待
+    void pop_wait(T& value) {
+        if (try_pop(value)) return;
+
+        ++m_waiters;
+        while (!try_pop(value)) {
+            m_sem.wait_sem();
+        }
+        --m_waiters;
+    }
+
+    int capacity() { return m_capacity; }
+
+
+private:
+    // 7. 从 top 指向的栈中取出一个节点下标
+    uint32_t pop_index(std::atomic<uint64_t>& top) {
+        uint64_t old_top = top.load();
+
+        while (true) {
+            uint32_t idx = (uint32_t)old_top;
+            if (idx == NIL) return NIL;
+
+            uint64_t next = m_nodes[idx].next.load(std::memory_order_relaxed);
+            uint64_t new_top = ((old_top >> 32) + 1) << 32 | next;
+            if (top.compare_exchange_weak(old_top, new_top)) return idx;
+        }
+    }
+
+    // 8. 将节点下标压入 top 指向的栈
+    void push_index(std::atomic<uint64_t>& top, uint32_t idx) {
+        uint64_t old_top = top.load();
+
+        while (true) {
+            m_nodes[idx].next.store((uint32_t)old_top, std::memory_order_relaxed);
+
+            uint64_t new_top = ((old_top >> 32) + 1) << 32 | idx;
+            if (top.compare_exchange_weak(old_top, new_top)) return;
+        }
+    }
+};
+
+
+
+#endif
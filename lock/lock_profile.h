@@ -0,0 +1,251 @@
+// 锁竞争分析，只在 make LOCK_PROFILE=1（-DLOCK_PROFILE）时编译进 locker.h 中的锁，关闭时锁的代码与原来完全相同
+// 1. 加锁点（lock site）是调用 lock() / wait_sem() / wait_cond() 的源码位置，由 __builtin_FILE() / __builtin_LINE() 作为默认参数得到，调用处不用改
+// 2. 每个线程一张加锁点的表，记录 加锁次数、等待时间、持有时间 的直方图（按 2 的整数次幂分桶，纳秒），
+//    只有本线程写，计数器用 relaxed 的 load + store，不需要原子加，也没有线程之间的缓存行争抢
+// 3. dump() 汇总所有线程的表，按总等待时间从大到小输出；主线程收到 SIGUSR2 时调用
+
+#ifndef LOCK_PROFILE_H
+#define LOCK_PROFILE_H
+
+#include <atomic>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+
+class Lock_Profile {
+public:
+    static const int BUCKETS = 40;          // 直方图的桶数：桶 i 为 [2^i, 2^(i+1)) 纳秒
+    static const int SITES = 256;           // 每个线程最多记录的加锁点数，超过后新的加锁点不再记录
+    static const int MAX_THREADS = 1024;    // 最多记录的线程数
+
+    // 1. 一个线程在一个加锁点上的统计
+    struct Site {
+        const char* file;                                   // 1.1 加锁点，file 为 NULL 表示空槽
+        int line;
+        const char* kind;                                   // 1.2 锁的类型
+        std::atomic<unsigned long long> count;              // 1.3 加锁次数
+        std::atomic<unsigned long long> wait_ns;            // 1.4 总等待时间
+        std::atomic<unsigned long long> hold_ns;            // 1.5 总持有时间
+        std::atomic<unsigned long long> wait_hist[BUCKETS]; // 1.6 等待时间的直方图
+        std::atomic<unsigned long long> hold_hist[BUCKETS]; // 1.7 持有时间的直方图
+    };
+
+    // 2. 单调时钟，纳秒
+    static long long now_ns() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    }
+
+    // 3. 记录一次加锁的等待时间（加锁次数加一）
+    static void record_wait(const char* kind, const char* file, int line, long long ns) {
+        Site* site = find(kind, file, line);
+        if (site == NULL) return;
+
+        add(site->count, 1);
+        add(site->wait_ns, ns);
+        add(site->wait_hist[bucket(ns)], 1);
+    }
+
+    // 4. 记录一次持有时间：file/line 是加锁时的位置
+    static void record_hold(const char* kind, const char* file, int line, long long ns) {
+        Site* site = find(kind, file, line);
+        if (site == NULL) return;
+
+        add(site->hold_ns, ns);
+        add(site->hold_hist[bucket(ns)], 1);
+    }
+
+    // 5. 汇总所有线程，按总等待时间从大到小输出到 fp
+    static void dump(FILE* fp) {
+        static Site total[SITES * 4];
+        int n = 0;
+
+        pthread_mutex_lock(registry_lock());
+        for (int t = 0; t < thread_count(); ++t) {
+            Site* sites = registry()[t];
+            for (int i = 0; i < SITES; ++i) {
+                if (__atomic_load_n(&sites[i].file, __ATOMIC_ACQUIRE) == NULL) continue;
+
+                int j = 0;
+                while (j < n && !(total[j].line == sites[i].line && strcmp(total[j].file, sites[i].file) == 0 &&
+                                  strcmp(total[j].kind, sites[i].kind) == 0)) ++j;
+                if (j == n) {
+                    if (n == SITES * 4) continue;
+                    clear(total[n]);
+                    total[n].file = sites[i].file;
+                    total[n].line = sites[i].line;
+                    total[n].kind = sites[i].kind;
+                    ++n;
+                }
+
+                merge(total[j], sites[i]);
+            }
+        }
+        pthread_mutex_unlock(registry_lock());
+
+        // 按总等待时间排序（插入排序，加锁点不多）
+        int order[SITES * 4];
+        for (int i = 0; i < n; ++i) {
+            int j = i;
+            while (j > 0 && total[order[j - 1]].wait_ns.load() < total[i].wait_ns.load()) {
+                order[j] = order[j - 1];
+                --j;
+            }
+            order[j] = i;
+        }
+
+        time_t now = time(NULL);
+        fprintf(fp, "# lock profile at %s", ctime(&now));
+        fprintf(fp, "# %-40s %-9s %12s %12s %10s %10s %12s %10s %10s\n", "site", "kind", "count",
+                "wait_us", "wait_p50", "wait_p99", "hold_us", "hold_p50", "hold_p99");
+        for (int i = 0; i < n; ++i) {
+            Site& s = total[order[i]];
+            char where[256];
+            snprintf(where, sizeof(where), "%s:%d", s.file, s.line);
+            fprintf(fp, "  %-40s %-9s %12llu %12llu %10llu %10llu %12llu %10llu %10llu\n", where, s.kind,
+                    s.count.load(), s.wait_ns.load() / 1000, percentile(s.wait_hist, 50), percentile(s.wait_hist, 99),
+                    s.hold_ns.load() / 1000, percentile(s.hold_hist, 50), percentile(s.hold_hist, 99));
+        }
+        fflush(fp);
+    }
+
+private:
+    // 6. 所有线程的表：线程第一次加锁时注册，线程退出后保留，统计不会丢失
+    static Site** registry() {
+        static Site* threads[MAX_THREADS];
+        return threads;
+    }
+
+    static std::atomic<int>& registered() {
+        static std::atomic<int> count(0);
+        return count;
+    }
+
+    static int thread_count() {
+        int n = registered().load(std::memory_order_acquire);
+        return n < MAX_THREADS ? n : MAX_THREADS;
+    }
+
+    // 不能用 locker.h 中的 Mutex，否则会递归地记录自己
+    static pthread_mutex_t* registry_lock() {
+        static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+        return &lock;
+    }
+
+    static Site* thread_sites() {
+        static thread_local Site* sites = NULL;
+        if (sites != NULL) return sites;
+
+        sites = new Site[SITES];
+        for (int i = 0; i < SITES; ++i) clear(sites[i]);
+
+        pthread_mutex_lock(registry_lock());
+        int n = registered().load();
+        if (n < MAX_THREADS) registry()[n] = sites;
+        registered().store(n + 1, std::memory_order_release);
+        pthread_mutex_unlock(registry_lock());
+
+        return sites;
+    }
+
+    // 7. 在本线程的表中查找加锁点，没有时插入（开放寻址）
+    static Site* find(const char* kind, const char* file, int line) {
+        Site* sites = thread_sites();
+        unsigned long h = ((unsigned long)file >> 4) ^ ((unsigned long)line * 2654435761UL) ^ ((unsigned long)kind >> 4);
+
+        for (int probe = 0; probe < SITES; ++probe) {
+            Site& site = sites[(h + probe) % SITES];
+            if (site.file == file && site.line == line && site.kind == kind) return &site;
+            if (site.file == NULL) {
+                // 先写 kind/line 再写 file，dump() 看到 file 不为 NULL 时其他字段已经写好
+                site.kind = kind;
+                site.line = line;
+                __atomic_store_n(&site.file, file, __ATOMIC_RELEASE);
+                return &site;
+            }
+        }
+        return NULL;
+    }
+
+    static int bucket(long long ns) {
+        if (ns <= 1) return 0;
+        int b = 63 - __builtin_clzll((unsigned long long)ns);
+        return b < BUCKETS ? b : BUCKETS - 1;
+    }
+
+    // 只有本线程写，不需要原子加
+    static void add(std::atomic<unsigned long long>& counter, long long value) {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    static void clear(Site& site) {
+        site.file = NULL;
+        site.line = 0;
+        site.kind = NULL;
+        site.count.store(0);
+        site.wait_ns.store(0);
+        site.hold_ns.store(0);
+        for (int i = 0; i < BUCKETS; ++i) {
+            site.wait_hist[i].store(0);
+            site.hold_hist[i].store(0);
+        }
+    }
+
+    static void merge(Site& to, Site& from) {
+        to.count.store(to.count.load() + from.count.load(std::memory_order_relaxed));
+        to.wait_ns.store(to.wait_ns.load() + from.wait_ns.load(std::memory_order_relaxed));
+        to.hold_ns.store(to.hold_ns.load() + from.hold_ns.load(std::memory_order_relaxed));
+        for (int i = 0; i < BUCKETS; ++i) {
+            to.wait_hist[i].store(to.wait_hist[i].load() + from.wait_hist[i].load(std::memory_order_relaxed));
+            to.hold_hist[i].store(to.hold_hist[i].load() + from.hold_hist[i].load(std::memory_order_relaxed));
+        }
+    }
+
+    // 第 percent 百分位数所在桶的上界（纳秒），没有样本时返回 0
+    static unsigned long long percentile(std::atomic<unsigned long long>* hist, int percent) {
+        unsigned long long count = 0;
+        for (int i = 0; i < BUCKETS; ++i) count += hist[i].load();
+        if (count == 0) return 0;
+
+        unsigned long long rank = count * percent / 100, seen = 0;
+        for (int i = 0; i < BUCKETS; ++i) {
+            seen += hist[i].load();
+            if (seen > rank) return 2ULL << i;
+        }
+        return 2ULL << (BUCKETS - 1);
+    }
+};
+
+
+// 8. 锁对象中记录当前持有者的加锁点和加锁时间，解锁时算出持有时间（由持有者读写，不需要同步）
+struct Lock_Hold {
+    const char* file;
+    int line;
+    long long begin;
+
+    Lock_Hold() : file(NULL), line(0), begin(0) {}
+
+    void acquired(const char* kind, const char* site_file, int site_line, long long wait_begin) {
+        begin = Lock_Profile::now_ns();
+        file = site_file;
+        line = site_line;
+        Lock_Profile::record_wait(kind, site_file, site_line, begin - wait_begin);
+    }
+
+    void released(const char* kind) {
+        if (file == NULL) return;
+        Lock_Profile::record_hold(kind, file, line, Lock_Profile::now_ns() - begin);
+        file = NULL;
+    }
+};
+
+
+// 9. 加锁点参数：作为 lock() 等函数的默认参数，在调用处展开成调用者的文件名和行号
+#define LOCK_SITE const char* site_file = __builtin_FILE(), int site_line = __builtin_LINE()
+
+
+
+#endif
@@ -1,10 +1,34 @@
 #ifndef LOCKER_H
 #define LOCKER_H
 
-// 将线程的3种同步机制包装成类
+// 将线程的3种同步机制包装成类，另外提供一个 futex 的简单封装，以及几种按场景选用的锁：
+// 临界区很短时用 Adaptive_Mutex（先自旋再睡眠），读多写少时用 RW_Lock（写优先），需要严格先来先服务时用 Ticket_Lock
+#include <atomic>
 #include <exception>
+#include <time.h>
+#include <sched.h>
 #include <pthread.h>
 #include <semaphore.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+// make LOCK_PROFILE=1 时记录每个加锁点的等待/持有时间，见 lock_profile.h；关闭时 LOCK_SITE 为空，锁的代码不变
+#ifdef LOCK_PROFILE
+#include "lock_profile.h"
+#else
+#define LOCK_SITE
+#endif
+
+
+// 0. 自旋等待时调用，降低功耗并让出流水线给同一个核上的另一个超线程
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield" ::: "memory");
+#endif
+}
 
 
 // 1. 封装信号量的class
@@ -32,8 +56,15 @@ public:
     }
 
     // 1.3 等待信号量
-    bool wait_sem() {
+    bool wait_sem(LOCK_SITE) {
+#ifdef LOCK_PROFILE
+        long long begin = Lock_Profile::now_ns();
+        bool ok = sem_wait(&m_sem) == 0;
+        Lock_Profile::record_wait("sem", site_file, site_line, Lock_Profile::now_ns() - begin);
+        return ok;
+#else
         return sem_wait(&m_sem) == 0;
+#endif
     }
 
     // 1.4 增加信号量
@@ -47,6 +78,9 @@ public:
 class Mutex {
 private:
     pthread_mutex_t m_mutex;
+#ifdef LOCK_PROFILE
+    Lock_Hold m_hold;
+#endif
 
 public:
     // 2.1 构造函数
@@ -62,13 +96,23 @@ public:
     }
 
     // 2.3 锁住互斥锁
-    bool lock() {
+    bool lock(LOCK_SITE) {
+#ifdef LOCK_PROFILE
+        long long begin = Lock_Profile::now_ns();
+        bool ok = pthread_mutex_lock(&m_mutex) == 0;
+        m_hold.acquired("mutex", site_file, site_line, begin);
+        return ok;
+#else
         return pthread_mutex_lock(&m_mutex) == 0;
+#endif
     }
 
 
     // 2.4 释放互斥锁 
     bool unlock() {
+#ifdef LOCK_PROFILE
+        m_hold.released("mutex");
+#endif
         return pthread_mutex_unlock(&m_mutex) == 0;
     }
 
@@ -102,9 +146,18 @@ public:
     }
 
     // 3.3 等待条件变量
+#ifdef LOCK_PROFILE
+    bool wait_cond(pthread_mutex_t* mtex, LOCK_SITE) {
+        long long begin = Lock_Profile::now_ns();
+        bool ok = pthread_cond_wait(&m_cond, mtex) == 0;
+        Lock_Profile::record_wait("cond", site_file, site_line, Lock_Profile::now_ns() - begin);
+        return ok;
+    }
+#else
     bool wait_cond(pthread_mutex_t* mtex) {
         return pthread_cond_wait(&m_cond, mtex) == 0;
     }
+#endif
 
     // 3.4 唤醒等待的条件变量
     bool signal_cond() {
@@ -120,4 +173,298 @@ public:
 
 
 
+// 4. 封装futex的class：一个 32 位计数器
+// 4. 等待者先读出 value()，检查完条件后调用 wait(value)，只有计数器仍等于 value 时才会睡眠；
+// 4. 唤醒者修改条件后调用 post()，计数器加一并唤醒，所以不会丢失唤醒
+class Futex {
+private:
+    std::atomic<int> m_word;
+
+public:
+    // 4.1 构造函数
+    Futex() : m_word(0) {}
+
+    // 4.2 读取计数器
+    int value() {
+        return m_word.load();
+    }
+
+    // 4.3 计数器等于 value 时睡眠，被唤醒、计数器已经改变、被信号打断或者超时（timeout_ms >= 0 时）返回
+    void wait(int value, long timeout_ms = -1) {
+        struct timespec timeout = {timeout_ms / 1000, (timeout_ms % 1000) * 1000000};
+        syscall(SYS_futex, (int*)&m_word, FUTEX_WAIT_PRIVATE, value, timeout_ms >= 0 ? &timeout : NULL, NULL, 0);
+    }
+
+    // 4.4 计数器加一，并唤醒最多 n 个等待者
+    void post(int n = 1) {
+        m_word.fetch_add(1);
+        syscall(SYS_futex, (int*)&m_word, FUTEX_WAKE_PRIVATE, n, NULL, NULL, 0);
+    }
+};
+
+// 5. 锁的竞争统计，可选：构造锁时传入 Lock_Stats*，为 NULL 时不统计
+// 5. 只有 acquires 在无竞争的快路径上计数，其他几项只在发生竞争时才更新
+struct Lock_Stats {
+    std::atomic<unsigned long long> acquires;       // 5.1 加锁次数
+    std::atomic<unsigned long long> contended;      // 5.2 加锁时锁已经被占用的次数
+    std::atomic<unsigned long long> spins;          // 5.3 自旋的次数
+    std::atomic<unsigned long long> parks;          // 5.4 睡眠（futex wait / 让出 CPU）的次数
+    std::atomic<unsigned long long> wait_ns;        // 5.5 发生竞争时等待锁的总时间（纳秒）
+
+    Lock_Stats() : acquires(0), contended(0), spins(0), parks(0), wait_ns(0) {}
+
+    static long long now_ns() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    }
+};
+
+
+// 6. 是否值得自旋：只有一个 CPU 时，持有锁的线程不可能在自旋期间释放锁
+inline int lock_spin_limit() {
+    static const int limit = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? 100 : 0;
+    return limit;
+}
+
+
+// 7. 先自旋再睡眠的互斥锁，基于 futex（Drepper, "Futexes Are Tricky" 中的 mutex2）
+// 7. m_word：0 未加锁，1 已加锁且没有等待者，2 已加锁且可能有等待者；解锁时只有为 2 才需要系统调用
+// 7. 适合很短的临界区（计数器、链表操作），不能和 Cond 一起使用
+class Adaptive_Mutex {
+private:
+    std::atomic<int> m_word;
+    Lock_Stats* m_stats;
+#ifdef LOCK_PROFILE
+    Lock_Hold m_hold;
+#endif
+
+public:
+    // 7.1 构造函数
+    Adaptive_Mutex(Lock_Stats* stats = NULL) : m_word(0), m_stats(stats) {}
+
+    // 7.2 加锁
+    bool lock(LOCK_SITE) {
+#ifdef LOCK_PROFILE
+        long long begin = Lock_Profile::now_ns();
+#endif
+        if (m_stats) m_stats->acquires.fetch_add(1, std::memory_order_relaxed);
+
+        int expected = 0;
+        if (!m_word.compare_exchange_strong(expected, 1, std::memory_order_acquire)) lock_slow();
+
+#ifdef LOCK_PROFILE
+        m_hold.acquired("adaptive", site_file, site_line, begin);
+#endif
+        return true;
+    }
+
+    // 7.3 解锁：有等待者时唤醒一个
+    bool unlock() {
+#ifdef LOCK_PROFILE
+        m_hold.released("adaptive");
+#endif
+        if (m_word.exchange(0, std::memory_order_release) == 2) {
+            syscall(SYS_futex, (int*)&m_word, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+        }
+        return true;
+    }
+
+    // 7.4 不等待地尝试加锁
+    bool try_lock() {
+        int expected = 0;
+        return m_word.compare_exchange_strong(expected, 1, std::memory_order_acquire);
+    }
+
+private:
+    void lock_slow() {
+        long long begin = m_stats ? Lock_Stats::now_ns() : 0;
+        int spins = 0, parks = 0;
+
+        // 7.5 先自旋：只读不写，锁被释放后再尝试 CAS
+        for (int i = 0; i < lock_spin_limit(); ++i) {
+            ++spins;
+            cpu_relax();
+            int expected = 0;
+            if (m_word.load(std::memory_order_relaxed) == 0 &&
+                m_word.compare_exchange_strong(expected, 1, std::memory_order_acquire)) {
+                record(begin, spins, parks);
+                return;
+            }
+        }
+
+        // 7.6 再睡眠：把状态改成 2（有等待者），改之前为 0 说明拿到了锁
+        while (m_word.exchange(2, std::memory_order_acquire) != 0) {
+            ++parks;
+            syscall(SYS_futex, (int*)&m_word, FUTEX_WAIT_PRIVATE, 2, NULL, NULL, 0);
+        }
+        record(begin, spins, parks);
+    }
+
+    void record(long long begin, int spins, int parks) {
+        if (!m_stats) return;
+
+        m_stats->contended.fetch_add(1, std::memory_order_relaxed);
+        m_stats->spins.fetch_add(spins, std::memory_order_relaxed);
+        m_stats->parks.fetch_add(parks, std::memory_order_relaxed);
+        m_stats->wait_ns.fetch_add(Lock_Stats::now_ns() - begin, std::memory_order_relaxed);
+    }
+};
+
+
+// 8. 写优先的读写锁：有写者在等待时，新的读者也要等待，写者不会被源源不断的读者饿死
+class RW_Lock {
+private:
+    pthread_rwlock_t m_rwlock;
+    Lock_Stats* m_stats;
+#ifdef LOCK_PROFILE
+    Lock_Hold m_hold;                   // 只记录写锁的持有时间，读锁可能同时有多个持有者
+#endif
+
+public:
+    // 8.1 构造函数
+    RW_Lock(Lock_Stats* stats = NULL) : m_stats(stats) {
+        pthread_rwlockattr_t attr;
+        pthread_rwlockattr_init(&attr);
+        pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+        int ret = pthread_rwlock_init(&m_rwlock, &attr);
+        pthread_rwlockattr_destroy(&attr);
+        if (ret != 0) {
+            throw std::exception();
+        }
+    }
+
+    // 8.2 析构函数
+    ~RW_Lock() {
+        pthread_rwlock_destroy(&m_rwlock);
+    }
+
+    // 8.3 加读锁
+    bool read_lock(LOCK_SITE) {
+#ifdef LOCK_PROFILE
+        long long wait_begin = Lock_Profile::now_ns();
+#endif
+        if (m_stats) m_stats->acquires.fetch_add(1, std::memory_order_relaxed);
+
+        bool ok = true;
+        if (pthread_rwlock_tryrdlock(&m_rwlock) != 0) {
+            long long begin = m_stats ? Lock_Stats::now_ns() : 0;
+            ok = pthread_rwlock_rdlock(&m_rwlock) == 0;
+            record(begin);
+        }
+
+#ifdef LOCK_PROFILE
+        Lock_Profile::record_wait("rwlock_r", site_file, site_line, Lock_Profile::now_ns() - wait_begin);
+#endif
+        return ok;
+    }
+
+    // 8.4 加写锁
+    bool write_lock(LOCK_SITE) {
+#ifdef LOCK_PROFILE
+        long long wait_begin = Lock_Profile::now_ns();
+#endif
+        if (m_stats) m_stats->acquires.fetch_add(1, std::memory_order_relaxed);
+
+        bool ok = true;
+        if (pthread_rwlock_trywrlock(&m_rwlock) != 0) {
+            long long begin = m_stats ? Lock_Stats::now_ns() : 0;
+            ok = pthread_rwlock_wrlock(&m_rwlock) == 0;
+            record(begin);
+        }
+
+#ifdef LOCK_PROFILE
+        m_hold.acquired("rwlock_w", site_file, site_line, wait_begin);
+#endif
+        return ok;
+    }
+
+    // 8.5 释放读锁或写锁
+    bool unlock() {
+#ifdef LOCK_PROFILE
+        m_hold.released("rwlock_w");    // 持有读锁时 m_hold 为空，什么也不做
+#endif
+        return pthread_rwlock_unlock(&m_rwlock) == 0;
+    }
+
+private:
+    void record(long long begin) {
+        if (!m_stats) return;
+
+        m_stats->contended.fetch_add(1, std::memory_order_relaxed);
+        m_stats->parks.fetch_add(1, std::memory_order_relaxed);
+        m_stats->wait_ns.fetch_add(Lock_Stats::now_ns() - begin, std::memory_order_relaxed);
+    }
+};
+
+
+// 9. 排队自旋锁（ticket lock）：按到达顺序获得锁，不会出现某个线程一直抢不到的情况
+// 9. 自旋超过上限后让出 CPU，所以单核上也不会一直空转；临界区较长时不要使用
+class Ticket_Lock {
+private:
+    alignas(64) std::atomic<unsigned int> m_next;       // 9.1 下一个取号的号码
+    alignas(64) std::atomic<unsigned int> m_serving;    // 9.2 正在服务的号码
+    Lock_Stats* m_stats;
+#ifdef LOCK_PROFILE
+    Lock_Hold m_hold;
+#endif
+
+public:
+    // 9.3 构造函数
+    Ticket_Lock(Lock_Stats* stats = NULL) : m_next(0), m_serving(0), m_stats(stats) {}
+
+    // 9.4 加锁：取号，等到叫号
+    bool lock(LOCK_SITE) {
+#ifdef LOCK_PROFILE
+        long long wait_begin = Lock_Profile::now_ns();
+#endif
+        if (m_stats) m_stats->acquires.fetch_add(1, std::memory_order_relaxed);
+
+        unsigned int ticket = m_next.fetch_add(1, std::memory_order_relaxed);
+        if (m_serving.load(std::memory_order_acquire) != ticket) wait_ticket(ticket);
+
+#ifdef LOCK_PROFILE
+        m_hold.acquired("ticket", site_file, site_line, wait_begin);
+#endif
+        return true;
+    }
+
+    // 9.5 解锁：叫下一个号
+    bool unlock() {
+#ifdef LOCK_PROFILE
+        m_hold.released("ticket");
+#endif
+        m_serving.store(m_serving.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    // 9.6 等待叫号：先按排在前面的人数退避自旋，超过上限后让出 CPU
+    void wait_ticket(unsigned int ticket) {
+        long long begin = m_stats ? Lock_Stats::now_ns() : 0;
+        int spins = 0, parks = 0;
+        while (m_serving.load(std::memory_order_acquire) != ticket) {
+            // 前面排队的线程越多，每次检查之间等得越久，减少对 m_serving 所在缓存行的争抢
+            unsigned int ahead = ticket - m_serving.load(std::memory_order_relaxed);
+            if (spins < lock_spin_limit()) {
+                for (unsigned int i = 0; i < ahead; ++i) cpu_relax();
+                ++spins;
+            }
+            else {
+                sched_yield();
+                ++parks;
+            }
+        }
+
+        if (m_stats) {
+            m_stats->contended.fetch_add(1, std::memory_order_relaxed);
+            m_stats->spins.fetch_add(spins, std::memory_order_relaxed);
+            m_stats->parks.fetch_add(parks, std::memory_order_relaxed);
+            m_stats->wait_ns.fetch_add(Lock_Stats::now_ns() - begin, std::memory_order_relaxed);
+        }
+    }
+};
+
+
+
 #endif
\ No newline at end of file
@@ -0,0 +1,200 @@
+// 有界的无锁多生产者多消费者环形队列（Vyukov 算法），ThreadPool 建立在它上面
+// 1. 每个格子有一个序号 seq：seq == pos 表示位置 pos 可以写入，seq == pos + 1 表示位置 pos 可以读出，
+//    生产者和消费者分别用 CAS 推进 m_enqueue_pos / m_dequeue_pos 来占有位置，不需要锁
+// 2. try_push / try_pop 不会阻塞；push_bulk / pop_bulk 一次 CAS 占有多个连续位置
+// 3. push_wait / pop_wait 在队列 满/空 时睡眠在 futex 上；只有确实有线程在睡眠时，对面才会发起唤醒
+
+#ifndef MPMC_RING_H
+#define MPMC_RING_H
+
+#include <atomic>
+#include <exception>
+#include <stddef.h>
+#include "locker.h"
+
+
+template<typename T>
+class Mpmc_Ring {
+private:
+    // 1. 格子
+    struct Cell {
+        std::atomic<size_t> seq;
+        T value;
+    };
+
+    // 2. 成员变量，生产者和消费者修改的变量各占一个 cache line
+    Cell* m_cells;                                      // 2.1 环形数组
+    size_t m_mask;                                      // 2.2 容量 - 1，容量是 2 的整数次幂
+    alignas(64) std::atomic<size_t> m_enqueue_pos;      // 2.3 下一个写入的位置
+    alignas(64) std::atomic<size_t> m_dequeue_pos;      // 2.4 下一个读出的位置
+    alignas(64) std::atomic<int> m_pop_waiters;         // 2.5 等待队列非空的线程数
+    Futex m_not_empty;                                  // 2.6 队列非空的通知
+    alignas(64) std::atomic<int> m_push_waiters;        // 2.7 等待队列非满的线程数
+    Futex m_not_full;                                   // 2.8 队列非满的通知
+
+public:
+    // 3. 构造函数和析构函数，容量向上取整到 2 的整数次幂
+    Mpmc_Ring(int capacity) : m_cells(NULL), m_mask(0), m_enqueue_pos(0), m_dequeue_pos(0),
+                              m_pop_waiters(0), m_push_waiters(0)
+    {
+        if (capacity <= 0) throw std::exception();
+
+        size_t size = 2;
+        while (size < (size_t)capacity) size <<= 1;
+
+        m_cells = new Cell[size];
+        for (size_t i = 0; i < size; ++i) {
+            m_cells[i].seq.store(i, std::memory_order_relaxed);
+        }
+        m_mask = size - 1;
+    }
+
+    ~Mpmc_Ring() {
+        delete[] m_cells;
+    }
+
+    // 4. 不阻塞的 插入/取出，队列 满/空 时返回 false
+    bool try_push(const T& item) {
+        if (push_bulk(&item, 1) == 0) return false;
+        notify(m_pop_waiters, m_not_empty, 1);
+        return true;
+    }
+
+    bool try_pop(T& item) {
+        if (pop_bulk(&item, 1) == 0) return false;
+        notify(m_push_waiters, m_not_full, 1);
+        return true;
+    }
+
+    // 5. 批量 插入/取出，返回实际 插入/取出 的个数（可能少于 n）
+    int try_push_bulk(const T* items, int n) {
+        int count = push_bulk(items, n);
+        if (count > 0) notify(m_pop_waiters, m_not_empty, count);
+        return count;
+    }
+
+    int try_pop_bulk(T* items, int n) {
+        int count = pop_bulk(items, n);
+        if (count > 0) notify(m_push_waiters, m_not_full, count);
+        return count;
+    }
+
+    // 6. 阻塞的 插入/取出：队列 满/空 时睡眠，直到被对面唤醒
+    void push_wait(const T& item) {
+        while (!try_push(item)) {
+            int ticket = m_not_full.value();
+            m_push_waiters.fetch_add(1);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            bool done = try_push(item);
+            if (!done) m_not_full.wait(ticket);
+            m_push_waiters.fetch_sub(1);
+
+            if (done) return;
+        }
+    }
+
+    void pop_wait(T& item) {
+        while (!try_pop(item)) {
+            int ticket = m_not_empty.value();
+            m_pop_waiters.fetch_add(1);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            bool done = try_pop(item);
+            if (!done) m_not_empty.wait(ticket);
+            m_pop_waiters.fetch_sub(1);
+
+            if (done) return;
+        }
+    }
+
+    // 7. 当前元素个数（并发时只是一个估计值）和容量
+    int size() {
+        size_t enqueue_pos = m_enqueue_pos.load(std::memory_order_relaxed);
+        size_t dequeue_pos = m_dequeue_pos.load(std::memory_order_relaxed);
+        return enqueue_pos > dequeue_pos ? (int)(enqueue_pos - dequeue_pos) : 0;
+    }
+
+    int capacity() {
+        return (int)(m_mask + 1);
+    }
+
+private:
+    // 8. 占有从 m_enqueue_pos 开始最多 n 个可写的位置，再逐个写入并发布
+    int push_bulk(const T* items, int n) {
+        size_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+        int count = 0;
+
+        while (true) {
+            count = 0;
+            while (count < n) {
+                Cell* cell = &m_cells[(pos + count) & m_mask];
+                if (cell->seq.load(std::memory_order_acquire) != pos + count) break;
+                ++count;
+            }
+
+            if (count == 0) {
+                // 第一个格子不可写：要么队列满了，要么别的生产者已经占有了它
+                size_t seq = m_cells[pos & m_mask].seq.load(std::memory_order_acquire);
+                if ((long)(seq - pos) < 0) return 0;
+                pos = m_enqueue_pos.load(std::memory_order_relaxed);
+                continue;
+            }
+
+            if (m_enqueue_pos.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed)) break;
+        }
+
+        for (int i = 0; i < count; ++i) {
+            Cell* cell = &m_cells[(pos + i) & m_mask];
+            cell->value = items[i];
+            cell->seq.store(pos + i + 1, std::memory_order_release);
+        }
+
+        return count;
+    }
+
+    // 9. 占有从 m_dequeue_pos 开始最多 n 个可读的位置，再逐个读出并把格子交还给下一圈的生产者
+    int pop_bulk(T* items, int n) {
+        size_t pos = m_dequeue_pos.load(std::memory_order_relaxed);
+        int count = 0;
+
+        while (true) {
+            count = 0;
+            while (count < n) {
+                Cell* cell = &m_cells[(pos + count) & m_mask];
+                if (cell->seq.load(std::memory_order_acquire) != pos + count + 1) break;
+                ++count;
+            }
+
+            if (count == 0) {
+                size_t seq = m_cells[pos & m_mask].seq.load(std::memory_order_acquire);
+                if ((long)(seq - (pos + 1)) < 0) return 0;
+                pos = m_dequeue_pos.load(std::memory_order_relaxed);
+                continue;
+            }
+
+            if (m_dequeue_pos.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed)) break;
+        }
+
+        for (int i = 0; i < count; ++i) {
+            Cell* cell = &m_cells[(pos + i) & m_mask];
+            items[i] = cell->value;
+            cell->value = T();
+            cell->seq.store(pos + i + m_mask + 1, std::memory_order_release);
+        }
+
+        return count;
+    }
+
+    // 10. 与 *_wait() 中睡眠前的 fetch_add 配对：要么这里看到有线程在睡眠，要么那个线程睡眠前能看到这次修改
+    // 10. 最多唤醒 min(n, 睡眠的线程数) 个线程
+    void notify(std::atomic<int>& waiters, Futex& futex, int n) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int sleeping = waiters.load(std::memory_order_relaxed);
+        if (sleeping > 0) futex.post(n < sleeping ? n : sleeping);
+    }
+};
+
+
+
+#endif
@@ -0,0 +1,285 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "access_log.h"
+#include "clock_cache.h"
+
+
+// 拼接时使用的小工具，写不下时截断，返回值仍然推进，调用者据此判断是否被截断
+struct Line_Writer {
+    char* p;
+    char* end;
+
+    void put(char c) {
+        if (p < end) *p = c;
+        ++p;
+    }
+
+    void put(const char* s, size_t n) {
+        if (p + n <= end) memcpy(p, s, n);
+        else if (p < end) memcpy(p, s, end - p);
+        p += n;
+    }
+
+    void put(const char* s) { put(s, strlen(s)); }
+
+    void put_number(long long v) {
+        char digits[24];
+        int n = 0;
+        unsigned long long u = v < 0 ? -(unsigned long long)v : v;
+        do {
+            digits[n++] = '0' + u % 10;
+            u /= 10;
+        } while (u > 0);
+        if (v < 0) put('-');
+        while (n > 0) put(digits[--n]);
+    }
+
+    // IPv4 地址，比 inet_ntop 快
+    void put_ipv4(const struct in_addr& addr) {
+        const unsigned char* b = (const unsigned char*)&addr.s_addr;
+        for (int i = 0; i < 4; ++i) {
+            if (i > 0) put('.');
+            put_number(b[i]);
+        }
+    }
+
+    // 引号中的字段：转义 '"'、'\' 和控制字符，空串写成 "-"；不需要转义的连续字符一次拷贝
+    void put_escaped(const char* s) {
+        static const char hex[] = "0123456789abcdef";
+        if (s == NULL || *s == '\0') {
+            put('-');
+            return;
+        }
+        while (*s) {
+            const char* run = s;
+            while (*s && *s != '"' && *s != '\\' && (unsigned char)*s >= 0x20 && *s != 0x7f) ++s;
+            put(run, s - run);
+            if (*s == '\0') break;
+
+            unsigned char c = *s++;
+            if (c == '"' || c == '\\') {
+                put('\\');
+                put(c);
+            }
+            else {
+                put("\\x", 2);
+                put(hex[c >> 4]);
+                put(hex[c & 15]);
+            }
+        }
+    }
+};
+
+
+// 1. 解析格式
+bool Access_Log::parse_format(const char* format) {
+    string expanded = format;
+    if (strncmp(format, "combined", 8) == 0 && (format[8] == '\0' || format[8] == ' ')) {
+        expanded = string("%h - - %t \"%r\" %>s %b \"%{Referer}i\" \"%{User-Agent}i\"") + (format + 8);
+    }
+    else if (strncmp(format, "common", 6) == 0 && (format[6] == '\0' || format[6] == ' ')) {
+        expanded = string("%h - - %t \"%r\" %>s %b") + (format + 6);
+    }
+
+    static const struct {
+        const char* name;
+        Field_Type type;
+    } directives[] = {
+        {"h", FIELD_CLIENT}, {"t", FIELD_TIME}, {"r", FIELD_REQUEST}, {"m", FIELD_METHOD},
+        {"U", FIELD_URL}, {"H", FIELD_PROTOCOL}, {"s", FIELD_STATUS}, {">s", FIELD_STATUS},
+        {"b", FIELD_BODY_BYTES}, {"O", FIELD_SENT_BYTES}, {"D", FIELD_DURATION}, {"{db}D", FIELD_DB_TIME},
+        {"{Referer}i", FIELD_REFERER}, {"{User-Agent}i", FIELD_USER_AGENT}
+    };
+
+    m_fields.clear();
+    Field literal = {FIELD_LITERAL, ""};
+    for (size_t i = 0; i < expanded.size(); ++i) {
+        if (expanded[i] != '%') {
+            literal.literal += expanded[i];
+            continue;
+        }
+        if (i + 1 < expanded.size() && expanded[i + 1] == '%') {
+            literal.literal += '%';
+            ++i;
+            continue;
+        }
+
+        size_t k = 0;
+        size_t count = sizeof(directives) / sizeof(directives[0]);
+        while (k < count && expanded.compare(i + 1, strlen(directives[k].name), directives[k].name) != 0) ++k;
+        if (k == count) return false;
+
+        if (!literal.literal.empty()) {
+            m_fields.push_back(literal);
+            literal.literal.clear();
+        }
+        Field field = {directives[k].type, ""};
+        m_fields.push_back(field);
+        i += strlen(directives[k].name);
+    }
+    if (!literal.literal.empty()) m_fields.push_back(literal);
+
+    return !m_fields.empty();
+}
+
+
+// 2. 按字段列表拼接一行（含结尾的 '\n'），返回长度；超过 size 时返回值大于 size
+int Access_Log::render(const Access_Record& r, char* buf, int size) {
+    Line_Writer w = {buf, buf + size};
+
+    for (size_t i = 0; i < m_fields.size(); ++i) {
+        switch (m_fields[i].type) {
+        case FIELD_LITERAL:
+            w.put(m_fields[i].literal.data(), m_fields[i].literal.size());
+            break;
+        case FIELD_CLIENT:
+            if (r.addr != NULL) w.put_ipv4(r.addr->sin_addr);
+            else w.put('-');
+            break;
+        case FIELD_TIME:
+            w.put(Clock_Cache::local().clf_time(), Clock_Cache::CLF_TIME_LEN);
+            break;
+        case FIELD_REQUEST:
+            w.put_escaped(r.method);
+            w.put(' ');
+            w.put_escaped(r.url);
+            w.put(' ');
+            w.put_escaped(r.protocol);
+            break;
+        case FIELD_METHOD:
+            w.put_escaped(r.method);
+            break;
+        case FIELD_URL:
+            w.put_escaped(r.url);
+            break;
+        case FIELD_PROTOCOL:
+            w.put_escaped(r.protocol);
+            break;
+        case FIELD_STATUS:
+            w.put_number(r.status);
+            break;
+        case FIELD_BODY_BYTES:
+            if (r.body_bytes > 0) w.put_number(r.body_bytes);
+            else w.put('-');
+            break;
+        case FIELD_SENT_BYTES:
+            w.put_number(r.sent_bytes);
+            break;
+        case FIELD_DURATION:
+            w.put_number(r.duration_us);
+            break;
+        case FIELD_DB_TIME:
+            w.put_number(r.db_us);
+            break;
+        case FIELD_REFERER:
+            w.put_escaped(r.referer);
+            break;
+        case FIELD_USER_AGENT:
+            w.put_escaped(r.user_agent);
+            break;
+        }
+    }
+    w.put('\n');
+
+    return w.p - buf;
+}
+
+
+// 5. 写一行：直接拼接到缓冲区，放不下时切换到另一半再拼一次；另一半还没写出时唤醒刷盘线程并等待
+void Access_Log::write(const Access_Record& record) {
+    if (!m_enabled) return;
+    Log_Buffer* buffer = m_buffers.thread_buffer();
+    if (buffer == NULL) return;
+
+    while (true) {
+        int space = 0;
+        char* p = buffer->begin_write(space);
+        int n = render(record, p, space);
+
+        if (n <= space) {
+            buffer->commit(n);
+            m_lines.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        // 比半个缓冲区还大：丢弃
+        if (space == buffer->size()) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        m_buffers.rotate(buffer);
+    }
+}
+
+
+// 6. 把所有线程的缓冲区写出，按天换文件
+void Access_Log::flush() {
+    if (!m_enabled) return;
+    m_flush_mutex.lock();
+
+    m_buffers.flush(m_file);
+
+    Clock_Cache& clock = Clock_Cache::local();
+    clock.now();
+    if (clock.local_time().tm_mday != m_today) {
+        m_today = clock.local_time().tm_mday;
+        open_file(clock.local_time());
+    }
+
+    m_flush_mutex.unlock();
+}
+
+
+// 7. 打开 now_time 这一天的文件：目录 + 日期 + 文件名
+bool Access_Log::open_file(const struct tm& now_time) {
+    char base[512] = {0};
+    snprintf(base, sizeof(base), "%s%d_%02d_%02d_%s", m_dir_name, now_time.tm_year + 1900,
+             now_time.tm_mon + 1, now_time.tm_mday, m_log_name);
+    return m_file.open(base);
+}
+
+
+// 4. 初始化
+bool Access_Log::init(const char* file_name, const char* format, int thread_buf_size, size_t segment_size,
+                      long long sync_bytes) {
+    if (m_enabled || format == NULL || !parse_format(format)) return false;
+    m_buffers.set_buffer_size(thread_buf_size > 0 ? thread_buf_size : 64 * 1024);
+
+    const char* p = strrchr(file_name, '/');
+    if (p == NULL) {
+        m_dir_name[0] = '\0';
+        snprintf(m_log_name, sizeof(m_log_name), "%s", file_name);
+    }
+    else {
+        snprintf(m_log_name, sizeof(m_log_name), "%s", p + 1);
+        snprintf(m_dir_name, sizeof(m_dir_name), "%.*s", (int)(p - file_name + 1), file_name);
+    }
+
+    time_t t = time(NULL);
+    struct tm now_time;
+    localtime_r(&t, &now_time);
+    m_today = now_time.tm_mday;
+
+    m_file.set_policy(segment_size, sync_bytes);
+    if (!open_file(now_time)) return false;
+
+    // 刷盘线程创建之前设置，刷盘线程读到的一定是 true
+    m_enabled = true;
+    if (!m_buffers.start(flush_func, NULL, m_flush_interval_ms)) {
+        m_enabled = false;
+        return false;
+    }
+    return true;
+}
+
+
+// 析构：停止刷盘线程，把剩下的写出
+Access_Log::~Access_Log() {
+    if (!m_enabled) return;
+
+    m_buffers.stop();
+    flush();
+    m_file.close();
+}
@@ -0,0 +1,123 @@
+// 访问日志：每个写完的应答一行，与调试日志（Log）分开，有自己的缓冲区、刷盘线程和文件
+// 1. 格式与 Apache 的 LogFormat 相同的写法，init 时解析成字段列表，每个请求只按列表拼接，不解析格式：
+//    %h 客户端地址  %t 时间  %r 请求行  %m 方法  %U URL  %H 协议  %s / %>s 状态码
+//    %b 消息体字节数（0 时为 "-"）  %O 发送的总字节数  %D 处理时间（微秒，从读到第一个字节到写完）
+//    %{db}D 访问数据库的时间（微秒）  %{Referer}i  %{User-Agent}i  %% 百分号
+//    "common" / "combined" 开头时展开为 Common / Combined Log Format，后面可以再加字段，例如 "combined %D %{db}D"
+// 2. 写线程拼接到自己的双缓冲区（Log_Buffer，不加锁），刷盘线程（与 Log 的缓冲模式共用 Log_Buffer_Set）批量写进
+//    Log_File（mmap 追加，按大小换段），按天换文件
+// 3. 引号中的字段转义：'"'、'\' 和控制字符写成 \" \\ \xhh
+
+#ifndef ACCESS_LOG_H
+#define ACCESS_LOG_H
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <netinet/in.h>
+#include "log_buffer_set.h"
+#include "log_file.h"
+#include "../lock/locker.h"
+
+using namespace std;
+
+
+// 一个请求的访问记录，字符串由调用者持有，write 返回后不再使用
+struct Access_Record {
+    const struct sockaddr_in* addr;
+    const char* method;
+    const char* url;
+    const char* protocol;
+    int status;
+    long long body_bytes;
+    long long sent_bytes;
+    long long duration_us;
+    long long db_us;
+    const char* referer;
+    const char* user_agent;
+};
+
+
+class Access_Log {
+private:
+    // 1. 字段
+    enum Field_Type {
+        FIELD_LITERAL,
+        FIELD_CLIENT,
+        FIELD_TIME,
+        FIELD_REQUEST,
+        FIELD_METHOD,
+        FIELD_URL,
+        FIELD_PROTOCOL,
+        FIELD_STATUS,
+        FIELD_BODY_BYTES,
+        FIELD_SENT_BYTES,
+        FIELD_DURATION,
+        FIELD_DB_TIME,
+        FIELD_REFERER,
+        FIELD_USER_AGENT
+    };
+
+    struct Field {
+        Field_Type type;
+        string literal;
+    };
+
+    // 2. 成员变量
+    bool m_enabled;                     // 2.1 init 成功后为 true
+    vector<Field> m_fields;             // 2.2 解析后的格式
+    char m_dir_name[128];               // 2.3 目录
+    char m_log_name[128];               // 2.4 文件名
+    int m_today;                        // 2.5 当前文件是哪一天的
+    Log_File m_file;                    // 2.6 当前文件
+    Log_Buffer_Set m_buffers;           // 2.7 所有线程的缓冲区和刷盘线程
+    Mutex m_flush_mutex;                // 2.8 串行化刷盘
+    int m_flush_interval_ms;            // 2.9 刷盘线程的最长睡眠时间
+    std::atomic<unsigned long long> m_lines;    // 2.10 写入的行数
+    std::atomic<unsigned long long> m_dropped;  // 2.11 一行比半个缓冲区还大，被丢弃的行数
+
+
+private:
+    // 3. 单例模式
+    Access_Log() : m_enabled(false), m_today(0), m_flush_interval_ms(200), m_lines(0), m_dropped(0) {
+        m_dir_name[0] = '\0';
+        m_log_name[0] = '\0';
+    }
+    Access_Log(const Access_Log&) {}
+
+    bool parse_format(const char* format);
+    int render(const Access_Record& record, char* buf, int size);
+    bool open_file(const struct tm& now_time);
+
+    static void flush_func(void* args) {
+        get_instance()->flush();
+    }
+
+
+public:
+    ~Access_Log();
+
+    static Access_Log* get_instance() {
+        static Access_Log instance;
+        return &instance;
+    }
+
+    // 4. 初始化：file_name 例如 "./log/access.log"，实际文件为 ./log/2021_09_07_access.log；格式无法解析时返回 false
+    bool init(const char* file_name, const char* format, int thread_buf_size = 64 * 1024,
+              size_t segment_size = 64 * 1024 * 1024, long long sync_bytes = 0);
+
+    bool enabled() { return m_enabled; }
+
+    // 5. 写一行（在写完应答的线程中调用）
+    void write(const Access_Record& record);
+
+    // 6. 把所有线程的缓冲区写出
+    void flush();
+
+    unsigned long long lines() { return m_lines.load(std::memory_order_relaxed); }
+    unsigned long long dropped() { return m_dropped.load(std::memory_order_relaxed); }
+};
+
+
+
+#endif
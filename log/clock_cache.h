@@ -0,0 +1,117 @@
+// 每个线程一个的时间缓存：日志的时间戳、HTTP 应答的 Date 头部和访问日志的时间
+// 1. 同一秒内只调用一次 localtime_r / gmtime_r 并格式化，之后只用 gettimeofday 取微秒，改写时间戳最后 6 位
+//    三种时间都用 gettimeofday 判断是否进入新的一秒（time() 是粗粒度时钟，在秒的边界上和 gettimeofday 不一致）
+// 2. localtime_r 每次都要检查时区（会加全局锁），缓存之后热路径上不再调用
+// 3. 每个线程各有一份，不需要同步
+
+#ifndef CLOCK_CACHE_H
+#define CLOCK_CACHE_H
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+
+
+class Clock_Cache {
+public:
+    static const int LOG_TIME_LEN = 26;         // "2021-09-07 12:34:56.123456"
+    static const int HTTP_DATE_LEN = 29;        // "Tue, 07 Sep 2021 04:34:56 GMT"
+    static const int CLF_TIME_LEN = 28;         // "[07/Sep/2021:12:34:56 +0800]"
+
+private:
+    // 1. 成员变量
+    time_t m_second;                            // 1.1 缓存的是哪一秒
+    struct tm m_local;                          // 1.2 这一秒的本地时间
+    char m_log_time[LOG_TIME_LEN + 1];          // 1.3 日志的时间戳，最后 6 位是微秒
+    char m_http_date[HTTP_DATE_LEN + 1];        // 1.4 RFC 7231 的 IMF-fixdate
+    char m_clf_time[CLF_TIME_LEN + 1];          // 1.5 Common Log Format 的时间，本地时间加时区
+
+
+public:
+    // 2. 当前线程的缓存
+    static Clock_Cache& local() {
+        static thread_local Clock_Cache cache;
+        return cache;
+    }
+
+    // 3. 取当前时间并更新缓存，返回日志的时间戳（在下一次 now() 之前有效）
+    const char* now() {
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        if (tv.tv_sec != m_second) refresh(tv.tv_sec);
+
+        // 只改写微秒
+        long usec = tv.tv_usec;
+        for (int i = LOG_TIME_LEN - 1; i >= LOG_TIME_LEN - 6; --i) {
+            m_log_time[i] = '0' + usec % 10;
+            usec /= 10;
+        }
+        return m_log_time;
+    }
+
+    // 4. 最近一次 now() 的本地时间（日志按天换文件时使用）
+    const struct tm& local_time() { return m_local; }
+
+    // 5. Date 头部的值，按秒缓存
+    const char* http_date() {
+        time_t t = wall_second();
+        if (t != m_second) refresh(t);
+        return m_http_date;
+    }
+
+    // 6. 访问日志的时间，按秒缓存
+    const char* clf_time() {
+        time_t t = wall_second();
+        if (t != m_second) refresh(t);
+        return m_clf_time;
+    }
+
+private:
+    Clock_Cache() : m_second(-1) {
+        memset(&m_local, 0, sizeof(m_local));
+        m_log_time[0] = '\0';
+        m_http_date[0] = '\0';
+        m_clf_time[0] = '\0';
+    }
+
+    // 7. 当前的秒，和 now() 用同一个时钟
+    static time_t wall_second() {
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        return tv.tv_sec;
+    }
+
+    // 8. 进入新的一秒：重新格式化，微秒部分先填 0
+    //    各个字段按无符号数取模，限定位数，格式化的结果正好是 XXX_LEN 个字符
+    void refresh(time_t second) {
+        static const char* days[] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+        static const char* months[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+
+        m_second = second;
+        localtime_r(&second, &m_local);
+        snprintf(m_log_time, sizeof(m_log_time), "%04u-%02u-%02u %02u:%02u:%02u.000000",
+                 year(m_local), two(m_local.tm_mon + 1), two(m_local.tm_mday),
+                 two(m_local.tm_hour), two(m_local.tm_min), two(m_local.tm_sec));
+
+        struct tm gmt;
+        gmtime_r(&second, &gmt);
+        snprintf(m_http_date, sizeof(m_http_date), "%.3s, %02u %.3s %04u %02u:%02u:%02u GMT",
+                 days[gmt.tm_wday], two(gmt.tm_mday), months[gmt.tm_mon], year(gmt),
+                 two(gmt.tm_hour), two(gmt.tm_min), two(gmt.tm_sec));
+
+        long offset = m_local.tm_gmtoff / 60;
+        char sign = offset < 0 ? '-' : '+';
+        if (offset < 0) offset = -offset;
+        snprintf(m_clf_time, sizeof(m_clf_time), "[%02u/%.3s/%04u:%02u:%02u:%02u %c%02u%02u]",
+                 two(m_local.tm_mday), months[m_local.tm_mon], year(m_local),
+                 two(m_local.tm_hour), two(m_local.tm_min), two(m_local.tm_sec), sign, two(offset / 60), two(offset % 60));
+    }
+
+    static unsigned two(long value) { return (unsigned long)value % 100; }
+    static unsigned year(const struct tm& t) { return (unsigned)(t.tm_year + 1900) % 10000; }
+};
+
+
+
+#endif
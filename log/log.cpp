@@ -1,30 +1,290 @@
+#include <unistd.h>
 #include "log.h"
+#include "../metrics/probes.h"
 
 
-// 3. 往日志文件中写入日志
+// 日志队列：一次从队列中取出的条数
+static const int LOG_WRITE_BATCH = 256;
+
+// 二进制模式：两条校准记录之间至少间隔的时间
+static const long long CALIBRATION_INTERVAL_NS = 10 * 1000000000LL;
+
+
+std::atomic<int> Log::m_level(LOG_LEVEL_DEBUG);
+bool Log::m_is_binary = false;
+
+
+// 7.3 解析级别
+int Log::parse_level(const char* name, int default_level) {
+    if (name == NULL || name[0] == '\0') return default_level;
+    if (name[0] >= '0' && name[0] <= '3' && name[1] == '\0') return name[0] - '0';
+    if (strcasecmp(name, "debug") == 0) return LOG_LEVEL_DEBUG;
+    if (strcasecmp(name, "info") == 0) return LOG_LEVEL_INFO;
+    if (strcasecmp(name, "warn") == 0) return LOG_LEVEL_WARN;
+    if (strcasecmp(name, "error") == 0) return LOG_LEVEL_ERROR;
+    return default_level;
+}
+
+
+// 3. 日志队列：写线程，攒够 m_batch_size 条被唤醒，或者每隔 m_flush_interval_ms 把队列取空
 void Log::async_write_log() {
-    string single_log;
+    while (!m_stop.load()) {
+        int seq = m_flush_event.value();
+        if (m_log_queue->size() < m_batch_size) m_flush_event.wait(seq, m_flush_interval_ms);
+        drain_queue();
+    }
+}
+
+void Log::drain_queue() {
+    m_flush_mutex.lock();
+    m_wakeup.store(false);
+
+    // 3.1 按批取出，写进日志文件后马上归还槽位
+    Clock_Cache& clock = Clock_Cache::local();
+    int slots[LOG_WRITE_BATCH];
+    int n = 0;
+    while ((n = m_log_queue->take(slots, LOG_WRITE_BATCH)) > 0) {
+        write_batch(slots, n);
+        m_log_queue->release(slots, n);
+
+        m_line_count += n;
+        clock.now();
+        check_rotate(clock.local_time());
+    }
+
+    // 3.2 队列满时丢弃的条数写进日志
+    unsigned long long dropped = m_log_queue->dropped();
+    if (dropped != m_dropped_reported) {
+        char line[128];
+        int len = snprintf(line, sizeof(line), "%s [warn]: log queue full, %llu records dropped\n",
+                           clock.now(), dropped - m_dropped_reported);
+        m_file.append(line, len);
+        m_dropped_reported = dropped;
+        ++m_line_count;
+    }
+
+    m_flush_mutex.unlock();
+}
+
+// 3.1 依次追加到日志文件（mmap 窗口中的 memcpy）
+void Log::write_batch(const int* slots, int n) {
+    for (int i = 0; i < n; ++i) {
+        m_file.append(m_log_queue->data(slots[i]), m_log_queue->len(slots[i]));
+    }
+}
+
+
+// 3.1 缓冲模式：刷盘线程（Log_Buffer_Set）被唤醒或者超时后把所有线程的缓冲区写出
+void Log::flush_buffers() {
+    m_flush_mutex.lock();
+    unsigned long long appended = m_file.appended();
+
+    m_line_count += m_buffers.flush(m_file);
+
+    // 二进制模式：这一轮写出了记录时才写校准记录，最多每 CALIBRATION_INTERVAL_NS 一条；
+    // 换了段或者文件时马上写一条，单独解码一个段也能换算时间
+    if (m_is_binary && m_file.appended() != appended) {
+        struct timespec mono;
+        clock_gettime(CLOCK_MONOTONIC, &mono);
+        long long mono_ns = mono.tv_sec * 1000000000LL + mono.tv_nsec;
+        if (m_file.segment() != m_calib_segment || mono_ns - m_calib_written_ns >= CALIBRATION_INTERVAL_NS) {
+            write_calibration();
+        }
+    }
+
+    // 按缓冲区换文件，一个文件的行数可能略多于 m_max_line
+    Clock_Cache& clock = Clock_Cache::local();
+    clock.now();
+    check_rotate(clock.local_time());
+
+    m_flush_mutex.unlock();
+}
 
-    while (m_log_queue->pop(single_log)) {
-        m_mutex.lock();
-        fputs(single_log.c_str(), m_fp);
-        fflush(m_fp);
-        m_mutex.unlock();
+
+// 3.2 缓冲模式：直接格式化到当前线程的缓冲区，放不下时切换到另一半；另一半还没写出时唤醒刷盘线程并等待
+void Log::write_buffered(const char* time_str, const char* level, const char* format, va_list va) {
+    Log_Buffer* buffer = m_buffers.thread_buffer();
+    if (buffer == NULL) return;
+
+    while (true) {
+        int space = 0;
+        char* p = buffer->begin_write(space);
+
+        int n = snprintf(p, space, "%s %s ", time_str, level);
+        if (n < space) {
+            va_list args;
+            va_copy(args, va);
+            n += vsnprintf(p + n, space - n, format, args);
+            va_end(args);
+        }
+
+        // 放得下（包括结尾的 '\n'）
+        if (n < space) {
+            p[n] = '\n';
+            buffer->commit(n + 1);
+            return;
+        }
+
+        // 一条日志比半个缓冲区还大：截断
+        if (space == buffer->size()) {
+            p[space - 1] = '\n';
+            buffer->commit(space);
+            return;
+        }
+
+        m_buffers.rotate(buffer);
+    }
+}
+
+
+// 3.2 二进制模式：在当前线程的缓冲区中预留 size 个字节，放不下时切换到另一半（同 write_buffered）
+char* Log::reserve_buffered(int size, Log_Buffer*& buffer) {
+    buffer = m_buffers.thread_buffer();
+    if (buffer == NULL || size > buffer->size()) return NULL;
+    SERVER_PROBE1(log_enqueue_binary, size);
+
+    while (true) {
+        int space = 0;
+        char* p = buffer->begin_write(space);
+        if (size <= space) return p;
+
+        m_buffers.rotate(buffer);
+    }
+}
+
+
+// 3.2 二进制模式：记录比 MAX_RECORD 或者半个缓冲区还大（或者线程拿不到缓冲区）时丢弃，计入 dropped()
+void Log::drop_binary(int level, const char* format) {
+    m_binary_dropped.fetch_add(1, std::memory_order_relaxed);
+    SERVER_PROBE2(log_drop, level, format);
+}
+
+
+// 3.2 二进制模式：校准记录，墙上时间 + 从 init 到现在测出的计数器频率（调用者持有 m_flush_mutex）
+void Log::write_calibration() {
+    uint64_t counter = Log_Binary::counter();
+    struct timespec mono, wall;
+    clock_gettime(CLOCK_MONOTONIC, &mono);
+    clock_gettime(CLOCK_REALTIME, &wall);
+
+    long long mono_ns = mono.tv_sec * 1000000000LL + mono.tv_nsec;
+    int64_t wall_ns = wall.tv_sec * 1000000000LL + wall.tv_nsec;
+    uint64_t hz = 1000000000ULL;
+    if (mono_ns > m_calib_mono_ns && counter > m_calib_counter) {
+        hz = (uint64_t)((double)(counter - m_calib_counter) * 1e9 / (mono_ns - m_calib_mono_ns));
     }
 
-    printf("async_write_log() is error\n");
+    char record[Log_Binary::HEADER_SIZE + 16];
+    char* p = Log_Binary::put_header(record, sizeof(record), Log_Binary::CALIBRATION_ID, counter);
+    memcpy(p, &wall_ns, 8);
+    memcpy(p + 8, &hz, 8);
+    m_file.append(record, sizeof(record));
+
+    m_calib_written_ns = mono_ns;
+    m_calib_segment = m_file.segment();
+}
+
+
+// 7.6 注册格式：追加到格式表，格式中的 '\\'、换行和制表符转义
+uint32_t Log::register_format(int level, const char* format, const char* file, int line) {
+    uint32_t id = Log_Binary::format_id(format, file, line);
+    Log* log = get_instance();
+
+    log->m_format_mutex.lock();
+    if (log->m_format_fp != NULL) {
+        fprintf(log->m_format_fp, "%08x\t%d\t%s:%d\t", id, level, file, line);
+        for (const char* p = format; *p; ++p) {
+            if (*p == '\\') fputs("\\\\", log->m_format_fp);
+            else if (*p == '\n') fputs("\\n", log->m_format_fp);
+            else if (*p == '\t') fputs("\\t", log->m_format_fp);
+            else fputc(*p, log->m_format_fp);
+        }
+        fputc('\n', log->m_format_fp);
+        fflush(log->m_format_fp);
+    }
+    log->m_format_mutex.unlock();
+
+    return id;
+}
+
+
+// 7.1 把已经写进缓冲区的日志写出
+void Log::flush() {
+    if (m_is_buffered) {
+        flush_buffers();
+        return;
+    }
+
+    // 同步写：每一行都已经写进 mmap 窗口（页缓存），不需要再写出
+    if (m_is_async) drain_queue();
+}
+
+
+// 3.3 天数不同时打开新一天的文件；m_line_count >= m_max_line 时换到下一个段（段写满时 Log_File 自己换）
+//     二进制模式不按行数换文件
+void Log::check_rotate(const struct tm& now_time) {
+    if (m_today != now_time.tm_mday) {
+        m_today = now_time.tm_mday;
+        m_line_count = 0;
+        open_file(now_time);
+    }
+    else if (!m_is_binary && m_line_count >= m_max_line) {
+        m_line_count = 0;
+        m_file.rotate();
+    }
+}
+
+// 3.4 打开 now_time 这一天的文件：目录 + 日期 + 文件名
+bool Log::open_file(const struct tm& now_time) {
+    char base[512] = {0};
+    snprintf(base, sizeof(base), "%s%d_%02d_%02d_%s", m_dir_name, now_time.tm_year + 1900,
+             now_time.tm_mon + 1, now_time.tm_mday, m_log_name);
+    m_calib_segment = -1;
+    return m_file.open(base);
+}
+
+
+// 4. 析构函数：缓冲模式和日志队列停止刷盘线程，并把剩下的日志写出
+Log::~Log() {
+    if (m_is_buffered) {
+        m_buffers.stop();
+        flush();
+    }
+    else if (m_is_async) {
+        m_stop.store(true);
+        m_flush_event.post();
+        pthread_join(m_flush_tid, NULL);
+        flush();
+    }
+
+    if (m_buf) delete[] m_buf;
+    if (m_log_queue != NULL) delete m_log_queue;
+    if (m_format_fp != NULL) fclose(m_format_fp);
+    m_file.close();
 }
 
 
 // 6. 初始化
-bool Log::init(const char* file_name, int log_buf_size, int max_lines, int max_queue_size) {
-    // 6.1 如果 max_queue_size >= 1，则为异步写
-    if (max_queue_size >= 1) {
+bool Log::init(const char* file_name, int log_buf_size, int max_lines, int max_queue_size, int thread_buf_size) {
+    // 6.1 二进制模式使用缓冲模式的缓冲区
+    if (m_is_binary && thread_buf_size <= 0) thread_buf_size = 64 * 1024;
+
+    // 6.1 如果 thread_buf_size > 0，则为缓冲模式；否则如果 max_queue_size >= 1，则为日志队列，max_queue_size 个槽位，
+    //     每个槽位 log_buf_size 字节；两种模式的刷盘线程都在打开文件之后创建
+    if (thread_buf_size > 0) {
+        m_is_async = false;
+        m_is_buffered = true;
+        m_thread_buf_size = thread_buf_size;
+        m_buffers.set_buffer_size(thread_buf_size);
+        m_log_queue = NULL;
+    }
+    else if (max_queue_size >= 1) {
         m_is_async = true;
-        m_log_queue = new Block_Queue<string>[max_queue_size];
+        m_log_queue = new Log_Queue(max_queue_size, log_buf_size);
 
-        pthread_t tid;
-        pthread_create(&tid, NULL, flush_log_thread, NULL);
+        // 槽位很少时提前唤醒，不要等到攒满
+        m_batch_size = max_queue_size / 4 < 64 ? max_queue_size / 4 : 64;
+        if (m_batch_size < 1) m_batch_size = 1;
     }
     else {
         m_is_async = false;
@@ -42,124 +302,130 @@ bool Log::init(const char* file_name, int log_buf_size, int max_lines, int max_q
 
     // 6.3 获取系统的当前时间, 并初始化 m_today
     time_t t = time(NULL);
-    struct tm* sys_time = localtime(&t);
-    m_today = sys_time->tm_mday;
+    struct tm sys_time;
+    localtime_r(&t, &sys_time);
+    m_today = sys_time.tm_mday;
 
 
     // 6.4 初始化 m_dir_name, m_log_name
     const char* p = strrchr(file_name, '/');
-    char log_full_name[1024] = {0};
 
     if (p == NULL) {
-        snprintf(log_full_name, 1023, "%d_%02d_%02d_%s", sys_time->tm_year + 1900, 
-        sys_time->tm_mon + 1, sys_time->tm_mday, file_name);
-
-        strcpy(m_log_name, file_name);
+        m_dir_name[0] = '\0';
+        snprintf(m_log_name, sizeof(m_log_name), "%s", file_name);
     }
     else {
-        strcpy(m_log_name, p + 1);
-        strncpy(m_dir_name, file_name, p - file_name + 1);
-        snprintf(log_full_name, 1023, "%s%d_%02d_%02d_%s", m_dir_name, sys_time->tm_year + 1900, 
-        sys_time->tm_mon + 1, sys_time->tm_mday, m_log_name);
+        snprintf(m_log_name, sizeof(m_log_name), "%s", p + 1);
+        snprintf(m_dir_name, sizeof(m_dir_name), "%.*s", (int)(p - file_name + 1), file_name);
     }
 
 
-    // 6.5 初始化 m_fp
-    m_fp = fopen(log_full_name, "a");
+    // 6.5 二进制模式：打开格式表 <目录><文件名>.fmt，日志文件名加上 .bin，重启后从新的段开始写；
+    //     记下计数器的起点，等一会再开始写校准记录
+    if (m_is_binary) {
+        char format_name[300] = {0};
+        snprintf(format_name, sizeof(format_name), "%s%s.fmt", m_dir_name, m_log_name);
+        m_format_fp = fopen(format_name, "a");
+        if (m_format_fp == NULL) return false;
+
+        size_t len = strlen(m_log_name);
+        snprintf(m_log_name + len, sizeof(m_log_name) - len, ".bin");
+        m_file.set_fresh(true);
 
-    if (m_fp == NULL) return false;
+        struct timespec mono;
+        m_calib_counter = Log_Binary::counter();
+        clock_gettime(CLOCK_MONOTONIC, &mono);
+        m_calib_mono_ns = mono.tv_sec * 1000000000LL + mono.tv_nsec;
+        usleep(10000);
+    }
+
+
+    // 6.5 打开日志文件
+    if (!open_file(sys_time)) return false;
+
+
+    // 6.6 缓冲模式 / 日志队列：创建刷盘线程（析构时 join）
+    if (m_is_buffered && !m_buffers.start(flush_buffers_func, NULL, m_flush_interval_ms)) return false;
+    if (m_is_async && pthread_create(&m_flush_tid, NULL, flush_log_thread, NULL) != 0) return false;
     return true;
 }
 
 
 // 7. 写日志
 void Log::write_log(int level, const char* format, ...) {
-    // 7.1 获取当前时间
-    struct timeval tv = {0, 0};
-    gettimeofday(&tv, NULL);
-
-    time_t t = tv.tv_sec;
-    struct tm* now_time = localtime(&t);
+    // 7.1 获取当前时间：每个线程缓存格式化好的秒，同一秒内只改写微秒
+    Clock_Cache& clock = Clock_Cache::local();
+    const char* time_str = clock.now();
+    const struct tm* now_time = &clock.local_time();
 
     // 7.2
-    char s[16] = {0};
+    const char* s = "[info]:";
     switch (level)
     {
     case 0:
-        strcpy(s, "[debug]:");
-        break;
-    case 1:
-        strcpy(s, "[info]:");
+        s = "[debug]:";
         break;
     case 2:
-        strcpy(s, "[warn]:");
+        s = "[warn]:";
         break;
     case 3:
-        strcpy(s, "[error]:");
-        break;
-    default:
-        strcpy(s, "[info]:");
+        s = "[error]:";
         break;
     }
 
-    // 7.3 如果天数不同，或者 m_line_count >= m_max_line则重新打开一个文件
-    m_mutex.lock();
-    ++m_line_count;
+    SERVER_PROBE2(log_enqueue, level, format);
 
-    if (m_today != now_time->tm_mday || m_line_count >= m_max_line) {
-        fflush(m_fp);
-        fclose(m_fp);
+    // 7.3 缓冲模式：不加锁，直接格式化到当前线程的缓冲区
+    va_list va;
+    va_start(va, format);
 
-        char new_log_name[1024] = {0};
-        char tail[16] = {0};
-        snprintf(tail, 16, "%d_%02d_%02d_", now_time->tm_year + 1900, now_time->tm_mon + 1, now_time->tm_mday);
+    if (m_is_buffered) {
+        write_buffered(time_str, s, format, va);
+        va_end(va);
+        return;
+    }
 
-        if (m_today != now_time->tm_mday) {
-            snprintf(new_log_name, 1023, "%s%s", tail, m_log_name);
-            m_today = now_time->tm_mday;
-            m_line_count = 0;
-        }
-        else {
-            snprintf(new_log_name, 1023, "%s%s_%d", tail, m_log_name, m_line_count / m_max_line);
+    // 7.4 日志队列：不加锁，直接格式化到空闲槽位；没有空闲槽位时丢弃（已计数）
+    if (m_is_async) {
+        int slot = 0;
+        char* p = m_log_queue->acquire(slot);
+        if (p != NULL) {
+            int size = m_log_queue->slot_size();
+            int n = snprintf(p, size, "%s %s ", time_str, s);
+            if (n < size) n += vsnprintf(p + n, size - n, format, va);
+
+            // 太长时截断，保留结尾的 '\n'
+            if (n > size - 1) n = size - 1;
+            p[n] = '\n';
+            m_log_queue->publish(slot, n + 1);
+
+            if (m_log_queue->size() >= m_batch_size && !m_wakeup.load(std::memory_order_relaxed) &&
+                !m_wakeup.exchange(true)) {
+                m_flush_event.post();
+            }
         }
-
-        m_fp = fopen(new_log_name, "a");
+        else SERVER_PROBE2(log_drop, level, format);
+        va_end(va);
+        return;
     }
 
-    m_mutex.unlock();
-
-
-    // 7.4 确定日志
-    va_list va;
-    va_start(va, format);
-
-    string log_str;
+    // 7.5 同步写：如果天数不同，或者 m_line_count >= m_max_line则重新打开一个文件，然后格式化并写入
     m_mutex.lock();
+    ++m_line_count;
+    check_rotate(*now_time);
+
+    int n = snprintf(m_buf, m_buf_size - 1, "%s %s ", time_str, s);
+    if (n > m_buf_size - 2) n = m_buf_size - 2;
 
-    int n = snprintf(m_buf, m_buf_size - 1, "%d-%02d-%02d %02d:%02d:%02d.%06ld %s ",
-                     now_time->tm_year + 1900, now_time->tm_mon + 1, now_time->tm_mday,
-                     now_time->tm_hour, now_time->tm_min, now_time->tm_sec, tv.tv_usec, s);
-    
     int m = vsnprintf(m_buf + n, m_buf_size - n - 1, format, va);
+    if (m > m_buf_size - n - 2) m = m_buf_size - n - 2;
 
     m_buf[n + m] = '\n';
     m_buf[n + m + 1] = '\0';
-    log_str = m_buf;
     printf("log_%02d: %s", m_line_count ,m_buf);
+    m_file.append(m_buf, n + m + 1);
 
     va_end(va);
     m_mutex.unlock();
-
-
-    // 7.5  写入日志
-    if (m_is_async && !m_log_queue->full()) {
-        m_log_queue->push(log_str);
-    }
-    else {
-        m_mutex.lock();
-        fputs(log_str.c_str(), m_fp);
-        fflush(m_fp);
-        m_mutex.unlock();
-    }
 }
 
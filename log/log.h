@@ -1,3 +1,17 @@
+// 日志，三种模式：
+// 1. 同步：写日志的线程加锁格式化并写文件，同时输出到标准输出，调试时使用
+// 2. 日志队列：格式化到预先分配的定长槽位（Log_Queue），不分配内存；写线程攒够 m_batch_size 条或者
+//    每隔 m_flush_interval_ms 批量取出写进文件；没有空闲槽位时丢弃并计数，不再退化成同步写
+// 3. 缓冲：每个线程往自己的双缓冲区（Log_Buffer，由 Log_Buffer_Set 管理）里追加格式化好的日志，不加锁；
+//    刷盘线程被唤醒（某个线程写满了半个缓冲区）或者每隔 m_flush_interval_ms 把所有线程的缓冲区写出
+// 二进制：set_binary(true) 之后，LOG_XXX 只把 格式 ID + 时间戳计数器 + 原始参数 写进当前线程的缓冲区（使用缓冲模式的
+//      缓冲区和刷盘线程），不格式化；格式表写在 <日志名>.fmt，用 logdecode 还原成文本（见 log_binary.h）
+// 文件：所有模式都写进 Log_File，预先分配的段，通过 mmap 窗口追加（memcpy），按天、按行数或者段写满时换文件，
+//      fsync 策略由 set_file_policy 设置
+// 级别：LOG_XXX 宏先检查级别再求值参数，低于运行时级别（set_level）的日志只有一次比较；
+//      低于编译期级别 LOG_MIN_LEVEL（make LOG_MIN_LEVEL=2）的日志在编译时被删掉
+// 每个请求都会走到的日志可以用 LOG_EVERY_N（每 n 次写一次）或 LOG_RATE_LIMITED（每秒最多写 n 次）
+
 #ifndef LOG_H
 #define LOG_H
 
@@ -8,45 +22,103 @@
 #include <time.h>
 #include <sys/time.h>
 #include <pthread.h>
-#include "block_queue.h"
+#include <atomic>
+#include <vector>
+#include "log_queue.h"
+#include "log_file.h"
+#include "log_buffer.h"
+#include "log_buffer_set.h"
+#include "log_binary.h"
+#include "clock_cache.h"
+#include "../lock/locker.h"
 
 using namespace std;
 
 
+// 日志级别
+#define LOG_LEVEL_DEBUG 0
+#define LOG_LEVEL_INFO 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_ERROR 3
+
+// 编译期的最低级别，低于它的日志不会编译进程序
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+
 
 class Log {
 private:
     // 1. 成员变量
     char m_dir_name[128];               // 1.1 路径名
     char m_log_name[128];               // 1.2 log文件名
-    FILE* m_fp;                         // 1.3 打开的日志文件的文件描述符
+    Log_File m_file;                    // 1.3 打开的日志文件：预先分配的段，通过 mmap 追加，按大小换段
     char* m_buf;                        // 1.4 日志缓冲区
     int m_buf_size;                     // 1.5 日志缓冲区的大小
     int m_max_line;                     // 1.6 日志的最大行数
     int m_line_count;                   // 1.7 日志行数的记录
     int m_today;                        // 1.8 记录当前是哪一天
-    Block_Queue<string>* m_log_queue;   // 1.9 日志队列
+    Log_Queue* m_log_queue;             // 1.9 日志队列
     bool m_is_async;                    // 1.10 是否同步标志位
-    Mutex m_mutex;                      // 1.11 互斥锁
+    Adaptive_Mutex m_mutex;             // 1.11 互斥锁：临界区很短（行数计数、格式化、fputs），先自旋再睡眠
+    bool m_is_buffered;                 // 1.12 是否为缓冲模式
+    int m_thread_buf_size;              // 1.13 缓冲模式：每个线程的缓冲区每一半的大小
+    Log_Buffer_Set m_buffers;           // 1.14 缓冲模式：所有线程的缓冲区和刷盘线程
+    Mutex m_flush_mutex;                // 1.15 串行化刷盘（刷盘线程，以及析构时最后一次刷盘）
+    Futex m_flush_event;                // 1.16 日志队列：唤醒写线程
+    int m_flush_interval_ms;            // 1.17 刷盘线程（两种模式）的最长睡眠时间
+    std::atomic<bool> m_stop;           // 1.18 日志队列：通知写线程退出
+    pthread_t m_flush_tid;              // 1.19 日志队列：写线程
+    static std::atomic<int> m_level;    // 1.20 运行时的最低级别
+    int m_batch_size;                   // 1.21 日志队列：攒够这么多条就唤醒写线程
+    std::atomic<bool> m_wakeup;         // 1.22 日志队列：已经唤醒过写线程，写线程取完之前不再重复唤醒
+    unsigned long long m_dropped_reported;  // 1.23 日志队列：已经在日志中报告过的丢弃条数，只有写线程访问
+    static bool m_is_binary;            // 1.24 是否为二进制模式，在 init 之前设置
+    FILE* m_format_fp;                  // 1.25 二进制模式：格式表文件
+    Mutex m_format_mutex;               // 1.26 二进制模式：保护格式表文件，只在调用点第一次写日志时使用
+    uint64_t m_calib_counter;           // 1.27 二进制模式：init 时的时间戳计数器和单调时钟，刷盘时据此计算计数器频率
+    long long m_calib_mono_ns;
+    long long m_calib_written_ns;       // 1.28 二进制模式：上一条校准记录的单调时钟和所在的段（-1 表示新打开的文件还没有写过）
+    int m_calib_segment;
+    std::atomic<unsigned long long> m_binary_dropped;   // 1.29 二进制模式：太大、放不进缓冲区而丢弃的记录数
 
 
 private:
     // 2. 单例模式：构造函数为私有
-    Log() : m_fp(NULL), m_buf(NULL), m_buf_size(0), m_max_line(0), 
-    m_line_count(0), m_today(0), m_log_queue(NULL), m_is_async(false) {}
+    Log() : m_buf(NULL), m_buf_size(0), m_max_line(0), 
+    m_line_count(0), m_today(0), m_log_queue(NULL), m_is_async(false), m_is_buffered(false),
+    m_thread_buf_size(0), m_flush_interval_ms(100), m_stop(false), m_batch_size(64), m_wakeup(false),
+    m_dropped_reported(0), m_format_fp(NULL), m_calib_counter(0), m_calib_mono_ns(0),
+    m_calib_written_ns(0), m_calib_segment(-1), m_binary_dropped(0) {}
     Log(const Log&){}
 
-    // 3. 往日志文件中写入日志
+    // 3. 日志队列：写线程的循环 / 取出队列中所有的日志，按批写进文件
     void async_write_log();
+    void drain_queue();
+    void write_batch(const int* slots, int n);
+
+    // 3.1 缓冲模式：把所有线程的缓冲区写出（刷盘线程每一轮调用）
+    void flush_buffers();
+
+    // 3.2 缓冲模式：格式化到当前线程的缓冲区
+    void write_buffered(const char* time_str, const char* level, const char* format, va_list va);
+
+    // 3.2 二进制模式：在当前线程的缓冲区中预留 size 个字节（比半个缓冲区还大时返回 NULL）/ 写一条校准记录
+    char* reserve_buffered(int size, Log_Buffer*& buffer);
+    void write_calibration();
+
+    // 3.2 二进制模式：丢弃一条记录，计数并触发 log_drop 探针
+    void drop_binary(int level, const char* format);
+
+    // 3.3 天数不同，或者行数超过 m_max_line 时打开新的日志文件（调用者持有 m_mutex，或者是刷盘线程）
+    void check_rotate(const struct tm& now_time);
+    bool open_file(const struct tm& now_time);
 
 
 public:
     // 4. 析构函数
-    ~Log() {
-        if (m_buf) delete[] m_buf;
-        if (m_is_async && m_log_queue != NULL) delete[] m_log_queue;
-        if (m_fp != NULL) fclose(m_fp);
-    }
+    ~Log();
 
 
     // 5. 实例化该对象
@@ -57,11 +129,63 @@ public:
 
 
     // 6. 初始化
-    bool init(const char* file_name, int log_buf_size = 8192, int max_lines = 5000000, int max_queue_size = 0);
+    // 6. thread_buf_size > 0 时为缓冲模式（忽略 max_queue_size），否则 max_queue_size >= 1 时为日志队列，都为 0 时同步写
+    bool init(const char* file_name, int log_buf_size = 8192, int max_lines = 5000000, int max_queue_size = 0,
+              int thread_buf_size = 0);
 
 
-    // 7. 写日志
-    void write_log(int level, const char* format, ...);
+    // 7. 写日志：调用者（LOG_XXX 宏）已经检查过级别
+    void write_log(int level, const char* format, ...) __attribute__((format(printf, 3, 4)));
+
+    // 7.2 级别：enabled() 在编译期级别可以确定时会被整个优化掉
+    static bool enabled(int level) {
+        return level >= LOG_MIN_LEVEL && level >= m_level.load(std::memory_order_relaxed);
+    }
+    static void set_level(int level) { m_level.store(level); }
+    static int get_level() { return m_level.load(); }
+
+    // 7.3 "debug"/"info"/"warn"/"error" 或者数字，无法识别时返回 default_level
+    static int parse_level(const char* name, int default_level);
+
+    // 7.6 二进制模式
+    static void set_binary(bool binary) { m_is_binary = binary; }
+    static bool is_binary() { return m_is_binary; }
+
+    // 7.6 调用点第一次写二进制日志时注册格式，返回格式 ID（LOG_WRITE 宏中的静态变量保存）
+    static uint32_t register_format(int level, const char* format, const char* file, int line);
+
+    // 7.6 写二进制日志：只拷贝原始参数；level 和 format 只在记录太大被丢弃时使用
+    template <typename... Args>
+    void write_binary(int level, const char* format, uint32_t id, Args... args) {
+        int size = Log_Binary::HEADER_SIZE + Log_Binary::max_size(args...);
+        if (size > Log_Binary::MAX_RECORD) {
+            drop_binary(level, format);
+            return;
+        }
+
+        Log_Buffer* buffer = NULL;
+        char* p = reserve_buffered(size, buffer);
+        if (p == NULL) {
+            drop_binary(level, format);
+            return;
+        }
+
+        char* end = Log_Binary::put_args(p + Log_Binary::HEADER_SIZE, args...);
+        Log_Binary::put_header(p, end - p, id, Log_Binary::counter());
+        buffer->commit(end - p);
+    }
+
+    // 7.5 日志文件每个段的大小和 fsync 策略（见 log_file.h），在 init 之前调用
+    void set_file_policy(size_t segment_size, long long sync_bytes) { m_file.set_policy(segment_size, sync_bytes); }
+
+
+    // 7.1 把已经写进缓冲区的日志写出：缓冲模式下写出所有线程的缓冲区，日志队列模式下写出队列，同步模式下 fflush
+    void flush();
+
+    // 7.4 被丢弃的日志条数：日志队列满，以及二进制模式下太大的记录
+    unsigned long long dropped() {
+        return (m_log_queue != NULL ? m_log_queue->dropped() : 0) + m_binary_dropped.load(std::memory_order_relaxed);
+    }
 
 
     // 8. 线程回调函数
@@ -69,13 +193,80 @@ public:
         Log::get_instance()->async_write_log();
         return NULL;
     }
+
+    static void flush_buffers_func(void* args) {
+        Log::get_instance()->flush_buffers();
+    }
 };
 
 
-#define LOG_DEBUG(format, ...) Log::get_instance()->write_log(0, format, ##__VA_ARGS__)
-#define LOG_INFO(format, ...) Log::get_instance()->write_log(1, format, ##__VA_ARGS__)
-#define LOG_WARN(format, ...) Log::get_instance()->write_log(2, format, ##__VA_ARGS__)
-#define LOG_ERROR(format, ...) Log::get_instance()->write_log(3, format, ##__VA_ARGS__)
+// 9. 限速：每秒最多放行 m_limit 次，超过的次数在下一秒第一次放行时通过 suppressed 返回
+class Log_Rate_Limiter {
+private:
+    int m_limit;
+    std::atomic<long> m_second;
+    std::atomic<int> m_count;
+    std::atomic<unsigned long> m_suppressed;
+
+public:
+    Log_Rate_Limiter(int limit) : m_limit(limit), m_second(0), m_count(0), m_suppressed(0) {}
+
+    bool allow(unsigned long& suppressed) {
+        suppressed = 0;
+        long now = time(NULL);
+        long second = m_second.load(std::memory_order_relaxed);
+        if (second != now && m_second.compare_exchange_strong(second, now)) {
+            m_count.store(0, std::memory_order_relaxed);
+        }
+
+        if (m_count.fetch_add(1, std::memory_order_relaxed) >= m_limit) {
+            m_suppressed.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        suppressed = m_suppressed.exchange(0, std::memory_order_relaxed);
+        return true;
+    }
+};
+
+
+// 写一条日志（已经检查过级别）：二进制模式下每个调用点注册一次格式，之后只写参数
+#define LOG_WRITE(level, format, ...) \
+    do { \
+        if (Log::is_binary()) { \
+            static const uint32_t log_format_id = Log::register_format(level, format, __FILE__, __LINE__); \
+            Log::get_instance()->write_binary(level, format, log_format_id, ##__VA_ARGS__); \
+        } \
+        else Log::get_instance()->write_log(level, format, ##__VA_ARGS__); \
+    } while (0)
+
+#define LOG_BASE(level, format, ...) \
+    do { \
+        if (Log::enabled(level)) LOG_WRITE(level, format, ##__VA_ARGS__); \
+    } while (0)
+
+#define LOG_DEBUG(format, ...) LOG_BASE(LOG_LEVEL_DEBUG, format, ##__VA_ARGS__)
+#define LOG_INFO(format, ...) LOG_BASE(LOG_LEVEL_INFO, format, ##__VA_ARGS__)
+#define LOG_WARN(format, ...) LOG_BASE(LOG_LEVEL_WARN, format, ##__VA_ARGS__)
+#define LOG_ERROR(format, ...) LOG_BASE(LOG_LEVEL_ERROR, format, ##__VA_ARGS__)
+
+// 10. 采样：这个调用点每 n 次只写一次
+#define LOG_EVERY_N(level, n, format, ...) \
+    do { \
+        static std::atomic<unsigned long> log_every_n_count(0); \
+        if (Log::enabled(level) && log_every_n_count.fetch_add(1, std::memory_order_relaxed) % (n) == 0) \
+            LOG_WRITE(level, format, ##__VA_ARGS__); \
+    } while (0)
+
+// 11. 限速：这个调用点每秒最多写 per_second 次，被丢掉的次数在下一次写的时候补一行
+#define LOG_RATE_LIMITED(level, per_second, format, ...) \
+    do { \
+        static Log_Rate_Limiter log_rate_limiter(per_second); \
+        unsigned long log_suppressed = 0; \
+        if (Log::enabled(level) && log_rate_limiter.allow(log_suppressed)) { \
+            if (log_suppressed > 0) LOG_WRITE(level, "%lu messages suppressed (%s:%d)", log_suppressed, __FILE__, __LINE__); \
+            LOG_WRITE(level, format, ##__VA_ARGS__); \
+        } \
+    } while (0)
 
 
 #endif
\ No newline at end of file
@@ -0,0 +1,159 @@
+// 二进制日志的记录格式，Log 的二进制模式（写）和 logdecode（读）共用
+// 1. 每个调用点第一次写日志时注册格式（Log::register_format）：格式 ID 由 格式字符串 + 文件名 + 行号 哈希得到，
+//    同一个程序每次运行都相同；格式表以文本形式追加到 <日志名>.fmt，logdecode 用它还原文本
+// 2. 热路径只写 记录头 + 原始参数，不做格式化：
+//    记录头 14 字节：长度(u16) + 格式 ID(u32) + 时间戳计数器(u64，x86 上为 TSC)
+//    参数：1 字节类型 + 值，整数为变长编码（有符号数先 zigzag），double 8 字节，字符串为 变长长度 + 内容（不含 '\0'）
+// 3. 格式 ID 为 0 的是校准记录：墙上时间(纳秒, i64) + 计数器频率(Hz, u64)；刷盘线程写出了记录时写一条，
+//    每个段的第一次刷盘一定写，之后最多每 10 秒一条；logdecode 用最近的一条把计数器换算成时间
+// 所有字段都按本机字节序，日志只在同一种机器上解码
+
+#ifndef LOG_BINARY_H
+#define LOG_BINARY_H
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <type_traits>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+
+class Log_Binary {
+public:
+    static const int HEADER_SIZE = 14;
+    static const int MAX_RECORD = 65535;            // 长度是 u16
+    static const int MAX_STRING = 2048;             // 字符串参数最多保留的字节数
+    static const uint32_t CALIBRATION_ID = 0;
+
+    // 参数的类型
+    enum {
+        ARG_INT = 'i',
+        ARG_UINT = 'u',
+        ARG_DOUBLE = 'f',
+        ARG_STRING = 's',
+        ARG_POINTER = 'p'
+    };
+
+    // 1. 时间戳计数器：x86 上是 TSC，其他平台用单调时钟的纳秒
+    static uint64_t counter() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+    }
+
+    // 2. 格式 ID：FNV-1a，0 留给校准记录
+    static uint32_t format_id(const char* format, const char* file, int line) {
+        uint32_t h = 2166136261u;
+        for (const char* p = format; *p; ++p) h = (h ^ (unsigned char)*p) * 16777619u;
+        for (const char* p = file; *p; ++p) h = (h ^ (unsigned char)*p) * 16777619u;
+        h = (h ^ (uint32_t)line) * 16777619u;
+        return h == CALIBRATION_ID ? 1 : h;
+    }
+
+    // 3. 记录头
+    static char* put_header(char* p, int len, uint32_t id, uint64_t tsc) {
+        uint16_t n = len;
+        memcpy(p, &n, 2);
+        memcpy(p + 2, &id, 4);
+        memcpy(p + 6, &tsc, 8);
+        return p + HEADER_SIZE;
+    }
+
+    static void get_header(const char* p, int& len, uint32_t& id, uint64_t& tsc) {
+        uint16_t n = 0;
+        memcpy(&n, p, 2);
+        memcpy(&id, p + 2, 4);
+        memcpy(&tsc, p + 6, 8);
+        len = n;
+    }
+
+    // 4. 参数编码后最多占用的字节数（整数按最长的变长编码计算）
+    static int max_size() { return 0; }
+
+    template <typename T, typename... Rest>
+    static int max_size(T value, Rest... rest) { return arg_max_size(value) + max_size(rest...); }
+
+    // 5. 编码参数，返回结尾
+    static char* put_args(char* p) { return p; }
+
+    template <typename T, typename... Rest>
+    static char* put_args(char* p, T value, Rest... rest) { return put_args(put_arg(p, value), rest...); }
+
+    // 6. 变长整数
+    static char* put_varint(char* p, uint64_t v) {
+        while (v >= 0x80) {
+            *p++ = (char)(v | 0x80);
+            v >>= 7;
+        }
+        *p++ = (char)v;
+        return p;
+    }
+
+    // 读失败（越界）时返回 NULL
+    static const char* get_varint(const char* p, const char* end, uint64_t& v) {
+        v = 0;
+        for (int shift = 0; p < end && shift < 64; shift += 7) {
+            unsigned char c = *p++;
+            v |= (uint64_t)(c & 0x7f) << shift;
+            if (!(c & 0x80)) return p;
+        }
+        return NULL;
+    }
+
+private:
+    template <typename T>
+    static int arg_max_size(T value) {
+        if constexpr (std::is_same<T, const char*>::value || std::is_same<T, char*>::value) {
+            return 1 + 2 + string_len(value);
+        }
+        else {
+            return 1 + 10;
+        }
+    }
+
+    template <typename T>
+    static char* put_arg(char* p, T value) {
+        if constexpr (std::is_same<T, const char*>::value || std::is_same<T, char*>::value) {
+            const char* s = value != NULL ? value : "(null)";
+            int n = string_len(s);
+            *p++ = ARG_STRING;
+            p = put_varint(p, n);
+            memcpy(p, s, n);
+            return p + n;
+        }
+        else if constexpr (std::is_floating_point<T>::value) {
+            double d = value;
+            *p++ = ARG_DOUBLE;
+            memcpy(p, &d, 8);
+            return p + 8;
+        }
+        else if constexpr (std::is_pointer<T>::value) {
+            *p++ = ARG_POINTER;
+            return put_varint(p, (uint64_t)(uintptr_t)value);
+        }
+        else if constexpr (std::is_enum<T>::value || std::is_signed<T>::value) {
+            int64_t v = (int64_t)value;
+            *p++ = ARG_INT;
+            return put_varint(p, ((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+        }
+        else {
+            *p++ = ARG_UINT;
+            return put_varint(p, (uint64_t)value);
+        }
+    }
+
+    static int string_len(const char* s) {
+        if (s == NULL) return 6;
+        return strnlen(s, MAX_STRING);
+    }
+};
+
+
+
+#endif
@@ -0,0 +1,130 @@
+// 每个线程一个的双缓冲日志缓冲区，Log 的缓冲模式使用
+// 1. 写线程（生产者）只往当前的一半（active）里追加格式化好的日志，写完后 release 地发布长度，不加锁
+// 2. 当前一半写满时把它封存（sealed），切换到另一半；另一半还没被刷盘线程写出时，写线程等待
+// 3. 写线程按 0、1、0、1 …… 的顺序使用两半，刷盘线程（消费者）按同样的顺序写出：当前这一半封存了才清空它、
+//    换到另一半，所以同一个线程的日志在文件中的顺序不变；读到的字节都已经发布，写线程不会再修改
+
+#ifndef LOG_BUFFER_H
+#define LOG_BUFFER_H
+
+#include <atomic>
+#include <stdio.h>
+#include <string.h>
+#include "log_file.h"
+
+
+class Log_Buffer {
+private:
+    // 1. 缓冲区的一半
+    struct Half {
+        char* data;
+        std::atomic<int> len;           // 1.1 写线程已经发布的长度
+        std::atomic<bool> sealed;       // 1.2 已经写满，等待刷盘线程写出
+        int flushed;                    // 1.3 刷盘线程已经写出的长度，只有刷盘线程访问
+    };
+
+    // 2. 成员变量
+    Half m_half[2];
+    std::atomic<int> m_active;          // 2.1 写线程正在写的一半
+    int m_size;                         // 2.2 每一半的大小
+    std::atomic<bool> m_exited;         // 2.3 写线程已经退出，刷盘线程写完后释放
+    int m_flush_half;                   // 2.4 刷盘线程正在写出的一半，只有刷盘线程访问
+
+
+public:
+    // 3. 构造函数和析构函数
+    Log_Buffer(int size) : m_active(0), m_size(size), m_exited(false), m_flush_half(0) {
+        for (int i = 0; i < 2; ++i) {
+            m_half[i].data = new char[size];
+            m_half[i].len.store(0);
+            m_half[i].sealed.store(false);
+            m_half[i].flushed = 0;
+        }
+    }
+
+    ~Log_Buffer() {
+        delete[] m_half[0].data;
+        delete[] m_half[1].data;
+    }
+
+    int size() { return m_size; }
+
+    // 4. 写线程：当前一半中可以写的位置和剩余空间
+    char* begin_write(int& space) {
+        Half& half = m_half[m_active.load(std::memory_order_relaxed)];
+        int len = half.len.load(std::memory_order_relaxed);
+        space = m_size - len;
+        return half.data + len;
+    }
+
+    // 5. 写线程：发布写好的 n 个字节
+    void commit(int n) {
+        Half& half = m_half[m_active.load(std::memory_order_relaxed)];
+        half.len.store(half.len.load(std::memory_order_relaxed) + n, std::memory_order_release);
+    }
+
+    // 6. 写线程：封存当前一半并切换到另一半，另一半还没写出时返回 false，调用者唤醒刷盘线程后重试
+    bool rotate() {
+        int active = m_active.load(std::memory_order_relaxed);
+        m_half[active].sealed.store(true, std::memory_order_release);
+
+        Half& other = m_half[1 - active];
+        if (other.sealed.load(std::memory_order_acquire)) return false;
+
+        m_active.store(1 - active, std::memory_order_release);
+        return true;
+    }
+
+    // 7. 写线程退出
+    void set_exited() { m_exited.store(true, std::memory_order_release); }
+    bool exited() { return m_exited.load(std::memory_order_acquire); }
+
+    // 8. 刷盘线程：写出还没写出的日志，返回写出的行数
+    //    不读 m_active：读到的 m_active 可能已经过时，另一半封存时旧的一半的尾部还没写出
+    int flush(Log_File& file) {
+        int lines = 0;
+
+        // 最多换一次：两半都封存时各写出一次，剩下的下一轮再写
+        for (int i = 0; i < 2; ++i) {
+            // 8.1 先读 sealed 再写出：封存之前发布的长度就是这一半最终的长度
+            Half& half = m_half[m_flush_half];
+            bool sealed = half.sealed.load(std::memory_order_acquire);
+            lines += write(half, file);
+            if (!sealed) break;
+
+            // 8.2 封存的一半已经全部写出，清空还给写线程，接着写出另一半（比这一半新）
+            half.len.store(0, std::memory_order_relaxed);
+            half.flushed = 0;
+            half.sealed.store(false, std::memory_order_release);
+            m_flush_half = 1 - m_flush_half;
+        }
+        return lines;
+    }
+
+    // 9. 刷盘线程：是否已经全部写出
+    bool drained() {
+        for (int i = 0; i < 2; ++i) {
+            if (m_half[i].flushed != m_half[i].len.load(std::memory_order_acquire)) return false;
+        }
+        return true;
+    }
+
+private:
+    int write(Half& half, Log_File& file) {
+        int len = half.len.load(std::memory_order_acquire);
+        if (len <= half.flushed) return 0;
+
+        const char* begin = half.data + half.flushed;
+        int n = len - half.flushed;
+        file.append(begin, n);
+        half.flushed = len;
+
+        int lines = 0;
+        for (const char* p = begin; (p = (const char*)memchr(p, '\n', begin + n - p)) != NULL; ++p) ++lines;
+        return lines;
+    }
+};
+
+
+
+#endif
@@ -0,0 +1,158 @@
+// 一组线程的双缓冲区（Log_Buffer）和把它们写出的刷盘线程，Log 的缓冲模式和 Access_Log 共用
+// 1. 每个写线程第一次写时创建自己的缓冲区并注册；线程退出时 thread_local 的持有者设置 exited，
+//    刷盘线程把它写完之后释放
+// 2. 写线程当前一半写满时调用 rotate()：另一半还没写出时唤醒刷盘线程并等待
+// 3. 刷盘线程被唤醒（某个线程写满了半个缓冲区）或者每隔 interval_ms 调用一次 start() 传入的回调，
+//    回调持有调用者自己的锁，再调用 flush() 把所有线程的缓冲区写进 Log_File
+// 一个进程中最多 MAX_SETS 个 Log_Buffer_Set（每个 Log_Buffer_Set 在线程的持有者中占一个位置）
+
+#ifndef LOG_BUFFER_SET_H
+#define LOG_BUFFER_SET_H
+
+#include <atomic>
+#include <vector>
+#include <unistd.h>
+#include <pthread.h>
+#include "log_buffer.h"
+#include "log_file.h"
+#include "../lock/locker.h"
+
+using namespace std;
+
+
+class Log_Buffer_Set {
+public:
+    static const int MAX_SETS = 4;
+    typedef void (*Flush_Func)(void* arg);
+
+private:
+    // 1. 每个线程一个：线程在每个 Log_Buffer_Set 中的缓冲区，线程退出时通知刷盘线程
+    struct Thread_Buffers {
+        Log_Buffer* buffers[MAX_SETS];
+
+        ~Thread_Buffers() {
+            for (int i = 0; i < MAX_SETS; ++i) {
+                if (buffers[i] != NULL) buffers[i]->set_exited();
+            }
+        }
+    };
+
+    static Thread_Buffers& thread_buffers() {
+        static thread_local Thread_Buffers local = {{NULL}};
+        return local;
+    }
+
+    // 2. 成员变量
+    int m_id;                           // 2.1 在 Thread_Buffers 中的位置
+    int m_buf_size;                     // 2.2 每个缓冲区每一半的大小
+    vector<Log_Buffer*> m_buffers;      // 2.3 所有线程的缓冲区
+    Mutex m_buffers_mutex;              // 2.4 保护 m_buffers，只在线程第一次写和释放退出线程的缓冲区时使用
+    Futex m_event;                      // 2.5 唤醒刷盘线程
+    std::atomic<bool> m_stop;           // 2.6 通知刷盘线程退出
+    pthread_t m_tid;                    // 2.7 刷盘线程
+    bool m_started;
+    Flush_Func m_flush;                 // 2.8 刷盘线程每一轮调用的回调
+    void* m_arg;
+    int m_interval_ms;                  // 2.9 刷盘线程的最长睡眠时间
+
+
+public:
+    // 3. 构造函数和析构函数：缓冲区的大小在第一个线程写之前设置
+    Log_Buffer_Set(int buf_size = 64 * 1024) : m_buf_size(buf_size), m_stop(false), m_started(false),
+                                               m_flush(NULL), m_arg(NULL), m_interval_ms(100) {
+        static std::atomic<int> next_id(0);
+        m_id = next_id.fetch_add(1);
+    }
+
+    ~Log_Buffer_Set() { stop(); }
+
+    void set_buffer_size(int buf_size) { m_buf_size = buf_size; }
+
+    // 4. 启动 / 停止刷盘线程（停止后调用者自己再刷一次，把剩下的写出）
+    bool start(Flush_Func flush, void* arg, int interval_ms) {
+        m_flush = flush;
+        m_arg = arg;
+        m_interval_ms = interval_ms;
+        m_started = pthread_create(&m_tid, NULL, flush_thread, this) == 0;
+        return m_started;
+    }
+
+    void stop() {
+        if (!m_started) return;
+        m_stop.store(true);
+        m_event.post();
+        pthread_join(m_tid, NULL);
+        m_started = false;
+    }
+
+    void wake() { m_event.post(); }
+
+    // 5. 写线程：当前线程的缓冲区，第一次写时创建并注册（超过 MAX_SETS 个时返回 NULL）
+    Log_Buffer* thread_buffer() {
+        if (m_id >= MAX_SETS) return NULL;
+
+        Log_Buffer*& buffer = thread_buffers().buffers[m_id];
+        if (buffer == NULL) {
+            buffer = new Log_Buffer(m_buf_size);
+
+            m_buffers_mutex.lock();
+            m_buffers.push_back(buffer);
+            m_buffers_mutex.unlock();
+        }
+        return buffer;
+    }
+
+    // 6. 写线程：封存当前一半并切换到另一半，另一半还没写出时唤醒刷盘线程并等待
+    void rotate(Log_Buffer* buffer) {
+        while (!buffer->rotate()) {
+            m_event.post();
+            usleep(100);
+        }
+        m_event.post();
+    }
+
+    // 7. 刷盘线程：把所有线程的缓冲区写进 file，释放已经退出并且写完的，返回写出的行数；调用者保证同一时刻只有一个线程调用
+    int flush(Log_File& file) {
+        m_buffers_mutex.lock();
+        vector<Log_Buffer*> buffers = m_buffers;
+        m_buffers_mutex.unlock();
+
+        // 先读 exited 再写出：写线程设置 exited 之前写的日志，这一轮一定能写出
+        int lines = 0;
+        for (size_t i = 0; i < buffers.size(); ++i) {
+            bool exited = buffers[i]->exited();
+            lines += buffers[i]->flush(file);
+
+            if (exited && buffers[i]->drained()) {
+                m_buffers_mutex.lock();
+                for (size_t j = 0; j < m_buffers.size(); ++j) {
+                    if (m_buffers[j] == buffers[i]) {
+                        m_buffers.erase(m_buffers.begin() + j);
+                        break;
+                    }
+                }
+                m_buffers_mutex.unlock();
+                delete buffers[i];
+            }
+        }
+        return lines;
+    }
+
+private:
+    Log_Buffer_Set(const Log_Buffer_Set&);
+
+    // 8. 刷盘线程的循环
+    static void* flush_thread(void* arg) {
+        Log_Buffer_Set* set = (Log_Buffer_Set*)arg;
+        while (!set->m_stop.load()) {
+            int seq = set->m_event.value();
+            set->m_flush(set->m_arg);
+            set->m_event.wait(seq, set->m_interval_ms);
+        }
+        return NULL;
+    }
+};
+
+
+
+#endif
@@ -0,0 +1,226 @@
+// 日志文件：预先分配的段（segment），通过滑动的 mmap 窗口追加，写一行只是一次 memcpy
+// 1. 一个段最多 m_segment_size 字节，打开时用 fallocate 预先分配磁盘块（KEEP_SIZE，不改变文件大小）；
+//    写满后关闭，打开下一个段：base、base_1、base_2 ...
+// 2. 每次映射 WINDOW_SIZE 字节的窗口（MAP_POPULATE 预先建立页表），写到窗口末尾时映射下一个窗口；
+//    文件大小随窗口增长，关闭时截断到实际写入的长度
+// 3. fsync 策略 m_sync_bytes：< 0 从不 fsync；0 只在关闭段时 fdatasync；> 0 每写这么多字节 fdatasync 一次
+// 4. 异常退出时文件末尾可能留下一段 0，下次打开同一个段时从最后一个非 0 字节之后继续写；
+//    二进制日志的记录可能以 0 结尾，不能这样找，set_fresh(true) 之后每次打开都从一个空的段开始写
+// 5. mmap 失败时退化成 pwrite
+// 不加锁：调用者保证同一时刻只有一个线程写（同步写持有 m_mutex，其他模式只有刷盘线程写）
+
+#ifndef LOG_FILE_H
+#define LOG_FILE_H
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+class Log_File {
+public:
+    static const size_t WINDOW_SIZE = 4 * 1024 * 1024;     // mmap 窗口的大小
+
+private:
+    // 1. 成员变量
+    char m_base[1024];                  // 1.1 段的文件名（不含序号）
+    int m_index;                        // 1.2 当前段的序号，0 表示 m_base 本身
+    int m_fd;                           // 1.3 当前段的文件描述符
+    size_t m_segment_size;              // 1.4 每个段的大小
+    long long m_sync_bytes;             // 1.5 fsync 策略
+    long long m_unsynced;               // 1.6 上次 fdatasync 之后写入的字节数
+    size_t m_pos;                       // 1.7 下一个字节在文件中的偏移
+    size_t m_file_size;                 // 1.8 文件当前的大小
+    char* m_map;                        // 1.9 当前窗口
+    size_t m_window_off;                // 1.10 当前窗口在文件中的偏移
+    bool m_map_failed;                  // 1.11 mmap 失败，改用 pwrite
+    bool m_fresh;                       // 1.12 打开时跳过所有非空的段
+    unsigned long long m_appended;      // 1.13 追加过的总字节数（所有段）
+
+
+public:
+    // 2. 构造函数和析构函数
+    Log_File() : m_index(0), m_fd(-1), m_segment_size(64 * 1024 * 1024), m_sync_bytes(0), m_unsynced(0),
+                 m_pos(0), m_file_size(0), m_map(NULL), m_window_off(0), m_map_failed(false), m_fresh(false), m_appended(0) {
+        m_base[0] = '\0';
+    }
+
+    ~Log_File() { close(); }
+
+    // 3. 段的大小和 fsync 策略，在 open 之前设置
+    void set_policy(size_t segment_size, long long sync_bytes) {
+        if (segment_size > 0) m_segment_size = segment_size;
+        m_sync_bytes = sync_bytes;
+    }
+
+    // 3.1 打开时不在非空的段后面继续写（二进制日志），在 open 之前设置
+    void set_fresh(bool fresh) { m_fresh = fresh; }
+
+    // 4. 关闭当前段，从 base 的第一个段开始写（已经写满的段跳过）
+    bool open(const char* base) {
+        close();
+        snprintf(m_base, sizeof(m_base), "%s", base);
+        m_index = 0;
+        return open_segment();
+    }
+
+    // 5. 关闭当前段，打开下一个段
+    bool rotate() {
+        close();
+        ++m_index;
+        return open_segment();
+    }
+
+    bool is_open() { return m_fd >= 0; }
+
+    // 当前段的序号 / 追加过的总字节数，调用者用来判断有没有换段、有没有写出东西
+    int segment() { return m_index; }
+    unsigned long long appended() { return m_appended; }
+
+    // 6. 追加 n 个字节：当前段放不下时先换到下一个段（比一个段还大的一条直接写进空段）
+    void append(const char* data, size_t n) {
+        if (m_fd < 0) return;
+        if (m_pos > 0 && m_pos + n > m_segment_size && !rotate()) return;
+
+        m_unsynced += n;
+        m_appended += n;
+        while (n > 0) {
+            // 6.1 写到窗口末尾，映射下一个窗口
+            if (m_map == NULL || m_pos >= m_window_off + WINDOW_SIZE) {
+                if (m_map_failed || !map_window()) {
+                    write_fallback(data, n);
+                    break;
+                }
+            }
+
+            size_t k = m_window_off + WINDOW_SIZE - m_pos;
+            if (k > n) k = n;
+            memcpy(m_map + (m_pos - m_window_off), data, k);
+            m_pos += k;
+            data += k;
+            n -= k;
+        }
+
+        if (m_sync_bytes > 0 && m_unsynced >= m_sync_bytes) sync();
+    }
+
+    // 7. 写回磁盘（写进 mmap 窗口的数据已经在页缓存中，fdatasync 同样会写回）
+    void sync() {
+        if (m_fd < 0) return;
+        fdatasync(m_fd);
+        m_unsynced = 0;
+    }
+
+    // 8. 关闭当前段：解除映射，截掉没有用到的部分，按策略 fdatasync
+    void close() {
+        if (m_fd < 0) return;
+
+        unmap_window();
+        if (m_file_size != m_pos && ftruncate(m_fd, m_pos) == 0) m_file_size = m_pos;
+        if (m_sync_bytes >= 0) fdatasync(m_fd);
+        ::close(m_fd);
+
+        m_fd = -1;
+        m_unsynced = 0;
+    }
+
+private:
+    // 9. 打开第 m_index 个段，已经写满的段跳过；m_fresh 时非空的段都跳过
+    bool open_segment() {
+        while (true) {
+            char name[1100];
+            if (m_index == 0) snprintf(name, sizeof(name), "%s", m_base);
+            else snprintf(name, sizeof(name), "%s_%d", m_base, m_index);
+
+            m_fd = ::open(name, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+            if (m_fd < 0) return false;
+
+            struct stat st;
+            if (fstat(m_fd, &st) != 0) {
+                ::close(m_fd);
+                m_fd = -1;
+                return false;
+            }
+            m_file_size = st.st_size;
+            m_pos = m_fresh ? m_file_size : data_end(m_file_size);
+            m_map = NULL;
+            m_window_off = 0;
+            m_map_failed = false;
+            m_unsynced = 0;
+
+            if (m_pos == 0 || (!m_fresh && m_pos < m_segment_size)) break;
+
+            ::close(m_fd);
+            m_fd = -1;
+            ++m_index;
+        }
+
+        // 预先分配磁盘块，不改变文件大小；文件系统不支持时忽略
+        fallocate(m_fd, FALLOC_FL_KEEP_SIZE, 0, m_segment_size);
+        return true;
+    }
+
+    // 10. 映射包含 m_pos 的窗口，文件不够大时先扩大
+    bool map_window() {
+        unmap_window();
+
+        size_t page = sysconf(_SC_PAGESIZE);
+        size_t off = m_pos & ~(page - 1);
+        if (off + WINDOW_SIZE > m_file_size) {
+            if (ftruncate(m_fd, off + WINDOW_SIZE) != 0) {
+                m_map_failed = true;
+                return false;
+            }
+            m_file_size = off + WINDOW_SIZE;
+        }
+
+        void* p = mmap(NULL, WINDOW_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, off);
+        if (p == MAP_FAILED) {
+            m_map_failed = true;
+            return false;
+        }
+
+        m_map = (char*)p;
+        m_window_off = off;
+        return true;
+    }
+
+    void unmap_window() {
+        if (m_map != NULL) munmap(m_map, WINDOW_SIZE);
+        m_map = NULL;
+    }
+
+    void write_fallback(const char* data, size_t n) {
+        while (n > 0) {
+            ssize_t ret = pwrite(m_fd, data, n, m_pos);
+            if (ret <= 0) return;
+            m_pos += ret;
+            data += ret;
+            n -= ret;
+        }
+        if (m_pos > m_file_size) m_file_size = m_pos;
+    }
+
+    // 11. 文件末尾连续的 0 是上次异常退出时没有截掉的部分，返回最后一个非 0 字节之后的偏移
+    size_t data_end(size_t size) {
+        char buf[64 * 1024];
+        size_t end = size;
+        while (end > 0) {
+            size_t n = end < sizeof(buf) ? end : sizeof(buf);
+            if (pread(m_fd, buf, n, end - n) != (ssize_t)n) return end;
+
+            for (size_t i = n; i > 0; --i) {
+                if (buf[i - 1] != '\0') return end - n + i;
+            }
+            end -= n;
+        }
+        return 0;
+    }
+};
+
+
+
+#endif
@@ -0,0 +1,79 @@
+// 异步日志的队列：预先分配的定长槽位，写日志时不分配内存，也不拷贝字符串
+// 1. 写线程从 m_free 取一个空闲槽位，直接格式化到槽位里，再把槽位号放进 m_ready；没有空闲槽位时丢弃这条日志并计数
+// 2. 写文件的线程从 m_ready 批量取出槽位号，写进日志文件，再把槽位还给 m_free
+// 3. 两个环形队列的容量都不小于槽位数，放回槽位号时不会失败
+
+#ifndef LOG_QUEUE_H
+#define LOG_QUEUE_H
+
+#include <atomic>
+#include <stdlib.h>
+#include "../lock/mpmc_ring.h"
+
+
+class Log_Queue {
+private:
+    // 1. 成员变量
+    int m_slot_num;                                 // 1.1 槽位数
+    int m_slot_size;                                // 1.2 每个槽位的大小，一条日志最长 m_slot_size 字节
+    char* m_slots;                                  // 1.3 所有槽位，连续分配
+    int* m_lens;                                    // 1.4 每个槽位中日志的长度
+    Mpmc_Ring<int> m_free;                          // 1.5 空闲的槽位
+    Mpmc_Ring<int> m_ready;                         // 1.6 写好的槽位，按写好的顺序
+    std::atomic<unsigned long long> m_dropped;      // 1.7 没有空闲槽位，被丢弃的日志条数
+
+
+public:
+    // 2. 构造函数和析构函数
+    Log_Queue(int slot_num, int slot_size)
+        : m_slot_num(slot_num), m_slot_size(slot_size), m_slots(NULL), m_lens(NULL),
+          m_free(slot_num), m_ready(slot_num), m_dropped(0)
+    {
+        if (slot_num <= 0 || slot_size <= 0) exit(-1);
+
+        m_slots = new char[(size_t)slot_num * slot_size];
+        m_lens = new int[slot_num];
+        for (int i = 0; i < slot_num; ++i) {
+            m_lens[i] = 0;
+            m_free.try_push(i);
+        }
+    }
+
+    ~Log_Queue() {
+        delete[] m_slots;
+        delete[] m_lens;
+    }
+
+    // 3. 写线程：取一个空闲槽位，没有时返回 NULL（计入丢弃）
+    char* acquire(int& slot) {
+        if (!m_free.try_pop(slot)) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return NULL;
+        }
+        return m_slots + (size_t)slot * m_slot_size;
+    }
+
+    // 4. 写线程：槽位写好了 len 个字节
+    void publish(int slot, int len) {
+        m_lens[slot] = len;
+        m_ready.try_push(slot);
+    }
+
+    // 5. 写文件的线程：最多取出 n 个写好的槽位
+    int take(int* slots, int n) { return m_ready.try_pop_bulk(slots, n); }
+
+    const char* data(int slot) { return m_slots + (size_t)slot * m_slot_size; }
+    int len(int slot) { return m_lens[slot]; }
+
+    // 6. 写文件的线程：写完后归还槽位
+    void release(const int* slots, int n) { m_free.try_push_bulk(slots, n); }
+
+    // 7. 统计
+    int size() { return m_ready.size(); }
+    int slot_size() { return m_slot_size; }
+    unsigned long long dropped() { return m_dropped.load(std::memory_order_relaxed); }
+};
+
+
+
+#endif
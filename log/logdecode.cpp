@@ -0,0 +1,265 @@
+// 二进制日志解码：按格式表把二进制日志还原成与文本日志相同的格式，输出到标准输出
+// 1. 格式表（<日志名>.fmt）每行：格式 ID(十六进制) \t 级别 \t 文件:行号 \t 格式（转义过）
+// 2. 时间：用最近的一条校准记录把时间戳计数器换算成墙上时间；文件开头还没有遇到校准记录时，使用文件中的第一条
+// 3. 记录按写入文件的顺序输出：同一个线程的日志有序，不同线程之间按刷盘的顺序
+// 用法: ./logdecode 格式表 日志文件...
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "log_binary.h"
+
+using namespace std;
+
+
+// 1. 格式表中的一项
+struct Log_Format {
+    int level;
+    string site;
+    string format;
+};
+
+// 2. 校准记录
+struct Calibration {
+    uint64_t counter;
+    int64_t wall_ns;
+    uint64_t hz;
+};
+
+
+static unordered_map<uint32_t, Log_Format> formats;
+
+
+// 3. 读格式表，同一个 ID 出现多次时（程序多次运行）保留第一个
+static bool load_formats(const char* path) {
+    FILE* fp = fopen(path, "r");
+    if (fp == NULL) return false;
+
+    char line[8192];
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        char* fields[4];
+        int n = 0;
+        char* p = line;
+        fields[n++] = p;
+        while (n < 4 && (p = strchr(p, '\t')) != NULL) {
+            *p++ = '\0';
+            fields[n++] = p;
+        }
+        if (n < 4) continue;
+
+        Log_Format f;
+        f.level = atoi(fields[1]);
+        f.site = fields[2];
+        for (const char* c = fields[3]; *c && *c != '\n'; ++c) {
+            if (*c == '\\' && c[1] != '\0') {
+                ++c;
+                f.format += (*c == 'n') ? '\n' : (*c == 't') ? '\t' : *c;
+            }
+            else f.format += *c;
+        }
+        formats.emplace((uint32_t)strtoul(fields[0], NULL, 16), f);
+    }
+
+    fclose(fp);
+    return true;
+}
+
+
+// 4. 读出下一个参数
+struct Arg {
+    char type;
+    int64_t i;
+    uint64_t u;
+    double d;
+    string s;
+};
+
+static const char* get_arg(const char* p, const char* end, Arg& arg) {
+    if (p >= end) return NULL;
+    arg.type = *p++;
+
+    uint64_t v = 0;
+    switch (arg.type) {
+    case Log_Binary::ARG_INT:
+        if ((p = Log_Binary::get_varint(p, end, v)) == NULL) return NULL;
+        arg.i = (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+        arg.u = arg.i;
+        arg.d = arg.i;
+        return p;
+    case Log_Binary::ARG_UINT:
+    case Log_Binary::ARG_POINTER:
+        if ((p = Log_Binary::get_varint(p, end, v)) == NULL) return NULL;
+        arg.u = v;
+        arg.i = v;
+        arg.d = v;
+        return p;
+    case Log_Binary::ARG_DOUBLE:
+        if (end - p < 8) return NULL;
+        memcpy(&arg.d, p, 8);
+        arg.i = (int64_t)arg.d;
+        arg.u = arg.i;
+        return p + 8;
+    case Log_Binary::ARG_STRING:
+        if ((p = Log_Binary::get_varint(p, end, v)) == NULL || (uint64_t)(end - p) < v) return NULL;
+        arg.s.assign(p, v);
+        return p + v;
+    }
+    return NULL;
+}
+
+
+// 5. 按格式还原一条日志：每个转换说明去掉长度修饰，整数统一按 long long 输出
+static string render(const string& format, const char* p, const char* end) {
+    string out;
+    char buf[4096];
+
+    for (size_t i = 0; i < format.size(); ++i) {
+        if (format[i] != '%') {
+            out += format[i];
+            continue;
+        }
+        if (i + 1 < format.size() && format[i + 1] == '%') {
+            out += '%';
+            ++i;
+            continue;
+        }
+
+        // 5.1 标志、宽度、精度
+        size_t j = i + 1;
+        while (j < format.size() && strchr("-+ #0123456789.", format[j]) != NULL) ++j;
+        string spec = "%" + format.substr(i + 1, j - i - 1);
+
+        // 5.2 长度修饰
+        while (j < format.size() && strchr("hlLqjzt", format[j]) != NULL) ++j;
+        if (j >= format.size()) break;
+        char conv = format[j];
+        i = j;
+
+        Arg arg;
+        if (p == NULL || (p = get_arg(p, end, arg)) == NULL) {
+            out += "<missing>";
+            continue;
+        }
+
+        if (strchr("di", conv) != NULL) snprintf(buf, sizeof(buf), (spec + "ll" + conv).c_str(), (long long)arg.i);
+        else if (strchr("uoxX", conv) != NULL) snprintf(buf, sizeof(buf), (spec + "ll" + conv).c_str(), (unsigned long long)arg.u);
+        else if (strchr("fFeEgGaA", conv) != NULL) snprintf(buf, sizeof(buf), (spec + conv).c_str(), arg.d);
+        else if (conv == 'c') snprintf(buf, sizeof(buf), (spec + conv).c_str(), (int)arg.i);
+        else if (conv == 's') snprintf(buf, sizeof(buf), (spec + conv).c_str(), arg.type == Log_Binary::ARG_STRING ? arg.s.c_str() : "<bad>");
+        else if (conv == 'p') snprintf(buf, sizeof(buf), "%p", (void*)(uintptr_t)arg.u);
+        else snprintf(buf, sizeof(buf), "<%%%c?>", conv);
+        out += buf;
+    }
+
+    return out;
+}
+
+
+// 6. 计数器换算成时间戳字符串，与文本日志相同
+static void format_time(const Calibration& cal, uint64_t counter, char* buf, size_t size) {
+    double delta_ns = ((double)(int64_t)(counter - cal.counter)) * 1e9 / (cal.hz ? cal.hz : 1000000000ULL);
+    int64_t ns = cal.wall_ns + (int64_t)delta_ns;
+    time_t sec = ns / 1000000000LL;
+    struct tm t;
+    localtime_r(&sec, &t);
+    snprintf(buf, size, "%d-%02d-%02d %02d:%02d:%02d.%06lld", t.tm_year + 1900, t.tm_mon + 1, t.tm_mday,
+             t.tm_hour, t.tm_min, t.tm_sec, (long long)(ns % 1000000000LL / 1000));
+}
+
+
+static bool read_calibration(const char* p, Calibration& cal, uint64_t counter) {
+    cal.counter = counter;
+    memcpy(&cal.wall_ns, p, 8);
+    memcpy(&cal.hz, p + 8, 8);
+    return true;
+}
+
+
+// 7. 解码一个文件；遇到不完整的记录（异常退出时的结尾）时停止
+static void decode(const char* path, Calibration& cal, bool& has_cal) {
+    FILE* fp = fopen(path, "rb");
+    if (fp == NULL) {
+        fprintf(stderr, "logdecode: cannot open %s\n", path);
+        return;
+    }
+    vector<char> data;
+    char chunk[1 << 16];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), fp)) > 0) data.insert(data.end(), chunk, chunk + n);
+    fclose(fp);
+
+    const char* begin = data.data();
+    const char* end = begin + data.size();
+
+    // 7.1 还没有校准记录时，先找文件中的第一条
+    for (const char* p = begin; !has_cal && end - p >= Log_Binary::HEADER_SIZE;) {
+        int len = 0;
+        uint32_t id = 0;
+        uint64_t counter = 0;
+        Log_Binary::get_header(p, len, id, counter);
+        if (len < Log_Binary::HEADER_SIZE || len > end - p) break;
+        if (id == Log_Binary::CALIBRATION_ID && len == Log_Binary::HEADER_SIZE + 16) {
+            has_cal = read_calibration(p + Log_Binary::HEADER_SIZE, cal, counter);
+        }
+        p += len;
+    }
+
+    static const char* levels[] = {"[debug]:", "[info]:", "[warn]:", "[error]:"};
+    char time_str[64];
+
+    const char* p = begin;
+    while (end - p >= Log_Binary::HEADER_SIZE) {
+        int len = 0;
+        uint32_t id = 0;
+        uint64_t counter = 0;
+        Log_Binary::get_header(p, len, id, counter);
+        if (len < Log_Binary::HEADER_SIZE || len > end - p) {
+            if (len != 0) fprintf(stderr, "logdecode: %s: bad record at offset %ld\n", path, (long)(p - begin));
+            break;
+        }
+
+        const char* args = p + Log_Binary::HEADER_SIZE;
+        const char* args_end = p + len;
+        p += len;
+
+        if (id == Log_Binary::CALIBRATION_ID) {
+            if (len == Log_Binary::HEADER_SIZE + 16) has_cal = read_calibration(args, cal, counter);
+            continue;
+        }
+
+        if (has_cal) format_time(cal, counter, time_str, sizeof(time_str));
+        else snprintf(time_str, sizeof(time_str), "tsc:%llu", (unsigned long long)counter);
+
+        unordered_map<uint32_t, Log_Format>::iterator it = formats.find(id);
+        if (it == formats.end()) {
+            printf("%s [unknown format %08x]\n", time_str, id);
+            continue;
+        }
+
+        int level = it->second.level;
+        const char* level_str = (level >= 0 && level <= 3) ? levels[level] : "[info]:";
+        printf("%s %s %s\n", time_str, level_str, render(it->second.format, args, args_end).c_str());
+    }
+}
+
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s format_table log_file...\n", argv[0]);
+        return 1;
+    }
+
+    if (!load_formats(argv[1])) {
+        fprintf(stderr, "logdecode: cannot open %s\n", argv[1]);
+        return 1;
+    }
+
+    Calibration cal = {0, 0, 0};
+    bool has_cal = false;
+    for (int i = 2; i < argc; ++i) decode(argv[i], cal, has_cal);
+    return 0;
+}
@@ -7,12 +7,29 @@
 #include <fcntl.h>
 #include <stdlib.h>
 #include <cassert>
+#include <string>
+#include <unordered_map>
 #include <sys/epoll.h>
+#include <sys/mman.h>
+#include <new>
 
+#ifndef NO_MYSQL
 #include "./connectionpool/mysql_connection_pool.h"
+#include "./storage/mysql_user_store.h"
+#endif
+#include "./storage/local_user_store.h"
 #include "./http/http_conn.h"
+#include "./http/admission_control.h"
 #include "./log/log.h"
+#include "./metrics/metrics.h"
+#include "./metrics/request_trace.h"
+#include "./metrics/probes.h"
 #include "./threadpool/thread_pool.h"
+#include "./threadpool/work_stealing_pool.h"
+#include "./threadpool/cpu_affinity.h"
+#ifdef CORO_POOL
+#include "./threadpool/coro_pool.h"
+#endif
 #include "./timer/lst_timer.h"
 
 #define MAX_FD 65536            //最大文件描述符
@@ -21,7 +38,55 @@
 
 
 static const bool is_et = true;                 // 是否设置为et，与 http_conn.cpp 下的 is_et 一起改，如果需要改的话
-static const bool is_sync_write_log = true;     // 是否同步写日志
+static const char* log_level = "info";         // 运行时的日志级别 debug/info/warn/error，环境变量 LOG_LEVEL 优先；每个请求的跟踪日志是 debug
+static const bool is_sync_write_log = false;    // 是否同步写日志（同时输出到标准输出，调试时打开）
+static const int log_thread_buf_size = 64 * 1024;   // 异步写日志时每个线程双缓冲区每一半的大小，0 表示使用日志队列
+static const long long log_segment_size = 64LL * 1024 * 1024;    // 日志文件每个段的大小，写满后换到下一个段
+static const long long log_sync_bytes = 0;      // 日志文件的 fsync 策略：-1 从不，0 只在换段时，> 0 每写这么多字节
+static const bool is_binary_log = false;        // 是否写二进制日志（./log/*.bin + ./log/ServerLog.fmt，用 logdecode 还原），环境变量 LOG_BINARY=1 优先
+static const int log_queue_slots = 4096;        // 日志队列的槽位数（每个槽位 2000 字节，预先分配），满了之后丢弃并计数
+static const char* access_log_format = "combined %D %{db}D";  // 访问日志 ./log/*_access.log 的格式（见 log/access_log.h），"off" 不写；环境变量 ACCESS_LOG_FORMAT 优先
+static const bool is_sticky_conn = true;        // 工作线程是否独占一个数据库连接（会给其他线程至少保留一个连接）
+static const bool is_lazy_load_user = false;    // 是否按需加载用户表（LRU 缓存 + Bloom 过滤器），用户很多时打开
+static const int user_cache_size = 100000;      // 按需加载时 LRU 缓存的容量
+static const char* user_snapshot_file = NULL;   // 用户表快照文件，例如 "./user.snap"，NULL 表示不使用（需要 user 表有自增列 id）
+static const int user_snapshot_interval = 600;  // 定期写快照的间隔（秒）
+static const char* local_store_file = "./user.db";  // 本地存储后端的数据文件
+static const bool is_local_store_sync = false;      // 本地存储后端每次注册后是否 fdatasync
+static const int fast_lane_threads = 2;         // 线程池中只处理快队列（静态文件）的线程数，登录/注册 再多也不会占用它们
+static const bool is_adaptive_pool = true;      // 线程数是否根据排队延迟自动伸缩（只有 ThreadPool 支持）
+static const int pool_min_threads = 4;          // 自动伸缩时线程数的下限
+static const int pool_max_threads = 32;         // 自动伸缩时线程数的上限
+static const int pool_target_delay_us = 2000;   // 排队延迟 p95 的目标（微秒），超过时扩容
+static const int shed_queue_size = 800;         // 线程池排队的任务数超过时，主线程直接回复 503
+static const int shed_delay_us = 200000;        // 排队延迟 p95 超过时（微秒），主线程直接回复 503
+static const int max_connections = 60000;       // 连接数上限，达到时回复 503 并暂停 accept
+static const int listen_backlog = 1024;         // listen() 的 backlog（不超过 /proc/sys/net/core/somaxconn），太小时突发的连接被丢掉 SYN，客户端 1 秒后才重传
+static const int retry_after = 1;               // 503 响应中 Retry-After 的秒数
+static const char* reactor_cpus = "";           // 主线程（reactor）绑定的 CPU，例如 "0"，空表示不绑定；环境变量 REACTOR_CPUS 优先
+static const char* worker_cpus = "";            // 工作线程绑定的 CPU，例如 "1-7"，应与 reactor 在同一个 NUMA 节点；环境变量 WORKER_CPUS 优先
+#ifdef LOCK_PROFILE
+static const char* lock_profile_file = "./lock_profile.txt";  // make LOCK_PROFILE=1 时，收到 SIGUSR2 把锁竞争分析追加到这个文件
+#endif
+static const char* metrics_path = "/metrics";  // 指标（Prometheus 文本格式）的路径，由主线程直接回复，不经过线程池；"off" 关闭统计；环境变量 METRICS_PATH 优先
+static const int slow_request_us = 100000;      // 从读到第一个字节到写完超过这个时间（微秒）的请求连同各阶段的时间记进环形缓冲区，0 表示不跟踪；环境变量 SLOW_REQUEST_US 优先
+static const int slow_request_capacity = 256;   // 慢请求环形缓冲区的容量，满了覆盖最旧的
+static const char* slow_request_path = "/debug/slow_requests";  // 读出慢请求的路径（由主线程直接回复）；收到 SIGUSR1 时追加到 slow_request_file
+static const char* slow_request_file = "./slow_requests.txt";
+static const bool is_first_touch_users = true;  // reactor 绑定 CPU 后，是否由它先写一遍 users 数组，让连接状态分配在 reactor 所在的 NUMA 节点（启动时 RSS 约增加 250MB，不 first-touch 时按需分配）
+
+
+// 线程池：默认为共享队列的 ThreadPool，make POOL=ws 时使用每个工作线程一个队列的 Work_Stealing_Pool，
+// make POOL=coro 时使用协程的 Coro_Pool（fast_lane_threads 个调度线程，8 个阻塞线程）
+#ifdef WORK_STEALING_POOL
+typedef Work_Stealing_Pool<HTTP_Conn> Server_Pool;
+#elif defined(CORO_POOL)
+typedef Coro_Pool<HTTP_Conn> Server_Pool;
+#else
+typedef ThreadPool<HTTP_Conn> Server_Pool;
+#endif
+
+static User_Store* user_store = NULL;
 
 
 static int sig_pipefd[2];
@@ -66,16 +131,102 @@ void cb_func(Client_Data* user_data)
     epoll_ctl(epollfd, EPOLL_CTL_DEL, user_data->sockfd, 0);
     close(user_data->sockfd);
     --HTTP_Conn::m_user_count;
+    SERVER_PROBE1(conn_close, user_data->sockfd);
     LOG_INFO("close fd %d", user_data->sockfd);
 }
 
 
-// 5. show_error()
-void show_error(int connfd, const char* info)
-{
-    printf("%s", info);
-    send(connfd, info, strlen(info), 0);
-    close(connfd);
+// 5. 工作线程启动/退出时的回调：绑定 CPU，让工作线程独占/归还一个数据库连接
+static bool is_pin_workers = false;
+static cpu_set_t worker_cpu_set;
+
+void worker_init() {
+    if (is_pin_workers && !pin_thread(worker_cpu_set)) {
+        LOG_WARN("pin worker thread to worker cpus is error");
+    }
+    user_store->bind_thread();
+}
+
+void worker_exit() {
+    user_store->unbind_thread();
+}
+
+
+// 5. 从环境变量中读取配置，没有设置时使用默认值
+const char* get_env(const char* name, const char* default_value) {
+    const char* value = getenv(name);
+    return (value != NULL && value[0] != '\0') ? value : default_value;
+}
+
+
+// 5. /metrics 的内容：各阶段的耗时和计数器（Metrics），加上连接数、线程池、准入控制、日志的状态
+void render_metrics(std::string& out, const Pool_Stats& pool_stats, const Admission_Stats& admission_stats) {
+    Metrics::get_instance()->render(out);
+
+    Metrics::put_metric(out, "webserver_active_connections", "gauge", "Open client connections.", HTTP_Conn::m_user_count);
+
+    Metrics::put_metric(out, "webserver_pool_threads", "gauge", "Worker threads.", pool_stats.threads);
+    Metrics::put_metric(out, "webserver_pool_queue_depth", "gauge", "Requests waiting in the thread pool.", pool_stats.queue_size);
+    Metrics::put_metric(out, "webserver_pool_queue_delay_p95_seconds", "gauge", "p95 queueing delay over the last pool interval.",
+                        pool_stats.delay_p95_us / 1e6);
+    Metrics::put_metric(out, "webserver_pool_utilization", "gauge", "Busy fraction of the worker threads over the last pool interval.",
+                        pool_stats.utilization);
+    Metrics::put_metric(out, "webserver_pool_tasks_total", "counter", "Tasks run by the thread pool.", pool_stats.tasks);
+    Metrics::put_metric(out, "webserver_pool_grows_total", "counter", "Times the thread pool grew.", pool_stats.grow_count);
+    Metrics::put_metric(out, "webserver_pool_shrinks_total", "counter", "Times the thread pool shrank.", pool_stats.shrink_count);
+
+    Metrics::put_metric(out, "webserver_overloaded", "gauge", "1 while admission control sheds requests.", admission_stats.overloaded);
+    Metrics::put_metric(out, "webserver_accept_paused", "gauge", "1 while accept is paused at the connection limit.",
+                        admission_stats.accept_paused);
+    Metrics::put_metric(out, "webserver_shed_requests_total", "counter", "Requests answered with 503 while overloaded.",
+                        admission_stats.shed_requests);
+    Metrics::put_metric(out, "webserver_shed_queue_full_total", "counter", "Requests answered with 503 because the pool queue was full.",
+                        admission_stats.shed_full);
+    Metrics::put_metric(out, "webserver_rejected_connections_total", "counter", "Connections answered with 503 at the connection limit.",
+                        admission_stats.rejected_conns);
+    Metrics::put_metric(out, "webserver_accept_pauses_total", "counter", "Times accept was paused.", admission_stats.accept_pauses);
+
+    Metrics::put_metric(out, "webserver_log_dropped_total", "counter", "Log records dropped (log queue full or binary record too large).", Log::get_instance()->dropped());
+    Metrics::put_metric(out, "webserver_access_log_lines_total", "counter", "Access log lines written.", Access_Log::get_instance()->lines());
+    Metrics::put_metric(out, "webserver_access_log_dropped_total", "counter", "Access log lines dropped.", Access_Log::get_instance()->dropped());
+    if (Slow_Request_Log::enabled()) {
+        Metrics::put_metric(out, "webserver_slow_requests_total", "counter", "Requests over the slow request threshold.",
+                            Slow_Request_Log::get_instance()->captured());
+    }
+
+#ifndef NO_MYSQL
+    if (strcmp(user_store->name(), "mysql") == 0) {
+        Metrics::put_metric(out, "webserver_db_free_connections", "gauge", "Idle connections in the database pool.",
+                            Connection_Pool::getInstance()->getFreeConn());
+    }
+#endif
+}
+
+
+// 5. 初始化存储后端，backend: "mysql" 或 "local"
+User_Store* init_user_store(const char* backend) {
+    if (strcmp(backend, "local") == 0) {
+        Local_User_Store* local_store = new Local_User_Store();
+        if (!local_store->init(get_env("LOCAL_STORE_FILE", local_store_file), is_local_store_sync)) {
+            delete local_store;
+            return NULL;
+        }
+        return local_store;
+    }
+
+#ifndef NO_MYSQL
+    if (strcmp(backend, "mysql") == 0) {
+        Connection_Pool* conn_pool = Connection_Pool::getInstance();
+        //conn_pool->init("localhost", "root", "pw", "dbname", 3306, 8);
+        conn_pool->init(get_env("MYSQL_HOST", "mysql server ip"), get_env("MYSQL_USER", "登入的用户名"),
+                        get_env("MYSQL_PASSWORD", "密码"), get_env("MYSQL_DATABASE", "数据库名"),
+                        atoi(get_env("MYSQL_PORT", "3306")), 8);
+
+        return new Mysql_User_Store(conn_pool, user_snapshot_file != NULL, is_sticky_conn);
+    }
+#endif
+
+    return NULL;
 }
 
 
@@ -97,7 +248,7 @@ int init_sock(int port) {
     int ret = bind(listenfd, (struct sockaddr*) &addr, sizeof(addr));
     assert(ret != -1);
 
-    ret = listen(listenfd, 5);
+    ret = listen(listenfd, listen_backlog);
     assert(ret != -1);
 
     return listenfd;
@@ -108,36 +259,112 @@ int init_sock(int port) {
 // 7. main
 int main(int argc, char* argv[]) {
     if (argc < 2) {
-        printf("Usage: %s port is error\n", argv[0]);
+        printf("Usage: %s port [mysql|local] is error\n", argv[0]);
         return 1;
     }
 
+#ifndef NO_MYSQL
+    const char* backend = (argc >= 3) ? argv[2] : "mysql";
+#else
+    const char* backend = (argc >= 3) ? argv[2] : "local";
+#endif
+
 
     // 1. 初始化日志文件
-    if (is_sync_write_log) {
+    Log::set_level(Log::parse_level(get_env("LOG_LEVEL", log_level), LOG_LEVEL_INFO));
+    Log::get_instance()->set_file_policy(log_segment_size, log_sync_bytes);
+    Log::set_binary(atoi(get_env("LOG_BINARY", is_binary_log ? "1" : "0")) != 0);
+    if (Log::is_binary()) {
+        Log::get_instance()->init("./log/ServerLog", 2000, 800000, 0, log_thread_buf_size > 0 ? log_thread_buf_size : 64 * 1024);
+        LOG_INFO("binary write log: log_file_name: ./log/2021_9_7_ServerLog.bin, format table: ./log/ServerLog.fmt");
+    }
+    else if (is_sync_write_log) {
         Log::get_instance()->init("./log/ServerLog", 2000, 800000, 0);
         LOG_INFO("sync write log: log_file_name: ./log/2021_9_7_ServerLog");
     }
+    else if (log_thread_buf_size > 0) {
+        Log::get_instance()->init("./log/ServerLog", 2000, 800000, 0, log_thread_buf_size);
+        LOG_INFO("buffered write log: log_file_name: ./log/2021_9_7_ServerLog, thread buffer: %d", log_thread_buf_size);
+    }
     else {
-        Log::get_instance()->init("ServerLog", 2000, 800000, 8);
-        LOG_INFO("async write log: log_file_name: ./log/2021_9_7_ServerLog");
+        Log::get_instance()->init("./log/ServerLog", 2000, 800000, log_queue_slots);
+        LOG_INFO("async write log: log_file_name: ./log/2021_9_7_ServerLog, queue slots: %d", log_queue_slots);
     }
 
+    // 1.1 访问日志：与调试日志分开，有自己的缓冲区、刷盘线程和文件
+    const char* access_format = get_env("ACCESS_LOG_FORMAT", access_log_format);
+    if (strcmp(access_format, "off") != 0) {
+        if (Access_Log::get_instance()->init("./log/access.log", access_format, 64 * 1024, log_segment_size, log_sync_bytes)) {
+            LOG_INFO("access log: ./log/2021_9_7_access.log, format: %s", access_format);
+        }
+        else LOG_ERROR("access log init failure, format: %s", access_format);
+    }
+
+
+    // 1.2 指标：在创建任何工作线程之前打开
+    const char* metrics_location = get_env("METRICS_PATH", metrics_path);
+    if (strcmp(metrics_location, "off") == 0) metrics_location = NULL;
+    Metrics::set_enabled(metrics_location != NULL);
+    if (metrics_location != NULL) LOG_INFO("metrics: GET %s", metrics_location);
 
-    // 2. 初始化连接池
-    Connection_Pool* conn_pool = Connection_Pool::getInstance();
-    //conn_pool->init("localhost", "root", "pw", "dbname", 3306, 8);
-    conn_pool->init("mysql server ip", "登入的用户名", "密码", "数据库名", 3306, 8);
+    // 1.3 慢请求跟踪：同样在创建工作线程之前打开
+    const char* slow_env = get_env("SLOW_REQUEST_US", NULL);
+    long long slow_us = (slow_env != NULL) ? atoll(slow_env) : slow_request_us;
+    if (Slow_Request_Log::get_instance()->init(slow_us, slow_request_capacity)) {
+        LOG_INFO("slow requests: over %lldus, GET %s or SIGUSR1 -> %s", slow_us, slow_request_path, slow_request_file);
+    }
+
+    // 1.4 网站的根目录：环境变量 DOC_ROOT 优先（压测工具在临时目录中启动服务器时用它指向仓库中的 root 目录）
+    doc_root = get_env("DOC_ROOT", doc_root);
+    LOG_INFO("doc root: %s", doc_root);
+
+
+    // 2. 初始化存储后端（MySQL 连接池 或 本地存储）
+    user_store = init_user_store(backend);
+    if (user_store == NULL) {
+        printf("init user store %s is error\n", backend);
+        return 1;
+    }
+    LOG_INFO("user store: %s", user_store->name());
     
 
+    // 3. CPU 亲和性：工作线程在 worker_init() 中绑定，所以要在创建线程池之前解析；
+    //    主线程在创建完线程池之后再绑定，否则之后创建的线程会继承 reactor 的 CPU
+    cpu_set_t reactor_cpu_set;
+    const char* reactor_list = get_env("REACTOR_CPUS", reactor_cpus);
+    const char* worker_list = get_env("WORKER_CPUS", worker_cpus);
+    bool is_pin_reactor = parse_cpu_list(reactor_list, reactor_cpu_set);
+    is_pin_workers = parse_cpu_list(worker_list, worker_cpu_set);
+    if (is_pin_reactor && is_pin_workers && cpu_set_node(reactor_cpu_set) != cpu_set_node(worker_cpu_set)) {
+        LOG_WARN("reactor cpus %s and worker cpus %s are not on the same NUMA node", reactor_list, worker_list);
+    }
+
+
     // 3. 初始化线程池
-    ThreadPool<HTTP_Conn>* thread_pool = new ThreadPool<HTTP_Conn>(conn_pool);
+    Server_Pool* thread_pool = new Server_Pool(8, 1000, worker_init, worker_exit, fast_lane_threads);
+    if (is_adaptive_pool) thread_pool->set_adaptive(pool_min_threads, pool_max_threads, pool_target_delay_us);
+    Admission_Control admission(shed_queue_size, shed_delay_us, max_connections, retry_after);
+    Pool_Stats pool_stats;
 
 
-    // 4. 用户数据, 初始化数据库读取表
-    HTTP_Conn* users = new HTTP_Conn[MAX_FD];
-    assert(users);
-    users->init_mysql_result(conn_pool);
+    // 3.1 主线程（reactor）绑定 CPU：连接由主线程 accept 和 init()，连接状态的 owner 是 reactor
+    if (is_pin_reactor) {
+        if (pin_thread(reactor_cpu_set)) LOG_INFO("pin reactor to cpus %s, NUMA node: %d", reactor_list, cpu_set_node(reactor_cpu_set));
+        else LOG_WARN("pin reactor to cpus %s is error", reactor_list);
+    }
+    if (is_pin_workers) LOG_INFO("pin workers to cpus %s, NUMA node: %d", worker_list, cpu_set_node(worker_cpu_set));
+
+
+    // 4. 用户数据, 初始化用户表
+    //    users 用 mmap 分配：匿名页第一次写时才分配物理页，逐个构造（HTTP_Conn 的构造函数不写成员）也不会写；
+    //    所以只有 first_touch 时启动就占用整个数组，否则物理页分配在第一次使用这个连接的线程所在的节点上
+    size_t users_size = sizeof(HTTP_Conn) * MAX_FD;
+    void* users_mem = mmap(NULL, users_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    assert(users_mem != MAP_FAILED);
+    HTTP_Conn* users = (HTTP_Conn*)users_mem;
+    for (int i = 0; i < MAX_FD; ++i) new (users + i) HTTP_Conn();
+    if (is_pin_reactor && is_first_touch_users) first_touch(users, users_size);
+    User_Table::get_instance()->init(user_store, is_lazy_load_user, user_cache_size, user_snapshot_file, user_snapshot_interval);
 
 
     // 5. 监听套接字
@@ -147,6 +374,8 @@ int main(int argc, char* argv[]) {
 
     // 6. epollfd, I/O复用
     struct epoll_event events[MAX_EVENT_NUMBER];
+    HTTP_Conn* ready[MAX_EVENT_NUMBER];     // 一次 epoll_wait 中读完请求的连接，循环结束后一起交给线程池
+    std::unordered_map<int, std::string> local_replies;     // 主线程直接回复（/metrics、慢请求）的消息体，按 fd 保存
     epollfd = epoll_create(5);
     assert(epollfd != -1);
     LOG_INFO("epoll is ok, epollfd: %d", epollfd);
@@ -162,6 +391,10 @@ int main(int argc, char* argv[]) {
 
     addsig(SIGALRM, sig_handler, false);
     addsig(SIGTERM, sig_handler, false);
+    if (Slow_Request_Log::enabled()) addsig(SIGUSR1, sig_handler, false);
+#ifdef LOCK_PROFILE
+    addsig(SIGUSR2, sig_handler, false);
+#endif
     LOG_INFO("signals is ok, sig_pipefd[0]: %d", sig_pipefd[0]);
 
 
@@ -182,28 +415,34 @@ int main(int argc, char* argv[]) {
             break;
         }
 
-        LOG_INFO("");
-        LOG_INFO("epoll_wait() return, num: %d", num);
+        LOG_DEBUG("epoll_wait() return, num: %d", num);
+        int ready_num = 0;
+
+        thread_pool->get_stats(pool_stats);
+        admission.update(pool_stats.queue_size, pool_stats.delay_p95_us);
+
         for (int i = 0; i < num; ++i) {
             int sockfd = events[i].data.fd;
 
             // 9.1 读事件
             if (events[i].events & EPOLLIN) {
                 if (sockfd == listenfd) {
-                    LOG_INFO("EPOLLIN && sockfd == listenfd, sockfd: %d", sockfd);
+                    LOG_DEBUG("EPOLLIN && sockfd == listenfd, sockfd: %d", sockfd);
 
                     struct sockaddr_in client_addr;
                     socklen_t client_addr_len = sizeof(client_addr);
 
                     if (!is_et) {
+                        long long accept_begin = Metrics::enabled() ? metrics_now_ns() : 0;
                         int connfd = accept(sockfd, (struct sockaddr*) &client_addr, &client_addr_len);
                         if (connfd < 0) {
-                            LOG_ERROR("accept() is error");
+                            LOG_RATE_LIMITED(LOG_LEVEL_ERROR, 10, "accept() is error, errno: %d", errno);
                             continue;
                         }
 
-                        if (HTTP_Conn::m_user_count > MAX_FD || connfd >= MAX_FD) {
-                            show_error(connfd, "Internal server busy");
+                        if (connfd >= MAX_FD || admission.conn_full(HTTP_Conn::m_user_count)) {
+                            admission.reject(connfd);
+                            if (admission.pause_accept()) epoll_ctl(epollfd, EPOLL_CTL_DEL, listenfd, 0);
                             continue;
                         }
 
@@ -223,14 +462,23 @@ int main(int argc, char* argv[]) {
                         users_timer[connfd].timer = timer;
 
                         list_timer.add_timer(timer);
+                        SERVER_PROBE2(conn_accept, connfd, HTTP_Conn::m_user_count);
+
+                        if (accept_begin > 0) {
+                            Metrics::record(STAGE_ACCEPT, metrics_now_ns() - accept_begin);
+                            Metrics::count(COUNTER_CONNECTIONS);
+                        }
                     }
                     else {
                         while (1) {
+                            long long accept_begin = Metrics::enabled() ? metrics_now_ns() : 0;
                             int connfd = accept(sockfd, (struct sockaddr*) &client_addr, &client_addr_len);
                             if (connfd < 0) break;
 
-                            if (HTTP_Conn::m_user_count > MAX_FD || connfd >= MAX_FD) {
-                                show_error(connfd, "Internal server busy");
+                            // 连接数达到上限：回复 503 并暂停 accept，剩下的连接留在 backlog 中，恢复 accept 时再处理
+                            if (connfd >= MAX_FD || admission.conn_full(HTTP_Conn::m_user_count)) {
+                                admission.reject(connfd);
+                                if (admission.pause_accept()) epoll_ctl(epollfd, EPOLL_CTL_DEL, listenfd, 0);
                                 break;
                             }
 
@@ -250,11 +498,18 @@ int main(int argc, char* argv[]) {
                             users_timer[connfd].timer = timer;
 
                             list_timer.add_timer(timer);
+                            SERVER_PROBE2(conn_accept, connfd, HTTP_Conn::m_user_count);
+
+                            // accept 阶段：accept() + 初始化连接和定时器
+                            if (accept_begin > 0) {
+                                Metrics::record(STAGE_ACCEPT, metrics_now_ns() - accept_begin);
+                                Metrics::count(COUNTER_CONNECTIONS);
+                            }
                         }
                     }
                 }
                 else if (sockfd == sig_pipefd[0]) {
-                    LOG_INFO("EPOLLIN && sockfd == sig_pipefd[0], sockfd: %d", sockfd);
+                    LOG_DEBUG("EPOLLIN && sockfd == sig_pipefd[0], sockfd: %d", sockfd);
 
                     char signals[1024];
                     int sig_count = recv(sockfd, signals, sizeof(signals), 0);
@@ -270,18 +525,78 @@ int main(int argc, char* argv[]) {
                                 case SIGTERM:
                                     stop_server = true;
                                     break;
+                                case SIGUSR1:
+                                {
+                                    std::string slow_requests;
+                                    Slow_Request_Log::get_instance()->dump(slow_requests);
+                                    FILE* fp = fopen(slow_request_file, "a");
+                                    if (fp != NULL) {
+                                        fwrite(slow_requests.data(), 1, slow_requests.size(), fp);
+                                        fclose(fp);
+                                    }
+                                    LOG_INFO("dump slow requests to %s", slow_request_file);
+                                    break;
+                                }
+#ifdef LOCK_PROFILE
+                                case SIGUSR2:
+                                {
+                                    FILE* fp = fopen(lock_profile_file, "a");
+                                    if (fp != NULL) {
+                                        Lock_Profile::dump(fp);
+                                        fclose(fp);
+                                    }
+                                    LOG_INFO("dump lock profile to %s", lock_profile_file);
+                                    break;
+                                }
+#endif
                             }
                         }
                     }
                 }
                 else {
-                    LOG_INFO("EPOLLIN && sockfd == else, sockfd: %d", sockfd);
+                    LOG_DEBUG("EPOLLIN && sockfd == else, sockfd: %d", sockfd);
 
                     Util_Timer* timer = users_timer[sockfd].timer;
                     // 可以看到，主线程，负责 读与写，当读取完毕后，将该任务添加进线程池的任务队列中，然后唤醒子进程
                     // 然后则由子线程处理，读取的内容 以及 该写入什么内容给客户端
                     if (users[sockfd].read()) {
-                        thread_pool->append(users + sockfd);
+                        // /metrics 和慢请求：主线程直接回复，不进入线程池，过载时也能访问
+                        std::string body;
+                        const char* content_type = NULL;
+                        if (metrics_location != NULL && users[sockfd].match_path(metrics_location)) {
+                            render_metrics(body, pool_stats, admission.get_stats());
+                            content_type = "text/plain; version=0.0.4; charset=utf-8";
+                        }
+                        else if (Slow_Request_Log::enabled() && users[sockfd].match_path(slow_request_path)) {
+                            Slow_Request_Log::get_instance()->dump(body);
+                            content_type = "text/plain; charset=utf-8";
+                        }
+
+                        if (content_type != NULL) {
+                            // 应答可能分几次写完，body 放在按 fd 保存的表中（节点不会移动），直到这个 fd 的下一次直接回复
+                            std::string& saved = local_replies[sockfd];
+                            saved.swap(body);
+                            if (users[sockfd].reply(content_type, saved.data(), saved.size())) {
+                                time_t cur = time(NULL);
+                                timer->expire_time = cur + 3 * TIMESLOT;
+                                list_timer.adjust_timer(timer);
+                            }
+                            else {
+                                timer->cb_func(&users_timer[sockfd]);
+                                list_timer.del_timer(timer);
+                            }
+                            continue;
+                        }
+
+                        // 过载：不经过线程池，直接回复 503 并关闭连接
+                        if (admission.overloaded()) {
+                            admission.shed(sockfd);
+                            timer->cb_func(&users_timer[sockfd]);
+                            list_timer.del_timer(timer);
+                            continue;
+                        }
+
+                        ready[ready_num++] = users + sockfd;
 
                         if (timer) {
                             time_t cur = time(NULL);
@@ -300,7 +615,7 @@ int main(int argc, char* argv[]) {
             }
             // 9.2 写事件
             else if (events[i].events & EPOLLOUT) {
-                LOG_INFO("EPOLLOUT");
+                LOG_DEBUG("EPOLLOUT");
 
                 Util_Timer* timer = users_timer[sockfd].timer;
                 if (users[sockfd].write()) {
@@ -318,7 +633,7 @@ int main(int argc, char* argv[]) {
             }
             // 9.3 一些错误事件
             else if (events[i].events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
-                LOG_INFO("EPOLLRDHUP | EPOLLHUP | EPOLLERR");
+                LOG_DEBUG("EPOLLRDHUP | EPOLLHUP | EPOLLERR");
 
                 Util_Timer* timer = users_timer[sockfd].timer;
                 timer->cb_func(&users_timer[sockfd]);
@@ -327,10 +642,33 @@ int main(int argc, char* argv[]) {
             }
             // 9.4 未知事件
             else {
-                LOG_INFO("else something happened");
+                LOG_DEBUG("else something happened");
+            }
+        }
+
+        // 9.5 整批交给线程池：一次入队操作，最多唤醒 ready_num 个睡眠的工作线程
+        if (ready_num > 0) {
+            if (Slow_Request_Log::enabled()) {
+                for (int j = 0; j < ready_num; ++j) ready[j]->trace(TRACE_APPEND);
+            }
+            int appended = thread_pool->append_batch(ready, ready_num);
+
+            // 线程池的队列满了：剩下的请求回复 503 并关闭连接
+            for (int j = appended; j < ready_num; ++j) {
+                int sockfd = ready[j]->m_sockfd;
+                Util_Timer* timer = users_timer[sockfd].timer;
+
+                admission.shed(sockfd, true);
+                timer->cb_func(&users_timer[sockfd]);
+                list_timer.del_timer(timer);
             }
         }
 
+        // 9.6 暂停 accept 之后，连接数降下来了就恢复
+        if (admission.resume_accept(HTTP_Conn::m_user_count)) {
+            addfd(epollfd, listenfd, false);
+        }
+
         if (timeout) {
             timer_handler();
             timeout = false;
@@ -339,11 +677,25 @@ int main(int argc, char* argv[]) {
 
 
 
+    const Admission_Stats& admission_stats = admission.get_stats();
+    LOG_INFO("admission control: shed requests: %llu, shed on full queue: %llu, rejected connections: %llu, accept pauses: %llu",
+             admission_stats.shed_requests, admission_stats.shed_full, admission_stats.rejected_conns, admission_stats.accept_pauses);
+
+    if (Access_Log::get_instance()->enabled()) {
+        LOG_INFO("access log: lines: %llu, dropped: %llu", Access_Log::get_instance()->lines(), Access_Log::get_instance()->dropped());
+    }
+
+    const Lock_Stats& user_lock_stats = User_Table::get_instance()->lock_stats();
+    LOG_INFO("user table lock: acquires: %llu, contended: %llu, parks: %llu, wait: %lluus",
+             user_lock_stats.acquires.load(), user_lock_stats.contended.load(), user_lock_stats.parks.load(),
+             user_lock_stats.wait_ns.load() / 1000);
+
     close(epollfd);
     close(listenfd);
     close(sig_pipefd[1]);
     close(sig_pipefd[0]);
-    delete[] users;
+    for (int i = 0; i < MAX_FD; ++i) users[i].~HTTP_Conn();
+    munmap(users_mem, users_size);
     delete[] users_timer;
     delete thread_pool;
 
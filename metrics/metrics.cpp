@@ -0,0 +1,160 @@
+#include <stdio.h>
+#include "metrics.h"
+
+
+bool Metrics::m_enabled = false;
+thread_local Metrics_Shard* Metrics::t_shard = NULL;
+
+
+// 线程退出时把分片交给 Metrics 合并
+struct Metrics_Shard_Holder {
+    Metrics_Shard* shard;
+
+    ~Metrics_Shard_Holder() {
+        if (shard != NULL) Metrics::get_instance()->retire(shard);
+    }
+};
+
+
+// 1. 第 percent 百分位数
+uint64_t Histogram_Snapshot::percentile(double percent) const {
+    if (count == 0) return 0;
+
+    uint64_t rank = (uint64_t)(count * percent / 100.0);
+    uint64_t seen = 0;
+    for (int i = 0; i < Latency_Histogram::BUCKETS; ++i) {
+        seen += buckets[i];
+        if (seen > rank) return Latency_Histogram::upper(i);
+    }
+    return Latency_Histogram::upper(Latency_Histogram::BUCKETS - 1);
+}
+
+// 1. 上界不超过 ns 的桶中的样本数；ns 落在一个桶中间时，这个桶不算，最多少算 1/16 的区间
+uint64_t Histogram_Snapshot::count_le(uint64_t ns) const {
+    uint64_t n = 0;
+    for (int i = 0; i < Latency_Histogram::BUCKETS && Latency_Histogram::upper(i) <= ns + 1; ++i) n += buckets[i];
+    return n;
+}
+
+
+// 2. 当前线程第一次记录时创建分片并注册
+Metrics_Shard* Metrics::create_shard() {
+    static thread_local Metrics_Shard_Holder holder = {NULL};
+
+    Metrics* metrics = get_instance();
+    Metrics_Shard* shard = new Metrics_Shard();
+
+    metrics->m_mutex.lock();
+    metrics->m_shards.push_back(shard);
+    metrics->m_mutex.unlock();
+
+    holder.shard = shard;
+    t_shard = shard;
+    return shard;
+}
+
+
+// 3. 线程退出：合并到 m_retired
+void Metrics::retire(Metrics_Shard* shard) {
+    m_mutex.lock();
+
+    for (size_t i = 0; i < m_shards.size(); ++i) {
+        if (m_shards[i] == shard) {
+            m_shards.erase(m_shards.begin() + i);
+            break;
+        }
+    }
+
+    for (int s = 0; s < STAGE_NUM; ++s) {
+        for (int i = 0; i < Latency_Histogram::BUCKETS; ++i) {
+            add(m_retired.stages[s].m_buckets[i], shard->stages[s].m_buckets[i].load(std::memory_order_relaxed));
+        }
+        add(m_retired.stages[s].m_sum_ns, shard->stages[s].m_sum_ns.load(std::memory_order_relaxed));
+    }
+    for (int i = 0; i < COUNTER_NUM; ++i) add(m_retired.counters[i], shard->counters[i].load(std::memory_order_relaxed));
+    for (int i = 0; i < METRICS_STATUS_NUM; ++i) add(m_retired.status[i], shard->status[i].load(std::memory_order_relaxed));
+
+    m_mutex.unlock();
+
+    if (shard == t_shard) t_shard = NULL;
+    delete shard;
+}
+
+
+// 4. 追加一个单值的指标
+void Metrics::put_metric(string& out, const char* name, const char* type, const char* help, double value) {
+    char buf[512];
+    snprintf(buf, sizeof(buf), "# HELP %s %s\n# TYPE %s %s\n%s %.9g\n", name, help, name, type, name, value);
+    out += buf;
+}
+
+
+// 5. 合并所有分片并输出
+void Metrics::render(string& out) {
+    static const char* stage_names[STAGE_NUM] = {"accept", "read", "queue", "parse", "handle", "write", "total"};
+    static const uint64_t bounds_ns[] = {
+        10000, 25000, 50000, 100000, 250000, 500000,
+        1000000, 2500000, 5000000, 10000000, 25000000, 50000000, 100000000, 250000000, 500000000,
+        1000000000, 2500000000ULL, 5000000000ULL, 10000000000ULL
+    };
+    static const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+
+    // 5.1 合并：每个分片只有一个线程写，读到的是某个时刻附近的值，各个桶之间不保证一致
+    vector<Histogram_Snapshot> stages(STAGE_NUM);
+    uint64_t counters[COUNTER_NUM] = {0};
+    uint64_t status[METRICS_STATUS_NUM] = {0};
+
+    m_mutex.lock();
+    for (size_t k = 0; k <= m_shards.size(); ++k) {
+        Metrics_Shard* shard = (k < m_shards.size()) ? m_shards[k] : &m_retired;
+        for (int s = 0; s < STAGE_NUM; ++s) stages[s].merge(shard->stages[s]);
+        for (int i = 0; i < COUNTER_NUM; ++i) counters[i] += shard->counters[i].load(std::memory_order_relaxed);
+        for (int i = 0; i < METRICS_STATUS_NUM; ++i) status[i] += shard->status[i].load(std::memory_order_relaxed);
+    }
+    m_mutex.unlock();
+
+    char buf[256];
+
+    // 5.2 直方图
+    out += "# HELP webserver_stage_duration_seconds Time spent in each stage of a request.\n";
+    out += "# TYPE webserver_stage_duration_seconds histogram\n";
+    for (int s = 0; s < STAGE_NUM; ++s) {
+        for (size_t b = 0; b < sizeof(bounds_ns) / sizeof(bounds_ns[0]); ++b) {
+            snprintf(buf, sizeof(buf), "webserver_stage_duration_seconds_bucket{stage=\"%s\",le=\"%g\"} %llu\n",
+                     stage_names[s], bounds_ns[b] / 1e9, (unsigned long long)stages[s].count_le(bounds_ns[b]));
+            out += buf;
+        }
+        snprintf(buf, sizeof(buf), "webserver_stage_duration_seconds_bucket{stage=\"%s\",le=\"+Inf\"} %llu\n"
+                 "webserver_stage_duration_seconds_sum{stage=\"%s\"} %.9g\n"
+                 "webserver_stage_duration_seconds_count{stage=\"%s\"} %llu\n",
+                 stage_names[s], (unsigned long long)stages[s].count, stage_names[s], stages[s].sum_ns / 1e9,
+                 stage_names[s], (unsigned long long)stages[s].count);
+        out += buf;
+    }
+
+    // 5.3 分位数：直方图的桶比上面的边界细得多，p99/p999 直接从细桶中取
+    out += "# HELP webserver_stage_duration_quantile_seconds Quantiles of the stage durations since start.\n";
+    out += "# TYPE webserver_stage_duration_quantile_seconds gauge\n";
+    for (int s = 0; s < STAGE_NUM; ++s) {
+        for (size_t q = 0; q < sizeof(quantiles) / sizeof(quantiles[0]); ++q) {
+            snprintf(buf, sizeof(buf), "webserver_stage_duration_quantile_seconds{stage=\"%s\",quantile=\"%g\"} %.9g\n",
+                     stage_names[s], quantiles[q], stages[s].percentile(quantiles[q] * 100) / 1e9);
+            out += buf;
+        }
+    }
+
+    // 5.4 计数器
+    out += "# HELP webserver_requests_total Responses written, by status code.\n";
+    out += "# TYPE webserver_requests_total counter\n";
+    for (int i = 0; i < METRICS_STATUS_NUM; ++i) {
+        if (METRICS_STATUS[i] != 0) snprintf(buf, sizeof(buf), "webserver_requests_total{code=\"%d\"} %llu\n",
+                                             METRICS_STATUS[i], (unsigned long long)status[i]);
+        else snprintf(buf, sizeof(buf), "webserver_requests_total{code=\"other\"} %llu\n", (unsigned long long)status[i]);
+        out += buf;
+    }
+
+    put_metric(out, "webserver_connections_accepted_total", "counter", "Connections accepted.", counters[COUNTER_CONNECTIONS]);
+    put_metric(out, "webserver_received_bytes_total", "counter", "Bytes read from clients.", counters[COUNTER_BYTES_READ]);
+    put_metric(out, "webserver_sent_bytes_total", "counter", "Bytes written to clients.", counters[COUNTER_BYTES_SENT]);
+    put_metric(out, "webserver_db_checkouts_total", "counter", "Connections taken from the database pool.", counters[COUNTER_DB_CHECKOUTS]);
+}
@@ -0,0 +1,196 @@
+// 服务器指标：请求每个阶段的耗时直方图和计数器，以 Prometheus 文本格式输出
+// 1. 阶段：accept / read（主线程读一次）/ queue（在线程池中排队，慢请求两次排队之和）/ parse（process_read）/
+//    handle（do_request，静态文件的 stat/mmap 或者数据库）/ write（主线程写，多次写之和）/ total（读到第一个字节到写完）
+// 2. 每个线程一个分片（Metrics_Shard），只有这个线程写，写入是普通的 load + store，没有原子加；
+//    读的时候（/metrics）把所有分片加起来，线程退出时它的分片合并到 m_retired
+// 3. 直方图与 HdrHistogram 相同的划分：每个 2 的整数次幂区间分成 16 个桶，相对误差不超过 1/16，范围 1ns ~ 68s
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "../lock/locker.h"
+
+using namespace std;
+
+
+// 1. 阶段
+enum Metrics_Stage {
+    STAGE_ACCEPT = 0,
+    STAGE_READ,
+    STAGE_QUEUE,
+    STAGE_PARSE,
+    STAGE_HANDLE,
+    STAGE_WRITE,
+    STAGE_TOTAL,
+    STAGE_NUM
+};
+
+// 2. 计数器
+enum Metrics_Counter {
+    COUNTER_CONNECTIONS = 0,        // 2.1 accept 的连接数
+    COUNTER_BYTES_READ,             // 2.2 读到的字节数
+    COUNTER_BYTES_SENT,             // 2.3 发送的字节数
+    COUNTER_DB_CHECKOUTS,           // 2.4 从数据库连接池取连接的次数
+    COUNTER_NUM
+};
+
+// 3. 按状态码统计的请求数，其他状态码计入最后一个
+static const int METRICS_STATUS[] = {200, 400, 403, 404, 500, 503, 0};
+static const int METRICS_STATUS_NUM = sizeof(METRICS_STATUS) / sizeof(METRICS_STATUS[0]);
+
+
+// 4. 单调时钟，纳秒
+inline long long metrics_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+
+// 5. 耗时直方图（纳秒），只有一个线程写
+class Latency_Histogram {
+public:
+    static const int SUB_BITS = 4;
+    static const int SUB_COUNT = 1 << SUB_BITS;
+    static const int MAX_MSB = 35;
+    static const int BUCKETS = SUB_COUNT + (MAX_MSB - SUB_BITS + 1) * SUB_COUNT;
+
+    std::atomic<uint64_t> m_buckets[BUCKETS];
+    std::atomic<uint64_t> m_sum_ns;
+
+    static int index(uint64_t ns) {
+        if (ns < (uint64_t)SUB_COUNT) return (int)ns;
+
+        int msb = 63 - __builtin_clzll(ns);
+        if (msb > MAX_MSB) return BUCKETS - 1;
+        return (msb - SUB_BITS + 1) * SUB_COUNT + (int)((ns >> (msb - SUB_BITS)) & (SUB_COUNT - 1));
+    }
+
+    // 桶 idx 的上界（不含）
+    static uint64_t upper(int idx) {
+        if (idx < SUB_COUNT) return idx + 1;
+
+        int msb = idx / SUB_COUNT + SUB_BITS - 1;
+        uint64_t sub = idx % SUB_COUNT + 1;
+        return (1ULL << msb) + (sub << (msb - SUB_BITS));
+    }
+
+    Latency_Histogram() : m_sum_ns(0) {
+        for (int i = 0; i < BUCKETS; ++i) m_buckets[i].store(0, std::memory_order_relaxed);
+    }
+
+    void record(long long ns) {
+        if (ns < 0) ns = 0;
+        std::atomic<uint64_t>& bucket = m_buckets[index(ns)];
+        bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        m_sum_ns.store(m_sum_ns.load(std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+    }
+};
+
+
+// 6. 合并后的直方图
+struct Histogram_Snapshot {
+    uint64_t buckets[Latency_Histogram::BUCKETS];
+    uint64_t sum_ns;
+    uint64_t count;
+
+    Histogram_Snapshot() : sum_ns(0), count(0) { memset(buckets, 0, sizeof(buckets)); }
+
+    void merge(const Latency_Histogram& h) {
+        for (int i = 0; i < Latency_Histogram::BUCKETS; ++i) {
+            uint64_t n = h.m_buckets[i].load(std::memory_order_relaxed);
+            buckets[i] += n;
+            count += n;
+        }
+        sum_ns += h.m_sum_ns.load(std::memory_order_relaxed);
+    }
+
+    // 第 percent 百分位数的上界（纳秒），没有样本时返回 0
+    uint64_t percentile(double percent) const;
+
+    // 小于等于 ns 的样本数（按桶的上界计算）
+    uint64_t count_le(uint64_t ns) const;
+};
+
+
+// 7. 一个线程的分片
+struct Metrics_Shard {
+    Latency_Histogram stages[STAGE_NUM];
+    std::atomic<uint64_t> counters[COUNTER_NUM];
+    std::atomic<uint64_t> status[METRICS_STATUS_NUM];
+
+    Metrics_Shard() {
+        for (int i = 0; i < COUNTER_NUM; ++i) counters[i].store(0, std::memory_order_relaxed);
+        for (int i = 0; i < METRICS_STATUS_NUM; ++i) status[i].store(0, std::memory_order_relaxed);
+    }
+};
+
+
+class Metrics {
+private:
+    // 8. 成员变量
+    static bool m_enabled;                      // 8.1 是否统计，关闭时下面的函数只剩一次判断
+    static thread_local Metrics_Shard* t_shard; // 8.2 当前线程的分片
+    vector<Metrics_Shard*> m_shards;            // 8.3 所有线程的分片
+    Metrics_Shard m_retired;                    // 8.4 已经退出的线程的分片之和
+    Mutex m_mutex;                              // 8.5 保护 m_shards 和 m_retired
+
+    Metrics() {}
+    Metrics(const Metrics&) {}
+
+    static Metrics_Shard* create_shard();
+
+    static Metrics_Shard* shard() {
+        return t_shard != NULL ? t_shard : create_shard();
+    }
+
+    static void add(std::atomic<uint64_t>& c, uint64_t v) {
+        c.store(c.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+    }
+
+
+public:
+    static Metrics* get_instance() {
+        static Metrics instance;
+        return &instance;
+    }
+
+    // 9. 在创建任何线程之前打开
+    static void set_enabled(bool enabled) { m_enabled = enabled; }
+    static bool enabled() { return m_enabled; }
+
+    // 10. 记录一个阶段的耗时 / 计数器 / 应答的状态码
+    static void record(Metrics_Stage stage, long long ns) {
+        if (m_enabled) shard()->stages[stage].record(ns);
+    }
+
+    static void count(Metrics_Counter counter, uint64_t v = 1) {
+        if (m_enabled) add(shard()->counters[counter], v);
+    }
+
+    static void count_status(int status) {
+        if (!m_enabled) return;
+        int i = 0;
+        while (i < METRICS_STATUS_NUM - 1 && METRICS_STATUS[i] != status) ++i;
+        add(shard()->status[i], 1);
+    }
+
+    // 11. 线程退出时把它的分片合并到 m_retired
+    void retire(Metrics_Shard* shard);
+
+    // 12. 合并所有分片，按 Prometheus 文本格式追加到 out（直方图、分位数、计数器）
+    void render(string& out);
+
+    // 13. 追加一个单值的指标（进程中其他模块的状态，例如线程池的排队任务数）
+    static void put_metric(string& out, const char* name, const char* type, const char* help, double value);
+};
+
+
+
+#endif
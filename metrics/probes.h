@@ -0,0 +1,52 @@
+// USDT 静态探针：在连接、请求、线程池、数据库连接池、定时器、日志的关键位置埋点，用 bpftrace / perf 观察运行中的进程
+// 1. 有 <sys/sdt.h>（systemtap-sdt-dev / systemtap-sdt-devel）时，每个探针编译成一条 nop，探针的位置和参数的位置
+//    记在 ELF 的 .note.stapsdt 段中；没有挂载时只多一条 nop，参数只要求在寄存器或者内存中，不调用函数、不访问共享变量
+// 2. 挂载时 nop 被换成 int3，陷入内核执行 eBPF 程序，每次 1~2 微秒；所以只在要看的时候挂载
+// 3. 没有这个头文件，或者 make USDT=0 时，探针是空宏，参数不会被求值
+// 4. 提供者为 webserver，列出程序中的探针：readelf -n main | grep -A2 stapsdt 或者 bpftrace -l 'usdt:./main:*'
+//
+// 探针（参数依次为 arg0, arg1, ...）：
+//    conn_accept(fd, user_count)               main：accept 并初始化连接、定时器之后
+//    conn_close(fd)                            main：定时器回调或者出错时关闭连接
+//    request_read(fd, read_idx)                HTTP_Conn::read()：一次读成功，read_idx 为读缓冲区中的字节数
+//    request_line(fd, method, url)             HTTP_Conn::parse_request_line()：请求行解析完，method 0 为 GET、1 为 POST
+//    request_write_blocked(fd, bytes_sent)     HTTP_Conn::write()：发送缓冲区满，等待 EPOLLOUT
+//    request_done(fd, status, bytes_sent)      HTTP_Conn::write()：应答的最后一个字节写完
+//    queue_append(fd)                          ThreadPool::append() / append_batch()：请求进入快队列
+//    queue_dequeue(fd, delay_ns)               ThreadPool 工作线程取到请求，delay_ns 为排队时间
+//    queue_slow(fd)                            ThreadPool：请求被放进慢队列（登录、注册）
+//    db_get(conn, sticky)                      Connection_Pool::getConnection()，conn 为 0 表示没有取到
+//    db_release(conn, sticky)                  Connection_Pool::releaseConnection()
+//    timer_add(fd, expire) / timer_adjust(fd, expire) / timer_expire(fd, expire)     Sort_List_Timer
+//    log_enqueue(level, format)                Log::write_log()：写一条文本日志（缓冲区、队列或者同步写），format 为格式字符串
+//    log_drop(level, format)                   Log::write_log()：日志队列满，丢弃；Log::write_binary()：二进制记录太大，丢弃
+//    log_enqueue_binary(size)                  Log::reserve_buffered()：二进制日志预留 size 个字节
+
+#ifndef PROBES_H
+#define PROBES_H
+
+#if !defined(NO_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define HAVE_USDT 1
+#endif
+#endif
+
+
+#ifdef HAVE_USDT
+
+#define SERVER_PROBE1(name, a) do { DTRACE_PROBE1(webserver, name, a); } while (0)
+#define SERVER_PROBE2(name, a, b) do { DTRACE_PROBE2(webserver, name, a, b); } while (0)
+#define SERVER_PROBE3(name, a, b, c) do { DTRACE_PROBE3(webserver, name, a, b, c); } while (0)
+
+#else
+
+#define SERVER_PROBE1(name, a) do { } while (0)
+#define SERVER_PROBE2(name, a, b) do { } while (0)
+#define SERVER_PROBE3(name, a, b, c) do { } while (0)
+
+#endif
+
+
+
+#endif
@@ -0,0 +1,122 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include "request_trace.h"
+
+
+bool Slow_Request_Log::m_enabled = false;
+
+
+static long long mono_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+
+// 1. 计数器的频率：从 init 到现在的间隔越长越准
+double Slow_Request_Log::ticks_per_us() {
+    uint64_t counter = now();
+    long long ns = mono_ns();
+    if (ns <= m_calib_mono_ns || counter <= m_calib_counter) return 1000;
+    return (double)(counter - m_calib_counter) * 1000.0 / (ns - m_calib_mono_ns);
+}
+
+
+// 4. 初始化：粗略校准 10ms，得到阈值对应的周期数
+bool Slow_Request_Log::init(long long threshold_us, int capacity) {
+    if (m_enabled || threshold_us <= 0 || capacity <= 0) return false;
+
+    m_calib_counter = now();
+    m_calib_mono_ns = mono_ns();
+    usleep(10000);
+
+    m_threshold_us = threshold_us;
+    m_threshold_ticks = (uint64_t)(threshold_us * ticks_per_us());
+    m_ring.resize(capacity);
+    m_enabled = true;
+    return true;
+}
+
+
+// 6. 放进环形缓冲区，满了覆盖最旧的
+void Slow_Request_Log::capture(const Slow_Request& request) {
+    m_mutex.lock();
+    m_ring[m_next] = request;
+    m_next = (m_next + 1) % m_ring.size();
+    ++m_captured;
+    m_mutex.unlock();
+}
+
+
+unsigned long long Slow_Request_Log::captured() {
+    m_mutex.lock();
+    unsigned long long n = m_captured;
+    m_mutex.unlock();
+    return n;
+}
+
+
+// 7. 每个请求一行：时间 客户端 fd "方法 url" 状态码 字节数 总耗时 | 各段耗时（毫秒，没有经过的段为 -）| 连接已经建立的时间
+//    read: 开始读到读完  dispatch: 读完到交给线程池  queue: 排队  parse: 解析  slow_queue: 在慢队列中排队
+//    handle: do_request  reply: 填充应答 + 等待可写 + 写
+void Slow_Request_Log::dump(string& out) {
+    static const struct {
+        const char* name;
+        Trace_Point from;
+        Trace_Point to;
+    } segments[] = {
+        {"read", TRACE_BEGIN, TRACE_READ}, {"dispatch", TRACE_READ, TRACE_APPEND}, {"queue", TRACE_APPEND, TRACE_PICKUP},
+        {"parse", TRACE_PICKUP, TRACE_PARSE}, {"slow_queue", TRACE_PARSE, TRACE_SLOW_PICKUP},
+        {"handle", TRACE_SLOW_PICKUP, TRACE_REQUEST}, {"reply", TRACE_REQUEST, TRACE_WRITE}
+    };
+
+    m_mutex.lock();
+    vector<Slow_Request> requests;
+    size_t count = m_captured < m_ring.size() ? m_captured : m_ring.size();
+    for (size_t i = 1; i <= count; ++i) requests.push_back(m_ring[(m_next + m_ring.size() - i) % m_ring.size()]);
+    unsigned long long captured = m_captured;
+    m_mutex.unlock();
+
+    double ticks = ticks_per_us() * 1000;   // 每毫秒的周期数
+    char buf[1024];
+    snprintf(buf, sizeof(buf), "# slow requests over %lldus: captured %llu, showing %zu, newest first\n",
+             m_threshold_us, captured, requests.size());
+    out += buf;
+
+    for (size_t i = 0; i < requests.size(); ++i) {
+        const Slow_Request& r = requests[i];
+        const uint64_t* tsc = r.trace.tsc;
+
+        char addr[INET_ADDRSTRLEN] = "-";
+        inet_ntop(AF_INET, &r.addr.sin_addr, addr, sizeof(addr));
+
+        time_t sec = r.wall_ns / 1000000000LL;
+        struct tm t;
+        localtime_r(&sec, &t);
+
+        int n = snprintf(buf, sizeof(buf), "%d-%02d-%02d %02d:%02d:%02d.%06lld %s:%d fd %d \"%s %s\" %d %lld total %.3fms |",
+                         t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, t.tm_hour, t.tm_min, t.tm_sec,
+                         (long long)(r.wall_ns % 1000000000LL / 1000), addr, ntohs(r.addr.sin_port), r.sockfd,
+                         r.is_post ? "POST" : "GET", r.url, r.status, r.bytes,
+                         (tsc[TRACE_WRITE] - tsc[TRACE_BEGIN]) / ticks);
+
+        for (size_t k = 0; k < sizeof(segments) / sizeof(segments[0]) && n < (int)sizeof(buf); ++k) {
+            // 不是慢请求时，handle 从解析完开始
+            Trace_Point from = segments[k].from;
+            if (from == TRACE_SLOW_PICKUP && tsc[from] == 0) from = TRACE_PARSE;
+
+            uint64_t a = tsc[from], b = tsc[segments[k].to];
+            if (a != 0 && b >= a) n += snprintf(buf + n, sizeof(buf) - n, " %s %.3f", segments[k].name, (b - a) / ticks);
+            else n += snprintf(buf + n, sizeof(buf) - n, " %s -", segments[k].name);
+        }
+        if (n < (int)sizeof(buf) && tsc[TRACE_ACCEPT] != 0 && tsc[TRACE_BEGIN] >= tsc[TRACE_ACCEPT]) {
+            n += snprintf(buf + n, sizeof(buf) - n, " | conn_age %.3f", (tsc[TRACE_BEGIN] - tsc[TRACE_ACCEPT]) / ticks);
+        }
+
+        out += buf;
+        out += '\n';
+    }
+}
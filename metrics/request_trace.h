@@ -0,0 +1,102 @@
+// 请求级别的跟踪：每个连接带一条跟踪记录（Request_Trace），记下当前请求经过各个时间点时的时间戳计数器（x86 上是 rdtsc）
+// 1. 时间点：accept / 开始读 / 读完 / 交给线程池（append）/ 工作线程取到 / 解析完 / 慢队列的线程取到（登录、注册）/
+//    do_request 完 / 最后一个字节写完
+// 2. 写完时，从开始读到写完超过阈值的请求连同 url、客户端地址、状态码一起放进环形缓冲区（满了覆盖最旧的），
+//    通过调试路径（由主线程直接回复，同 /metrics）或者 SIGUSR1 读出来，不需要打开 debug 日志
+// 3. 计数器的频率：init 时用 10ms 粗略校准，用于和阈值比较；输出时用从 init 到现在的间隔重新计算
+
+#ifndef REQUEST_TRACE_H
+#define REQUEST_TRACE_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <netinet/in.h>
+#include "../log/log_binary.h"
+#include "../lock/locker.h"
+
+using namespace std;
+
+
+// 1. 时间点
+enum Trace_Point {
+    TRACE_ACCEPT = 0,           // 1.1 连接 accept（同一个连接上的请求相同）
+    TRACE_BEGIN,                // 1.2 开始读这个请求
+    TRACE_READ,                 // 1.3 读完（最后一次 read() 返回）
+    TRACE_APPEND,               // 1.4 交给线程池
+    TRACE_PICKUP,               // 1.5 工作线程取到
+    TRACE_PARSE,                // 1.6 process_read() 完
+    TRACE_SLOW_PICKUP,          // 1.7 慢队列的线程取到（只有登录/注册）
+    TRACE_REQUEST,              // 1.8 do_request() 完
+    TRACE_WRITE,                // 1.9 最后一个字节写完
+    TRACE_POINT_NUM
+};
+
+struct Request_Trace {
+    uint64_t tsc[TRACE_POINT_NUM];
+};
+
+
+// 2. 环形缓冲区中的一个慢请求
+struct Slow_Request {
+    Request_Trace trace;
+    int64_t wall_ns;                // 2.1 写完时的墙上时间
+    struct sockaddr_in addr;        // 2.2 客户端地址
+    int sockfd;
+    int status;
+    bool is_post;
+    long long bytes;                // 2.3 发送的字节数
+    char url[128];
+};
+
+
+class Slow_Request_Log {
+private:
+    // 3. 成员变量
+    static bool m_enabled;                  // 3.1 是否跟踪
+    uint64_t m_threshold_ticks;             // 3.2 阈值（计数器的周期数）
+    long long m_threshold_us;
+    uint64_t m_calib_counter;               // 3.3 init 时的计数器和单调时钟，输出时用来计算频率
+    long long m_calib_mono_ns;
+    vector<Slow_Request> m_ring;            // 3.4 环形缓冲区
+    size_t m_next;                          // 3.5 下一个写入的位置
+    unsigned long long m_captured;          // 3.6 记录过的慢请求数
+    Mutex m_mutex;
+
+    Slow_Request_Log() : m_threshold_ticks(0), m_threshold_us(0), m_calib_counter(0), m_calib_mono_ns(0), m_next(0),
+                         m_captured(0) {}
+    Slow_Request_Log(const Slow_Request_Log&) {}
+
+    double ticks_per_us();
+
+
+public:
+    static Slow_Request_Log* get_instance() {
+        static Slow_Request_Log instance;
+        return &instance;
+    }
+
+    // 4. 初始化：threshold_us 为阈值，capacity 为环形缓冲区的容量；在创建任何工作线程之前调用
+    bool init(long long threshold_us, int capacity);
+
+    static bool enabled() { return m_enabled; }
+
+    static uint64_t now() { return Log_Binary::counter(); }
+
+    // 5. 从开始读到写完是否超过阈值
+    bool is_slow(const Request_Trace& trace) {
+        return trace.tsc[TRACE_BEGIN] != 0 && trace.tsc[TRACE_WRITE] - trace.tsc[TRACE_BEGIN] >= m_threshold_ticks;
+    }
+
+    // 6. 放进环形缓冲区
+    void capture(const Slow_Request& request);
+
+    // 7. 按从新到旧的顺序，每个请求一行，追加到 out
+    void dump(string& out);
+
+    unsigned long long captured();
+};
+
+
+
+#endif
@@ -0,0 +1,155 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include "local_user_store.h"
+
+
+
+Local_User_Store::~Local_User_Store() {
+    if (m_fd >= 0) close(m_fd);
+}
+
+
+// 1. 打开数据文件，并读入所有用户
+bool Local_User_Store::init(const char* file_name, bool sync_write) {
+    m_sync_write = sync_write;
+
+    m_fd = open(file_name, O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (m_fd < 0) {
+        LOG_ERROR("open local user store %s is error: %s", file_name, strerror(errno));
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(m_fd, &st) < 0) return false;
+
+    // 1.1 一次读入整个文件
+    string data(st.st_size, '\0');
+    size_t have_read = 0;
+    while (have_read < data.size()) {
+        ssize_t n = pread(m_fd, &data[have_read], data.size() - have_read, have_read);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        have_read += n;
+    }
+    data.resize(have_read);
+
+    // 1.2 逐条解析
+    size_t pos = 0;
+    while (pos + 8 <= data.size()) {
+        uint32_t name_len = 0, password_len = 0;
+        memcpy(&name_len, &data[pos], 4);
+        memcpy(&password_len, &data[pos + 4], 4);
+        if (pos + 8 + name_len + password_len > data.size()) break;
+
+        string name = data.substr(pos + 8, name_len);
+        User_Row row;
+        row.id = m_names.size() + 1;
+        row.password = data.substr(pos + 8 + name_len, password_len);
+
+        m_users[name] = row;
+        m_names.push_back(name);
+        pos += 8 + name_len + password_len;
+    }
+
+    // 1.3 截掉末尾不完整的记录
+    if (pos < (size_t)st.st_size) {
+        LOG_WARN("local user store %s has a truncated record, truncate to %d bytes", file_name, (int)pos);
+        if (ftruncate(m_fd, pos) != 0) return false;
+    }
+
+    LOG_INFO("open local user store %s is ok, users: %d", file_name, (int)m_names.size());
+    return true;
+}
+
+
+// 2. 点查
+bool Local_User_Store::find_user(const string& name, string& password, bool& found) {
+    m_mutex.lock();
+
+    unordered_map<string, User_Row>::iterator it = m_users.find(name);
+    found = (it != m_users.end());
+    if (found) password = it->second.password;
+
+    m_mutex.unlock();
+    return true;
+}
+
+
+// 3. 注册：先追加写数据文件，成功后再放进哈希表
+bool Local_User_Store::insert_user(const string& name, const string& password) {
+    m_mutex.lock();
+
+    if (m_fd < 0 || m_users.find(name) != m_users.end()) {
+        m_mutex.unlock();
+        return false;
+    }
+
+    uint32_t lens[2] = {(uint32_t)name.size(), (uint32_t)password.size()};
+    struct iovec iv[3];
+    iv[0].iov_base = lens;
+    iv[0].iov_len = sizeof(lens);
+    iv[1].iov_base = (void*)name.data();
+    iv[1].iov_len = name.size();
+    iv[2].iov_base = (void*)password.data();
+    iv[2].iov_len = password.size();
+
+    ssize_t total = sizeof(lens) + name.size() + password.size();
+    if (writev(m_fd, iv, 3) != total || (m_sync_write && fdatasync(m_fd) != 0)) {
+        LOG_ERROR("write local user store is error: %s", strerror(errno));
+        m_mutex.unlock();
+        return false;
+    }
+
+    User_Row row;
+    row.id = m_names.size() + 1;
+    row.password = password;
+    m_users[name] = row;
+    m_names.push_back(name);
+
+    m_mutex.unlock();
+    return true;
+}
+
+
+// 4. 用户数
+bool Local_User_Store::count_users(unsigned long long& count) {
+    m_mutex.lock();
+    count = m_names.size();
+    m_mutex.unlock();
+
+    return true;
+}
+
+
+// 5. 按 id 扫描：每次在锁内拷贝一批，回调在锁外执行，不会长时间阻塞注册
+bool Local_User_Store::scan_users(uint64_t after_id, Scan_Callback callback, void* arg) {
+    static const size_t BATCH = 1024;
+    vector<pair<string, string> > batch;
+    uint64_t next_id = after_id + 1;
+
+    while (true) {
+        batch.clear();
+
+        m_mutex.lock();
+        for (; next_id <= m_names.size() && batch.size() < BATCH; ++next_id) {
+            const string& name = m_names[next_id - 1];
+            batch.push_back(make_pair(name, m_users[name].password));
+        }
+        m_mutex.unlock();
+
+        if (batch.empty()) break;
+
+        uint64_t id = next_id - batch.size();
+        for (size_t i = 0; i < batch.size(); ++i, ++id) {
+            callback(arg, id, batch[i].first.data(), batch[i].first.size(),
+                     batch[i].second.data(), batch[i].second.size());
+        }
+    }
+
+    return true;
+}
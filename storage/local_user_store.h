@@ -0,0 +1,51 @@
+// 本地存储后端：进程内哈希表 + 追加写的数据文件，不需要外部数据库
+// 1. 数据文件由若干条记录组成：uint32 用户名长度 + uint32 密码长度 + 用户名 + 密码，
+//    第 i 条记录的 id 为 i（从 1 开始），与 MySQL 的自增列 id 含义相同
+// 2. 启动时顺序读入整个文件；末尾不完整的记录（写到一半时崩溃）会被截掉
+// 3. 注册时 write() 追加一条记录，sync_write 为 true 时再 fdatasync
+
+#ifndef LOCAL_USER_STORE_H
+#define LOCAL_USER_STORE_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "user_store.h"
+#include "../lock/locker.h"
+#include "../log/log.h"
+
+
+
+class Local_User_Store : public User_Store {
+private:
+    // 1. 成员变量
+    struct User_Row {
+        uint64_t id;
+        string password;
+    };
+
+    unordered_map<string, User_Row> m_users;    // 1.1 用户名 -> 行
+    vector<string> m_names;                     // 1.2 按 id 排列的用户名，用于按 id 扫描
+    int m_fd;                                   // 1.3 数据文件
+    bool m_sync_write;                          // 1.4 每次注册后是否 fdatasync
+    Mutex m_mutex;                              // 1.5 互斥锁
+
+public:
+    Local_User_Store() : m_fd(-1), m_sync_write(false) {}
+    ~Local_User_Store();
+
+    // 2. 打开（不存在时创建）数据文件，并读入所有用户
+    bool init(const char* file_name, bool sync_write = false);
+
+    bool find_user(const string& name, string& password, bool& found);
+    bool insert_user(const string& name, const string& password);
+    bool count_users(unsigned long long& count);
+    bool scan_users(uint64_t after_id, Scan_Callback callback, void* arg);
+
+    const char* name() { return "local"; }
+};
+
+
+
+#endif
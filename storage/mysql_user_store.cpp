@@ -0,0 +1,127 @@
+#include "mysql_user_store.h"
+
+
+
+// 1. 点查
+bool Mysql_User_Store::find_user(const string& name, string& password, bool& found) {
+    found = false;
+
+    MYSQL* mysql = NULL;
+    ConnectionRAII mysqlConn(&mysql, m_conn_pool);
+    if (mysql == NULL) return false;
+
+    string sql = "SELECT passwd FROM user WHERE username = '" + escape(mysql, name) + "' LIMIT 1";
+    if (mysql_query(mysql, sql.c_str()) != 0) {
+        LOG_ERROR("mysql_query() is error: %s", mysql_error(mysql));
+        return false;
+    }
+
+    MYSQL_RES* result = mysql_store_result(mysql);
+    if (result == NULL) {
+        LOG_ERROR("mysql_store_result() is error: %s", mysql_error(mysql));
+        return false;
+    }
+
+    MYSQL_ROW row = mysql_fetch_row(result);
+    if (row != NULL) {
+        found = true;
+        password = row[0] ? row[0] : "";
+    }
+
+    mysql_free_result(result);
+    return true;
+}
+
+
+// 2. 注册
+bool Mysql_User_Store::insert_user(const string& name, const string& password) {
+    MYSQL* mysql = NULL;
+    ConnectionRAII mysqlConn(&mysql, m_conn_pool);
+    if (mysql == NULL) return false;
+
+    string sql_insert = "INSERT INTO user(username, passwd) VALUES('" + escape(mysql, name) + "', '"
+                        + escape(mysql, password) + "')";
+
+    if (mysql_query(mysql, sql_insert.c_str()) != 0) {
+        LOG_ERROR("mysql_query() is error: %s", mysql_error(mysql));
+        return false;
+    }
+
+    return true;
+}
+
+
+// 3. 用户数
+bool Mysql_User_Store::count_users(unsigned long long& count) {
+    count = 0;
+
+    MYSQL* mysql = NULL;
+    ConnectionRAII mysqlConn(&mysql, m_conn_pool);
+    if (mysql == NULL) return false;
+
+    if (mysql_query(mysql, "SELECT COUNT(*) FROM user") != 0) {
+        LOG_ERROR("mysql_query() is error: %s", mysql_error(mysql));
+        return false;
+    }
+
+    MYSQL_RES* result = mysql_store_result(mysql);
+    if (result == NULL) {
+        LOG_ERROR("mysql_store_result() is error: %s", mysql_error(mysql));
+        return false;
+    }
+
+    MYSQL_ROW row = mysql_fetch_row(result);
+    if (row != NULL && row[0] != NULL) count = strtoull(row[0], NULL, 10);
+
+    mysql_free_result(result);
+    return true;
+}
+
+
+// 4. 流式扫描：mysql_use_result 逐行读取，不会把整张表放进内存
+// 4. 表没有 id 列时只能扫描整张表，此时 id 都为 0
+bool Mysql_User_Store::scan_users(uint64_t after_id, Scan_Callback callback, void* arg) {
+    MYSQL* mysql = NULL;
+    ConnectionRAII mysqlConn(&mysql, m_conn_pool);
+    if (mysql == NULL) return false;
+
+    char sql[128] = {0};
+    if (m_has_id) {
+        snprintf(sql, sizeof(sql), "SELECT username, passwd, id FROM user WHERE id > %llu", (unsigned long long)after_id);
+    }
+    else {
+        snprintf(sql, sizeof(sql), "SELECT username, passwd FROM user");
+    }
+
+    if (mysql_query(mysql, sql) != 0) {
+        LOG_ERROR("mysql_query() is error: %s", mysql_error(mysql));
+        return false;
+    }
+
+    MYSQL_RES* result = mysql_use_result(mysql);
+    if (result == NULL) {
+        LOG_ERROR("mysql_use_result() is error: %s", mysql_error(mysql));
+        return false;
+    }
+
+    while (MYSQL_ROW row = mysql_fetch_row(result)) {
+        unsigned long* lengths = mysql_fetch_lengths(result);
+        if (row[0] == NULL || row[1] == NULL) continue;
+
+        uint64_t id = m_has_id && row[2] ? strtoull(row[2], NULL, 10) : 0;
+        callback(arg, id, row[0], lengths[0], row[1], lengths[1]);
+    }
+
+    mysql_free_result(result);
+    return true;
+}
+
+
+// 5. 转义
+string Mysql_User_Store::escape(MYSQL* mysql, const string& str) {
+    string escaped(str.size() * 2 + 1, '\0');
+    unsigned long len = mysql_real_escape_string(mysql, &escaped[0], str.c_str(), str.size());
+    escaped.resize(len);
+
+    return escaped;
+}
@@ -0,0 +1,42 @@
+// MySQL 存储后端：每次操作从 Connection_Pool 借一个连接，工作线程调用 bind_thread() 后直接用独占连接
+
+#ifndef MYSQL_USER_STORE_H
+#define MYSQL_USER_STORE_H
+
+#include <mysql/mysql.h>
+
+#include "user_store.h"
+#include "../log/log.h"
+#include "../connectionpool/mysql_connection_pool.h"
+
+
+
+class Mysql_User_Store : public User_Store {
+private:
+    Connection_Pool* m_conn_pool;       // 1. 连接池
+    bool m_has_id;                      // 2. user 表是否有自增列 id（使用快照时需要）
+    bool m_sticky_conn;                 // 3. bind_thread() 时是否让线程独占一个连接
+
+public:
+    Mysql_User_Store(Connection_Pool* conn_pool, bool has_id = false, bool sticky_conn = false)
+        : m_conn_pool(conn_pool), m_has_id(has_id), m_sticky_conn(sticky_conn) {}
+
+    bool find_user(const string& name, string& password, bool& found);
+    bool insert_user(const string& name, const string& password);
+    bool count_users(unsigned long long& count);
+    bool scan_users(uint64_t after_id, Scan_Callback callback, void* arg);
+
+    // 让当前线程独占一个连接（不阻塞，连接不够时该线程仍然按次借还）
+    void bind_thread() { if (m_sticky_conn) m_conn_pool->bindThreadConnection(); }
+    void unbind_thread() { if (m_sticky_conn) m_conn_pool->unbindThreadConnection(); }
+
+    const char* name() { return "mysql"; }
+
+private:
+    // 转义后拼接到 SQL 中
+    static string escape(MYSQL* mysql, const string& str);
+};
+
+
+
+#endif
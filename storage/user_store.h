@@ -0,0 +1,47 @@
+// 用户数据的存储后端接口，User_Table 通过它完成点查、注册和整表扫描
+// 1. Mysql_User_Store：原来的 MySQL 实现，使用 Connection_Pool
+// 2. Local_User_Store：进程内的本地存储（哈希表 + 追加写的数据文件），不依赖外部服务，用于压测和单机部署
+
+#ifndef USER_STORE_H
+#define USER_STORE_H
+
+#include <string>
+#include <stddef.h>
+#include <stdint.h>
+
+using namespace std;
+
+
+
+class User_Store {
+public:
+    // 1. 扫描回调：每一行调用一次，id 为该行的自增 id（后端没有 id 时为 0）
+    typedef void (*Scan_Callback)(void* arg, uint64_t id, const char* name, size_t name_len,
+                                  const char* password, size_t password_len);
+
+public:
+    virtual ~User_Store() {}
+
+    // 2. 点查：执行成功返回 true，found 表示用户名是否存在
+    virtual bool find_user(const string& name, string& password, bool& found) = 0;
+
+    // 3. 注册：插入成功返回 true，用户名已存在或者出错时返回 false
+    virtual bool insert_user(const string& name, const string& password) = 0;
+
+    // 4. 用户数
+    virtual bool count_users(unsigned long long& count) = 0;
+
+    // 5. 流式扫描 id > after_id 的行
+    virtual bool scan_users(uint64_t after_id, Scan_Callback callback, void* arg) = 0;
+
+    // 6. 工作线程启动/退出时调用，后端可以为该线程预留资源（例如独占一个数据库连接）
+    virtual void bind_thread() {}
+    virtual void unbind_thread() {}
+
+    // 7. 后端名称，用于日志
+    virtual const char* name() = 0;
+};
+
+
+
+#endif
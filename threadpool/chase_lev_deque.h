@@ -0,0 +1,94 @@
+// 有界的 Chase-Lev 双端队列，用于 Work_Stealing_Pool
+// 1. 只有一个所有者（owner）线程可以 push，在 bottom 端写入，不需要 CAS
+// 2. 任意线程都可以 steal，从 top 端取出，多个线程竞争同一个元素时用 CAS 决定胜负
+// 3. 在 Work_Stealing_Pool 中所有者是主线程（reactor），工作线程都从 top 端取，所以每个队列是 FIFO 的
+// 4. 每个位置还带一个时间戳（入队时间），和元素一起放入、一起取出，用于统计排队延迟
+
+#ifndef CHASE_LEV_DEQUE_H
+#define CHASE_LEV_DEQUE_H
+
+#include <atomic>
+#include <exception>
+#include <stdint.h>
+
+
+template<typename T>
+class Chase_Lev_Deque {
+public:
+    // steal() 的结果
+    enum STEAL_STATUS {
+        STEAL_OK = 0,           // 取到了一个元素
+        STEAL_EMPTY = 1,        // 队列为空
+        STEAL_ABORT = 2         // 与其他线程竞争失败，队列中可能还有元素，需要重试
+    };
+
+private:
+    // 1. 成员变量，top 和 bottom 分别由窃取者和所有者修改，各占一个 cache line
+    alignas(64) std::atomic<int64_t> m_top;         // 1.1 下一个被窃取的位置
+    alignas(64) std::atomic<int64_t> m_bottom;      // 1.2 下一个 push 的位置
+    alignas(64) std::atomic<T>* m_buffer;           // 1.3 环形数组
+    std::atomic<long long>* m_stamps;               // 1.4 每个位置的时间戳
+    int64_t m_mask;                                 // 1.5 容量 - 1，容量是 2 的整数次幂
+
+
+public:
+    // 2. 构造函数和析构函数，容量向上取整到 2 的整数次幂
+    Chase_Lev_Deque(int capacity) : m_top(0), m_bottom(0), m_buffer(NULL), m_stamps(NULL), m_mask(0)
+    {
+        if (capacity <= 0) throw std::exception();
+
+        int64_t size = 1;
+        while (size < capacity) size <<= 1;
+
+        m_buffer = new std::atomic<T>[size];
+        m_stamps = new std::atomic<long long>[size];
+        m_mask = size - 1;
+    }
+
+    ~Chase_Lev_Deque() {
+        delete[] m_buffer;
+        delete[] m_stamps;
+    }
+
+    // 3. 所有者在 bottom 端放入一个元素和它的时间戳，队列已满时返回 false
+    bool push(T item, long long stamp = 0) {
+        int64_t b = m_bottom.load(std::memory_order_relaxed);
+        int64_t t = m_top.load(std::memory_order_acquire);
+        if (b - t > m_mask) return false;
+
+        m_buffer[b & m_mask].store(item, std::memory_order_relaxed);
+        m_stamps[b & m_mask].store(stamp, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        m_bottom.store(b + 1, std::memory_order_relaxed);
+
+        return true;
+    }
+
+    // 4. 任意线程在 top 端取出一个元素，stamp 不为 NULL 时同时取出它的时间戳
+    STEAL_STATUS steal(T& item, long long* stamp = NULL) {
+        int64_t t = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = m_bottom.load(std::memory_order_acquire);
+
+        if (t >= b) return STEAL_EMPTY;
+
+        item = m_buffer[t & m_mask].load(std::memory_order_relaxed);
+        if (stamp) *stamp = m_stamps[t & m_mask].load(std::memory_order_relaxed);
+        if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return STEAL_ABORT;
+        }
+
+        return STEAL_OK;
+    }
+
+    // 5. 当前元素个数（并发时只是一个估计值）
+    int64_t size() {
+        int64_t b = m_bottom.load(std::memory_order_relaxed);
+        int64_t t = m_top.load(std::memory_order_relaxed);
+        return b > t ? b - t : 0;
+    }
+};
+
+
+
+#endif
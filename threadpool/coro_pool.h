@@ -0,0 +1,75 @@
+// 协程线程池，接口与 ThreadPool 相同，make POOL=coro 时使用（需要 -std=c++20）
+// 1. 每个请求是一个协程 request->serve(scheduler)，在少量调度线程上执行，解析请求、填充应答都在调度线程中完成
+// 2. 数据库查询、读入冷文件这类会阻塞的步骤用 co_await 交给阻塞线程，协程挂起期间不占用调度线程
+// 3. 构造参数的含义：thread_num 是阻塞线程数（thread_init/thread_exit 在阻塞线程中调用，例如独占一个数据库连接），
+//    fast_threads 是调度线程数（为 0 时使用 2 个），max_requests 是同时在处理中的请求数上限
+// 4. 线程数固定，set_adaptive() 只记录一条日志
+// 5. 排队延迟是协程在调度器就绪队列中等待的时间，get_stats() 每 STATS_INTERVAL_MS 取一次 p95
+
+#ifndef CORO_POOL_H
+#define CORO_POOL_H
+
+#include <atomic>
+#include <cstdio>
+#include <string.h>
+#include "coro_scheduler.h"
+#include "pool_stats.h"
+#include "../log/log.h"
+
+
+template<typename T>
+class Coro_Pool {
+private:
+    static const int STATS_INTERVAL_MS = 1000;  // 排队延迟 p95 的统计周期
+
+    // 1. 成员变量
+    int m_max_requests;                         // 1.1 同时在处理中的请求数上限
+    Coro_Scheduler m_scheduler;                 // 1.2 调度器
+    std::atomic<unsigned long long> m_tasks;    // 1.3 接收的请求数
+    Delay_Window m_delay_window;                // 1.4 按周期取出的排队延迟 p95
+
+public:
+    // 2. 构造函数
+    Coro_Pool(int thread_num = 8, int max_requests = 1000, void (*thread_init)() = NULL, void (*thread_exit)() = NULL,
+              int fast_threads = 0)
+        : m_max_requests(max_requests), m_scheduler(fast_threads > 0 ? fast_threads : 2, thread_num, max_requests, thread_init, thread_exit),
+          m_tasks(0)
+    {
+        LOG_INFO("success create coroutine pool, scheduler threads: %d, blocking threads: %d",
+                 fast_threads > 0 ? fast_threads : 2, thread_num);
+    }
+
+    // 3. 往请求队列中添加任务：为请求创建一个协程，交给调度器
+    bool append(T* request) {
+        if (m_scheduler.inflight() >= m_max_requests) return false;
+
+        m_scheduler.spawn(request->serve(&m_scheduler));
+        m_tasks.fetch_add(1, std::memory_order_relaxed);
+
+        LOG_DEBUG("coroutine pool append request is ok, connfd: %d", request->m_sockfd);
+        return true;
+    }
+
+    int append_batch(T** requests, int n) {
+        int count = 0;
+        while (count < n && append(requests[count])) ++count;
+        return count;
+    }
+
+    // 4. 与 ThreadPool 的接口相同：不支持自动伸缩；统计快照
+    void set_adaptive(int min_threads, int max_threads, int target_delay_us, int interval_ms = 1000) {
+        LOG_WARN("coroutine pool has a fixed size, ignore adaptive threads: [%d, %d]", min_threads, max_threads);
+    }
+
+    void get_stats(Pool_Stats& stats) {
+        memset(&stats, 0, sizeof(stats));
+        stats.threads = stats.min_threads = stats.max_threads = m_scheduler.threads();
+        stats.queue_size = m_scheduler.queue_size();
+        stats.delay_p95_us = m_delay_window.p95(m_scheduler.delay(), STATS_INTERVAL_MS);
+        stats.tasks = m_tasks.load();
+    }
+};
+
+
+
+#endif
@@ -0,0 +1,185 @@
+// C++20 协程的调度器，Coro_Pool 和 HTTP_Conn::serve() 使用，需要 -std=c++20
+// 1. 少量调度线程从就绪队列中取出协程并恢复执行，协程中只做不会阻塞的工作（解析请求、填充应答）
+// 2. 会阻塞的工作（数据库查询、读入不在 page cache 中的文件）用 co_await offload(fn) 交给阻塞线程执行，
+//    协程在此期间挂起，不占用调度线程；fn 执行完后协程重新进入就绪队列，由某个调度线程继续执行
+// 3. Coro_Task 是不返回结果的协程：创建后先挂起，spawn() 之后才开始执行，执行完自动销毁
+// 4. 就绪队列中的协程带有入队的时间，调度线程取出时记录排队延迟（新请求和 offload 之后重新就绪的协程都算）
+
+#ifndef CORO_SCHEDULER_H
+#define CORO_SCHEDULER_H
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <pthread.h>
+#include "../lock/locker.h"
+#include "../lock/mpmc_ring.h"
+#include "pool_stats.h"
+
+
+class Coro_Scheduler;
+
+
+// 1. 协程的返回类型
+struct Coro_Task {
+    struct promise_type {
+        Coro_Scheduler* scheduler = nullptr;        // spawn() 时设置，协程结束时通知调度器
+
+        Coro_Task get_return_object() { return Coro_Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+        ~promise_type();
+    };
+
+    std::coroutine_handle<promise_type> handle;
+
+    explicit Coro_Task(std::coroutine_handle<promise_type> h) : handle(h) {}
+};
+
+
+// 2. 交给阻塞线程执行的工作
+struct Coro_Job {
+    virtual void run() = 0;
+    virtual ~Coro_Job() {}
+};
+
+
+class Coro_Scheduler {
+private:
+    // 3. 就绪队列中的协程，带有入队的时间
+    struct Ready {
+        std::coroutine_handle<> handle;
+        long long enqueue_ns;
+    };
+
+    // 3. 成员变量
+    int m_sched_num;                                        // 3.1 调度线程数
+    int m_blocking_num;                                     // 3.2 阻塞线程数
+    Mpmc_Ring<Ready> m_ready;                                // 3.3 就绪的协程
+    Mpmc_Ring<Coro_Job*> m_jobs;                            // 3.4 等待阻塞线程执行的工作
+    std::atomic<int> m_inflight;                            // 3.5 还没有结束的协程数
+    std::atomic<unsigned long long> m_offloads;             // 3.6 交给阻塞线程的工作数
+    void (*m_blocking_init)();                              // 3.7 阻塞线程启动时的回调，例如独占一个数据库连接
+    void (*m_blocking_exit)();                              // 3.8 阻塞线程退出时的回调
+    Delay_Histogram m_delay;                                // 3.9 就绪队列中的排队延迟
+    bool m_stop;
+
+public:
+    // 4. offload() 返回的 awaiter：挂起当前协程，在阻塞线程中执行 fn，再把协程放回就绪队列，co_await 的结果是 fn 的返回值
+    template<typename R>
+    struct Offload_Awaiter : public Coro_Job {
+        Coro_Scheduler* scheduler;
+        std::function<R()> fn;
+        R result;
+        std::coroutine_handle<> handle;
+
+        Offload_Awaiter(Coro_Scheduler* s, std::function<R()> f) : scheduler(s), fn(f), result() {}
+
+        bool await_ready() { return false; }
+        void await_suspend(std::coroutine_handle<> h) {
+            // submit 之后协程可能立刻在其他线程中恢复，这里不能再访问 this
+            handle = h;
+            scheduler->submit(this);
+        }
+        R await_resume() { return result; }
+
+        void run() {
+            result = fn();
+            scheduler->schedule(handle);
+        }
+    };
+
+    // 5. 构造函数和析构函数
+    Coro_Scheduler(int sched_num, int blocking_num, int max_tasks, void (*blocking_init)() = NULL, void (*blocking_exit)() = NULL)
+        : m_sched_num(sched_num), m_blocking_num(blocking_num), m_ready(max_tasks), m_jobs(max_tasks), m_inflight(0),
+          m_offloads(0), m_blocking_init(blocking_init), m_blocking_exit(blocking_exit), m_stop(false)
+    {
+        if (sched_num <= 0 || blocking_num <= 0) throw std::exception();
+
+        for (int i = 0; i < sched_num + blocking_num; ++i) {
+            pthread_t tid;
+            if (pthread_create(&tid, NULL, i < sched_num ? sched_worker : blocking_worker, this) != 0) {
+                throw std::exception();
+            }
+            pthread_detach(tid);
+        }
+    }
+
+    ~Coro_Scheduler() {
+        m_stop = true;
+    }
+
+    // 6. 开始执行一个协程
+    void spawn(Coro_Task task) {
+        task.handle.promise().scheduler = this;
+        m_inflight.fetch_add(1);
+        schedule(task.handle);
+    }
+
+    // 7. 把会阻塞的 fn 交给阻塞线程：co_await scheduler->offload(fn)
+    template<typename F>
+    Offload_Awaiter<decltype(std::declval<F>()())> offload(F fn) {
+        return Offload_Awaiter<decltype(std::declval<F>()())>(this, fn);
+    }
+
+    // 8. 协程重新进入就绪队列 / 工作进入阻塞线程的队列
+    void schedule(std::coroutine_handle<> handle) {
+        Ready ready = {handle, monotonic_ns()};
+        m_ready.push_wait(ready);
+    }
+    void submit(Coro_Job* job) {
+        m_offloads.fetch_add(1, std::memory_order_relaxed);
+        m_jobs.push_wait(job);
+    }
+
+    // 9. 统计
+    int inflight() { return m_inflight.load(); }
+    int threads() { return m_sched_num + m_blocking_num; }
+    int queue_size() { return m_ready.size() + m_jobs.size(); }
+    unsigned long long offloads() { return m_offloads.load(); }
+    Delay_Histogram& delay() { return m_delay; }
+    void finish() { m_inflight.fetch_sub(1); }
+
+private:
+    // 10. 调度线程：恢复就绪的协程，协程运行到下一个 co_await 或者结束时返回
+    static void* sched_worker(void* arg) {
+        Coro_Scheduler* scheduler = (Coro_Scheduler*)arg;
+        while (!scheduler->m_stop) {
+            Ready ready = {};
+            scheduler->m_ready.pop_wait(ready);
+            if (ready.handle) {
+                scheduler->m_delay.add((monotonic_ns() - ready.enqueue_ns) / 1000);
+                ready.handle.resume();
+            }
+        }
+        return scheduler;
+    }
+
+    // 11. 阻塞线程：执行 offload 的工作
+    static void* blocking_worker(void* arg) {
+        Coro_Scheduler* scheduler = (Coro_Scheduler*)arg;
+        if (scheduler->m_blocking_init) scheduler->m_blocking_init();
+
+        while (!scheduler->m_stop) {
+            Coro_Job* job = NULL;
+            scheduler->m_jobs.pop_wait(job);
+            if (job) job->run();
+        }
+
+        if (scheduler->m_blocking_exit) scheduler->m_blocking_exit();
+        return scheduler;
+    }
+};
+
+
+// 协程结束（final_suspend 之后销毁）时通知调度器
+inline Coro_Task::promise_type::~promise_type() {
+    if (scheduler) scheduler->finish();
+}
+
+
+
+#endif
@@ -0,0 +1,99 @@
+// 线程的 CPU 亲和性与 NUMA 放置
+// 1. CPU 列表使用与 taskset -c / cpuset 相同的格式，例如 "0-7,16-23"
+// 2. 线程绑定到一组 CPU 上（而不是每个线程一个 CPU），由内核在组内调度；双路服务器上一组 CPU 应该在同一个 NUMA 节点内
+// 3. 内存在第一次写入（first-touch）时才分配物理页，分配在写入线程当前所在的 NUMA 节点上，
+//    所以要在绑定之后由拥有这块内存的线程先写一遍
+
+#ifndef CPU_AFFINITY_H
+#define CPU_AFFINITY_H
+
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <pthread.h>
+
+
+// 1. 解析 CPU 列表，空字符串或格式错误时返回 false
+inline bool parse_cpu_list(const char* list, cpu_set_t& set) {
+    CPU_ZERO(&set);
+    if (list == NULL || list[0] == '\0') return false;
+
+    const char* p = list;
+    while (*p) {
+        char* end = NULL;
+        long first = strtol(p, &end, 10);
+        if (end == p || first < 0 || first >= CPU_SETSIZE) return false;
+
+        long last = first;
+        p = end;
+        if (*p == '-') {
+            last = strtol(p + 1, &end, 10);
+            if (end == p + 1 || last < first || last >= CPU_SETSIZE) return false;
+            p = end;
+        }
+
+        for (long cpu = first; cpu <= last; ++cpu) CPU_SET(cpu, &set);
+
+        if (*p == ',') ++p;
+        else if (*p != '\0') return false;
+    }
+    return CPU_COUNT(&set) > 0;
+}
+
+
+// 2. 把当前线程绑定到 set 中的 CPU 上
+inline bool pin_thread(const cpu_set_t& set) {
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &set) == 0;
+}
+
+
+// 3. CPU 所在的 NUMA 节点（/sys/devices/system/cpu/cpuN/nodeM），不知道时返回 -1
+inline int cpu_node(int cpu) {
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+
+    DIR* dir = opendir(path);
+    if (dir == NULL) return -1;
+
+    int node = -1;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (strncmp(entry->d_name, "node", 4) == 0 && entry->d_name[4] >= '0' && entry->d_name[4] <= '9') {
+            node = atoi(entry->d_name + 4);
+            break;
+        }
+    }
+    closedir(dir);
+    return node;
+}
+
+
+// 4. 一组 CPU 所在的 NUMA 节点：跨节点或者不知道时返回 -1
+inline int cpu_set_node(const cpu_set_t& set) {
+    int node = -1;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (!CPU_ISSET(cpu, &set)) continue;
+
+        int n = cpu_node(cpu);
+        if (n < 0 || (node >= 0 && n != node)) return -1;
+        node = n;
+    }
+    return node;
+}
+
+
+// 5. first-touch：每页写一次（写回原来的值，不改变内容），让物理页分配在当前线程所在的 NUMA 节点上
+inline void first_touch(void* addr, size_t len) {
+    long page = sysconf(_SC_PAGESIZE);
+    volatile char* p = (volatile char*)addr;
+    for (size_t off = 0; off < len; off += page) {
+        p[off] = p[off];
+    }
+}
+
+
+
+#endif
@@ -0,0 +1,110 @@
+// 线程池的统计：排队延迟的直方图，以及对外暴露的统计快照 Pool_Stats
+// 没有统计线程的线程池（Work_Stealing_Pool、Coro_Pool）用 Delay_Window 在 get_stats() 中按周期取 p95
+
+#ifndef POOL_STATS_H
+#define POOL_STATS_H
+
+#include <atomic>
+#include <time.h>
+#include <string.h>
+
+
+// 1. 单调时钟，纳秒
+inline long long monotonic_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+
+// 2. 线程池的统计快照
+struct Pool_Stats {
+    int threads;                            // 2.1 当前的线程数
+    int min_threads;                        // 2.2 线程数的下限
+    int max_threads;                        // 2.3 线程数的上限
+    int queue_size;                         // 2.4 排队中的任务数
+    long long delay_p95_us;                 // 2.5 最近一个统计周期内排队延迟的 p95（微秒）
+    double utilization;                     // 2.6 最近一个统计周期内工作线程的忙碌比例
+    unsigned long long tasks;               // 2.7 处理过的任务数
+    unsigned long long grow_count;          // 2.8 扩容的次数
+    unsigned long long shrink_count;        // 2.9 缩容的次数
+};
+
+
+// 3. 排队延迟的直方图（微秒）：每个 2 的整数次幂区间再分成 4 个桶，相对误差不超过 25%
+//    add() 只有一次原子加；统计线程用 take_percentile() 取出一个周期的分位数并清零
+class Delay_Histogram {
+private:
+    static const int BUCKETS = 41 * 4;
+    std::atomic<unsigned long long> m_buckets[BUCKETS];
+
+    static int index(unsigned long long us) {
+        if (us < 4) return (int)us;
+
+        int msb = 63 - __builtin_clzll(us);
+        int idx = 4 * (msb - 1) + (int)((us >> (msb - 2)) & 3);
+        return idx < BUCKETS ? idx : BUCKETS - 1;
+    }
+
+    // 桶 idx 的上界
+    static unsigned long long upper(int idx) {
+        if (idx < 4) return idx + 1;
+
+        int msb = idx / 4 + 1;
+        return ((unsigned long long)(4 + idx % 4) << (msb - 2)) + (1ULL << (msb - 2));
+    }
+
+public:
+    Delay_Histogram() {
+        for (int i = 0; i < BUCKETS; ++i) m_buckets[i].store(0);
+    }
+
+    void add(long long us) {
+        m_buckets[index(us > 0 ? us : 0)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // 返回周期内样本的第 percent 百分位数（没有样本时返回 0），并把样本数写到 count
+    long long take_percentile(double percent, unsigned long long& count) {
+        unsigned long long snapshot[BUCKETS];
+        count = 0;
+        for (int i = 0; i < BUCKETS; ++i) {
+            snapshot[i] = m_buckets[i].exchange(0, std::memory_order_relaxed);
+            count += snapshot[i];
+        }
+        if (count == 0) return 0;
+
+        unsigned long long rank = (unsigned long long)(count * percent / 100.0);
+        unsigned long long seen = 0;
+        for (int i = 0; i < BUCKETS; ++i) {
+            seen += snapshot[i];
+            if (seen > rank) return (long long)upper(i);
+        }
+        return (long long)upper(BUCKETS - 1);
+    }
+};
+
+
+// 4. 按周期取排队延迟的 p95：距离上一次取出超过 interval_ms 时，才从直方图中取出这一个周期的 p95，否则返回上一个周期的值
+//    多个线程同时调用时，只有 CAS 成功的那个线程取出
+class Delay_Window {
+private:
+    std::atomic<long long> m_last_ns;       // 上一次取出的时间
+    std::atomic<long long> m_p95_us;        // 上一个周期的 p95
+
+public:
+    Delay_Window() : m_last_ns(monotonic_ns()), m_p95_us(0) {}
+
+    long long p95(Delay_Histogram& delay, int interval_ms) {
+        long long now = monotonic_ns();
+        long long last = m_last_ns.load();
+        if (now - last >= interval_ms * 1000000LL && m_last_ns.compare_exchange_strong(last, now)) {
+            unsigned long long samples = 0;
+            m_p95_us.store(delay.take_percentile(95, samples));
+        }
+        return m_p95_us.load();
+    }
+};
+
+
+
+#endif
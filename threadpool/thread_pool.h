@@ -1,34 +1,80 @@
+// 线程池，任务分两个队列（lane）
+// 1. 快队列：新到达的请求都先进入快队列，由工作线程解析；静态文件请求在这里处理完
+// 2. 慢队列：request->process() 返回 false 的请求（需要访问数据库的 登录/注册）被放进慢队列，由普通线程继续处理
+// 3. 前 fast_threads 个线程只处理快队列，所以慢请求再多，也总有线程在处理静态文件请求；
+//    其余线程优先处理快队列，快队列为空时再处理慢队列
+// 4. 任务入队时记录时间，统计排队延迟和线程的忙碌比例；调用 set_adaptive() 后，统计线程每个周期检查一次：
+//    排队延迟的 p95 超过目标时扩容，线程大多空闲时缩容（只退出普通线程），线程数在 [min, max] 之间
+
 #ifndef THREAD_POOL_H
 #define THREAD_POOL_H
 
-#include <list>
+#include <atomic>
 #include <cstdio>
 #include <exception>
 #include <pthread.h>
 #include "../lock/locker.h"
-#include "../connectionpool/mysql_connection_pool.h"
+#include "../lock/mpmc_ring.h"
+#include "../log/log.h"
+#include "../metrics/probes.h"
+#include "pool_stats.h"
 
 
 template<typename T>
 class ThreadPool {
 private:
+    // 0. 队列中的任务，带有入队的时间
+    struct Task {
+        T* request;
+        long long enqueue_ns;
+    };
+
     // 1. 成员变量
     int m_thread_num;                   // 1.1 线程池中的线程数
-    int m_max_requests;                 // 1.2 请求队列中允许的最大请求数 
+    int m_max_requests;                 // 1.2 请求队列中允许的最大请求数
     pthread_t* m_threads;               // 1.3 描述线程池的线程数组
-    std::list<T*> m_workqueue;         // 1.4 请求队列
-    Mutex m_mutex;                      // 1.5 互斥锁
-    Sem m_sem;                          // 1.6 信号量
-    bool m_stop;                        // 1.7 是否结束线程
-    Connection_Pool* m_conn_pool;       // 1.8 连接池
+    Mpmc_Ring<Task> m_workqueue;        // 1.4 快队列，无锁环形队列
+    Mpmc_Ring<Task> m_slowqueue;        // 1.5 慢队列
+    int m_fast_threads;                 // 1.6 只处理快队列的线程数
+    std::atomic<int> m_next_index;      // 1.7 分配给工作线程的编号
+    bool m_stop;                        // 1.8 是否结束线程
+    void (*m_thread_init)();            // 1.9 工作线程启动时的回调，例如让线程独占一个数据库连接
+    void (*m_thread_exit)();            // 1.10 工作线程退出时的回调
+
+    // 1.11 睡眠：只处理快队列的线程和普通线程分别睡眠在两个 futex 上，只有确实有线程在睡眠时才唤醒
+    alignas(64) std::atomic<int> m_fast_sleepers;
+    Futex m_fast_event;
+    alignas(64) std::atomic<int> m_any_sleepers;
+    Futex m_any_event;
+
+    // 1.12 统计和自动伸缩
+    alignas(64) std::atomic<int> m_live_threads;            // 当前的线程数
+    std::atomic<int> m_retire;                              // 等待退出的线程数
+    std::atomic<long long> m_busy_ns;                       // 周期内所有线程处理任务的总时间
+    std::atomic<unsigned long long> m_tasks;                // 处理过的任务数
+    Delay_Histogram m_delay;                                // 周期内的排队延迟
+    int m_min_threads, m_max_threads;                       // 线程数的范围
+    int m_target_delay_us;                                  // 排队延迟 p95 的目标
+    int m_interval_ms;                                      // 统计周期
+    std::atomic<long long> m_delay_p95_us;                  // 上一个周期的 p95
+    std::atomic<int> m_utilization;                         // 上一个周期的忙碌比例（万分之一）
+    std::atomic<unsigned long long> m_grow_count, m_shrink_count;
 
 public:
-    // 2. 构造函数和析构函数
-    ThreadPool(Connection_Pool* conn_pool, int thread_num = 8, int max_requests = 1000);
+    // 2. 构造函数和析构函数，fast_threads 最多为 thread_num - 1，至少留一个线程处理慢队列
+    ThreadPool(int thread_num = 8, int max_requests = 1000, void (*thread_init)() = NULL, void (*thread_exit)() = NULL,
+               int fast_threads = 0);
     ~ThreadPool();
 
-    // 3. 往请求队列中添加任务
+    // 3. 往请求队列中添加任务；append_batch 一次添加多个，返回实际添加的个数（队列满时少于 n）
     bool append(T* request);
+    int append_batch(T** requests, int n);
+
+    // 4. 打开自动伸缩：线程数在 [min_threads, max_threads] 之间，排队延迟的 p95 超过 target_delay_us 时扩容
+    void set_adaptive(int min_threads, int max_threads, int target_delay_us, int interval_ms = 1000);
+
+    // 5. 统计快照
+    void get_stats(Pool_Stats& stats);
 
 private:
     // 4. 工作线程运行的函数，在C++中，pthread_create的第3个参数必须是静态函数，所以这里用static修饰
@@ -36,19 +82,41 @@ private:
 
     // 5. run()
     void run();
+
+    // 6. 取任务，两个队列都为空时睡眠；普通线程收到退出通知时返回 false
+    bool take(bool fast_only, Task& task);
+    bool try_retire(bool fast_only);
+
+    // 6. 新建 n 个工作线程，返回成功的个数
+    int spawn(int n);
+
+    // 6. 统计线程：每个周期计算排队延迟和忙碌比例，决定 扩容/缩容
+    static void* monitor(void* arg);
+    void run_monitor();
+
+    // 7. 快队列/慢队列 新增了 n 个任务，唤醒最多 n 个可以处理它们的睡眠线程
+    void wake_fast(int n);
+    void wake_slow(int n);
 };
 
 
 
 // 2. 构造函数和析构函数
 template<typename T>
-ThreadPool<T>::ThreadPool(Connection_Pool* conn_pool, int thread_num, int max_requests) 
-    : m_thread_num(thread_num), m_max_requests(max_requests), m_threads(NULL), m_stop(false), m_conn_pool(conn_pool)
+ThreadPool<T>::ThreadPool(int thread_num, int max_requests, void (*thread_init)(), void (*thread_exit)(), int fast_threads)
+    : m_thread_num(thread_num), m_max_requests(max_requests), m_threads(NULL), m_workqueue(max_requests),
+      m_slowqueue(max_requests), m_fast_threads(fast_threads), m_next_index(0), m_stop(false),
+      m_thread_init(thread_init), m_thread_exit(thread_exit), m_fast_sleepers(0), m_any_sleepers(0),
+      m_live_threads(0), m_retire(0), m_busy_ns(0), m_tasks(0), m_min_threads(thread_num), m_max_threads(thread_num),
+      m_target_delay_us(0), m_interval_ms(0), m_delay_p95_us(0), m_utilization(0), m_grow_count(0), m_shrink_count(0)
 {
     if ((thread_num <= 0) || (max_requests <= 0)) {
         throw std::exception();
     }
 
+    if (m_fast_threads < 0) m_fast_threads = 0;
+    if (m_fast_threads > thread_num - 1) m_fast_threads = thread_num - 1;
+
     m_threads = new pthread_t[thread_num];
     if (m_threads == NULL) {
         throw std::exception();
@@ -71,8 +139,9 @@ ThreadPool<T>::ThreadPool(Connection_Pool* conn_pool, int thread_num, int max_re
         }
         ++count;
     }
+    m_live_threads.store(count);
 
-    LOG_INFO("success create thread num: %d, failed num: %d", count, m_thread_num - count);
+    LOG_INFO("success create thread num: %d, failed num: %d, fast lane threads: %d", count, m_thread_num - count, m_fast_threads);
 }
 
 template<typename T>
@@ -82,25 +151,48 @@ ThreadPool<T>::~ThreadPool() {
 }
 
 
-// 3. 往请求队列中添加任务
+// 3. 往请求队列中添加任务，新任务都进入快队列
 template<typename T>
 bool ThreadPool<T>::append(T* request) {
-    // 操作工作队列时一定要加锁，因为它被所有线程共享
-    m_mutex.lock();
-
-    if (m_workqueue.size() > m_max_requests) {
-        m_mutex.unlock();
+    // 工作队列被所有线程共享，但它是无锁的；队列满时返回 false
+    Task task = {request, monotonic_ns()};
+    if (!m_workqueue.try_push(task)) {
         return false;
     }
+    SERVER_PROBE1(queue_append, request->m_sockfd);
 
-    m_workqueue.push_back(request);
-    m_mutex.unlock();
-    m_sem.post_sem();
-    
-    LOG_INFO("thread_pool append request is ok, connfd: %d", request->m_sockfd);
+    wake_fast(1);
+
+    LOG_DEBUG("thread_pool append request is ok, connfd: %d", request->m_sockfd);
     return true;
 }
 
+// 3. 一次 CAS 放入整批任务，最多唤醒 min(n, 睡眠的线程数) 个线程
+template<typename T>
+int ThreadPool<T>::append_batch(T** requests, int n) {
+    static const int CHUNK = 64;
+    Task tasks[CHUNK];
+    long long now = monotonic_ns();
+
+    int count = 0;
+    while (count < n) {
+        int k = (n - count < CHUNK) ? n - count : CHUNK;
+        for (int i = 0; i < k; ++i) {
+            tasks[i].request = requests[count + i];
+            tasks[i].enqueue_ns = now;
+        }
+
+        int pushed = m_workqueue.try_push_bulk(tasks, k);
+        for (int i = 0; i < pushed; ++i) SERVER_PROBE1(queue_append, tasks[i].request->m_sockfd);
+        count += pushed;
+        if (pushed < k) break;
+    }
+    if (count > 0) wake_fast(count);
+
+    LOG_DEBUG("thread_pool append batch is ok, requests: %d, appended: %d", n, count);
+    return count;
+}
+
 
 // 4. 工作线程运行的函数，在C++中，pthread_create的第3个参数必须是静态函数，所以这里用static修饰
 // 4. 并且想要在class的静态函数中调用普通的成员函数，需要一些方法，具体看书 p304 页
@@ -111,28 +203,209 @@ void* ThreadPool<T>::worker(void* arg) {
     return pool;
 }
 
-// 5. run()
+// 5. run()：process() 返回 false 时，把请求放进慢队列；慢队列满时由当前线程直接处理
 template<typename T>
 void ThreadPool<T>::run() {
-    while (!m_stop) {
-        m_sem.wait_sem();
-        m_mutex.lock();
+    if (m_thread_init) m_thread_init();
 
-        if (m_workqueue.empty()) {
-            m_mutex.unlock();
-            continue;
+    bool fast_only = m_next_index.fetch_add(1) < m_fast_threads;
+
+    Task task;
+    while (!m_stop && take(fast_only, task)) {
+        long long begin = monotonic_ns();
+        m_delay.add((begin - task.enqueue_ns) / 1000);
+
+        T* request = task.request;
+        if (request) SERVER_PROBE2(queue_dequeue, request->m_sockfd, begin - task.enqueue_ns);
+        if (request && !request->process()) {
+            task.enqueue_ns = monotonic_ns();
+            if (m_slowqueue.try_push(task)) {
+                SERVER_PROBE1(queue_slow, request->m_sockfd);
+                wake_slow(1);
+            }
+            else {
+                request->process();
+            }
         }
 
-        T* request = m_workqueue.front();
-        m_workqueue.pop_front();
-        m_mutex.unlock();
+        m_busy_ns.fetch_add(monotonic_ns() - begin, std::memory_order_relaxed);
+        m_tasks.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if (m_thread_exit) m_thread_exit();
+}
+
+
+// 6. 取任务：先取快队列，再取慢队列（fast_only 的线程不取）；都为空时先登记，再检查一遍，最后才真正睡眠
+template<typename T>
+bool ThreadPool<T>::take(bool fast_only, Task& task) {
+    std::atomic<int>& sleepers = fast_only ? m_fast_sleepers : m_any_sleepers;
+    Futex& event = fast_only ? m_fast_event : m_any_event;
+
+    while (!m_stop && !try_retire(fast_only)) {
+        if (m_workqueue.try_pop(task)) return true;
+        if (!fast_only && m_slowqueue.try_pop(task)) return true;
+
+        int ticket = event.value();
+        sleepers.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        bool found = m_workqueue.try_pop(task) || (!fast_only && m_slowqueue.try_pop(task));
+        if (!found && (fast_only || m_retire.load() == 0)) event.wait(ticket);
+        sleepers.fetch_sub(1);
 
-        if (request) {
-            ConnectionRAII mysqlConn(&request->m_mysql, m_conn_pool); // 初始化：request->mysql，并且会自动释放该连接池
-            request->process();
+        if (found) return true;
+    }
+
+    return false;
+}
+
+// 6. 缩容时由普通线程领取退出通知
+template<typename T>
+bool ThreadPool<T>::try_retire(bool fast_only) {
+    if (fast_only) return false;
+
+    int retire = m_retire.load(std::memory_order_relaxed);
+    while (retire > 0) {
+        if (m_retire.compare_exchange_weak(retire, retire - 1)) {
+            m_live_threads.fetch_sub(1);
+            return true;
         }
     }
+    return false;
+}
+
+// 6. 新建的线程都是普通线程（m_next_index 已经超过 m_fast_threads）
+template<typename T>
+int ThreadPool<T>::spawn(int n) {
+    int count = 0;
+    for (int i = 0; i < n; ++i) {
+        pthread_t tid;
+        if (pthread_create(&tid, NULL, worker, (void*)this) != 0) {
+            LOG_ERROR("create worker thread is error");
+            break;
+        }
+        pthread_detach(tid);
+        ++count;
+    }
+
+    m_live_threads.fetch_add(count);
+    return count;
+}
+
+
+// 4. 打开自动伸缩，启动统计线程
+template<typename T>
+void ThreadPool<T>::set_adaptive(int min_threads, int max_threads, int target_delay_us, int interval_ms) {
+    if (m_interval_ms > 0 || interval_ms <= 0 || target_delay_us <= 0) return;
+
+    m_min_threads = (min_threads > m_fast_threads + 1) ? min_threads : m_fast_threads + 1;
+    m_max_threads = (max_threads > m_min_threads) ? max_threads : m_min_threads;
+    m_target_delay_us = target_delay_us;
+    m_interval_ms = interval_ms;
+
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, monitor, (void*)this) != 0) {
+        LOG_ERROR("create monitor thread is error");
+        m_interval_ms = 0;
+        return;
+    }
+    pthread_detach(tid);
+
+    LOG_INFO("thread_pool adaptive is on, threads: [%d, %d], target p95 delay: %dus, interval: %dms",
+             m_min_threads, m_max_threads, m_target_delay_us, m_interval_ms);
+}
+
+template<typename T>
+void* ThreadPool<T>::monitor(void* arg) {
+    ThreadPool* pool = (ThreadPool*)arg;
+    pool->run_monitor();
+    return pool;
+}
+
+// 6. 每个周期：
+//    1. p95 超过目标，且线程都比较忙时（排除只是偶尔排队的情况），扩容 1/4，至少一个
+//    2. 忙碌比例低于 30%，且 p95 低于目标的一半时，缩容一个
+template<typename T>
+void ThreadPool<T>::run_monitor() {
+    long long last = monotonic_ns();
+    m_busy_ns.store(0);
+
+    while (!m_stop) {
+        usleep(m_interval_ms * 1000);
+
+        long long now = monotonic_ns();
+        long long busy = m_busy_ns.exchange(0);
+        int live = m_live_threads.load();
+        unsigned long long samples = 0;
+        long long p95 = m_delay.take_percentile(95, samples);
+
+        double utilization = (live > 0 && now > last) ? (double)busy / ((double)(now - last) * live) : 0;
+        if (utilization > 1) utilization = 1;
+        last = now;
+
+        m_delay_p95_us.store(p95);
+        m_utilization.store((int)(utilization * 10000));
+
+        if (p95 > m_target_delay_us && utilization > 0.5 && live < m_max_threads) {
+            int n = live / 4 > 0 ? live / 4 : 1;
+            if (live + n > m_max_threads) n = m_max_threads - live;
+
+            n = spawn(n);
+            m_grow_count.fetch_add(1);
+            LOG_INFO("thread_pool grow: p95 delay %lldus, utilization %.2f, threads %d -> %d", p95, utilization, live, live + n);
+        }
+        else if (utilization < 0.3 && p95 < m_target_delay_us / 2 && live - m_retire.load() > m_min_threads) {
+            m_retire.fetch_add(1);
+            m_any_event.post(m_any_sleepers.load() + 1);
+            m_shrink_count.fetch_add(1);
+            LOG_INFO("thread_pool shrink: p95 delay %lldus, utilization %.2f, threads %d -> %d", p95, utilization, live, live - 1);
+        }
+    }
+}
+
+
+// 5. 统计快照
+template<typename T>
+void ThreadPool<T>::get_stats(Pool_Stats& stats) {
+    stats.threads = m_live_threads.load();
+    stats.min_threads = m_min_threads;
+    stats.max_threads = m_max_threads;
+    stats.queue_size = m_workqueue.size() + m_slowqueue.size();
+    stats.delay_p95_us = m_delay_p95_us.load();
+    stats.utilization = m_utilization.load() / 10000.0;
+    stats.tasks = m_tasks.load();
+    stats.grow_count = m_grow_count.load();
+    stats.shrink_count = m_shrink_count.load();
+}
+
+
+// 7. 与 take() 中睡眠前的 fetch_add 配对：要么这里看到有线程在睡眠，要么那个线程睡眠前能看到新的任务
+// 7. 快队列的任务优先唤醒只处理快队列的线程，不够时再唤醒普通线程
+template<typename T>
+void ThreadPool<T>::wake_fast(int n) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    int fast = m_fast_sleepers.load(std::memory_order_relaxed);
+    if (fast > 0) {
+        if (fast > n) fast = n;
+        m_fast_event.post(fast);
+        n -= fast;
+    }
+
+    if (n > 0) {
+        int any = m_any_sleepers.load(std::memory_order_relaxed);
+        if (any > 0) m_any_event.post(n < any ? n : any);
+    }
+}
+
+template<typename T>
+void ThreadPool<T>::wake_slow(int n) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    int any = m_any_sleepers.load(std::memory_order_relaxed);
+    if (any > 0) m_any_event.post(n < any ? n : any);
 }
 
 
-#endif
\ No newline at end of file
+#endif
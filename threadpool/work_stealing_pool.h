@@ -0,0 +1,317 @@
+// 工作窃取线程池，接口与 ThreadPool 相同
+// 1. 每个工作线程有自己的 Chase_Lev_Deque，主线程（reactor）轮流往各个队列中投递任务，没有共享的锁和队列
+// 2. 工作线程先取自己的队列，空了再随机窃取其他线程的队列
+// 3. 没有任务时先自旋一会儿，再在自己的 futex 上睡眠；append() 只在确实有线程睡眠时才发起唤醒
+// 4. 与 ThreadPool 一样有一个共享的慢队列：process() 返回 false 的请求放进慢队列，前 fast_threads 个线程不处理慢队列
+// 5. 线程数固定：每个线程的 deque 是在构造时分配的，set_adaptive() 只记录一条日志，get_stats() 中的线程数范围就是 thread_num
+// 6. 任务带有入队的时间，工作线程取出时记录排队延迟，get_stats() 每 STATS_INTERVAL_MS 取一次 p95
+// 注意：append() 只能由同一个线程调用（Chase_Lev_Deque 的所有者）
+
+#ifndef WORK_STEALING_POOL_H
+#define WORK_STEALING_POOL_H
+
+#include <atomic>
+#include <cstdio>
+#include <exception>
+#include <pthread.h>
+#include <unistd.h>
+#include "chase_lev_deque.h"
+#include "../lock/locker.h"
+#include "../lock/mpmc_ring.h"
+#include "../log/log.h"
+#include "pool_stats.h"
+
+
+template<typename T>
+class Work_Stealing_Pool {
+private:
+    // 0. 慢队列中的任务，带有入队的时间
+    struct Task {
+        T* request;
+        long long enqueue_ns;
+    };
+
+    // 1. 每个工作线程的数据，各占一个 cache line
+    struct alignas(64) Worker {
+        Work_Stealing_Pool* pool;           // 1.1 所属的线程池
+        int index;                          // 1.2 线程编号
+        pthread_t tid;                      // 1.3 线程 id
+        Chase_Lev_Deque<T*>* deque;         // 1.4 任务队列
+        Futex park;                         // 1.5 睡眠用的 futex
+        std::atomic<bool> parked;           // 1.6 是否在睡眠（或准备睡眠）
+        bool fast_only;                     // 1.7 是否只处理快队列（各个 deque）
+    };
+
+    static const int SPIN_COUNT = 64;       // 多核时睡眠前自旋查找任务的次数
+    static const int STATS_INTERVAL_MS = 1000;  // 排队延迟 p95 的统计周期
+
+    // 2. 成员变量
+    int m_thread_num;                       // 2.1 线程池中的线程数
+    int m_max_requests;                     // 2.2 所有队列中允许的最大请求数
+    Worker* m_workers;                      // 2.3 工作线程
+    Mpmc_Ring<Task> m_slowqueue;            // 2.4 慢队列
+    int m_spin_count;                       // 2.5 睡眠前自旋的次数，单核时自旋只会抢占主线程，为 0
+    alignas(64) std::atomic<int> m_idle;    // 2.6 正在睡眠的线程数
+    alignas(64) int m_next;                 // 2.7 下一个投递的队列，只有主线程访问
+    bool m_stop;                            // 2.8 是否结束线程
+    void (*m_thread_init)();                // 2.9 工作线程启动时的回调
+    void (*m_thread_exit)();                // 2.10 工作线程退出时的回调
+    std::atomic<unsigned long long> m_tasks;    // 2.11 处理过的任务数
+    Delay_Histogram m_delay;                // 2.12 周期内的排队延迟
+    Delay_Window m_delay_window;            // 2.13 按周期取出的 p95
+
+public:
+    // 3. 构造函数和析构函数
+    Work_Stealing_Pool(int thread_num = 8, int max_requests = 1000, void (*thread_init)() = NULL, void (*thread_exit)() = NULL,
+                       int fast_threads = 0);
+    ~Work_Stealing_Pool();
+
+    // 4. 往请求队列中添加任务；append_batch 一次添加多个，返回实际添加的个数（队列都满时少于 n）
+    bool append(T* request);
+    int append_batch(T** requests, int n);
+
+    // 4. 与 ThreadPool 的接口相同：不支持自动伸缩；统计快照
+    void set_adaptive(int min_threads, int max_threads, int target_delay_us, int interval_ms = 1000);
+    void get_stats(Pool_Stats& stats);
+
+private:
+    // 5. 工作线程运行的函数
+    static void* worker(void* arg);
+    void run(Worker* self);
+
+    // 6. 先取自己的队列，再从随机位置开始窃取其他队列，最后取慢队列；enqueue_ns 是任务入队的时间
+    T* find_task(Worker* self, unsigned int& seed, long long& enqueue_ns);
+
+    // 7. 唤醒最多 n 个正在睡眠的线程，优先从 preferred 开始；slow 为 true 时只唤醒能处理慢队列的线程
+    void wake(int preferred, int n, bool slow = false);
+
+    // 8. 投递一个任务，返回投递到的队列，全都满了返回 -1
+    int push(T* request, long long now);
+};
+
+
+
+// 3. 构造函数和析构函数
+template<typename T>
+Work_Stealing_Pool<T>::Work_Stealing_Pool(int thread_num, int max_requests, void (*thread_init)(), void (*thread_exit)(),
+                                          int fast_threads)
+    : m_thread_num(thread_num), m_max_requests(max_requests), m_workers(NULL), m_slowqueue(max_requests), m_spin_count(0),
+      m_idle(0), m_next(0), m_stop(false),
+      m_thread_init(thread_init), m_thread_exit(thread_exit), m_tasks(0)
+{
+    if ((thread_num <= 0) || (max_requests <= 0)) {
+        throw std::exception();
+    }
+
+    if (sysconf(_SC_NPROCESSORS_ONLN) > 1) m_spin_count = SPIN_COUNT;
+
+    int capacity = (max_requests + thread_num - 1) / thread_num;
+    m_workers = new Worker[thread_num];
+    for (int i = 0; i < thread_num; ++i) {
+        m_workers[i].pool = this;
+        m_workers[i].index = i;
+        m_workers[i].deque = new Chase_Lev_Deque<T*>(capacity);
+        m_workers[i].parked.store(false);
+        m_workers[i].fast_only = (i < fast_threads && i < thread_num - 1);
+    }
+
+    int count = 0;
+    for (int i = 0; i < m_thread_num; ++i) {
+        if (pthread_create(&m_workers[i].tid, NULL, worker, m_workers + i) != 0) {
+            LOG_ERROR("create the %dth thread is error", i + 1);
+            continue;
+        }
+
+        if (pthread_detach(m_workers[i].tid) != 0) {
+            throw std::exception();
+        }
+        ++count;
+    }
+
+    LOG_INFO("success create work stealing thread num: %d, failed num: %d", count, m_thread_num - count);
+}
+
+template<typename T>
+Work_Stealing_Pool<T>::~Work_Stealing_Pool() {
+    m_stop = true;
+    for (int i = 0; i < m_thread_num; ++i) {
+        m_workers[i].park.post();
+    }
+}
+
+
+// 4. 往请求队列中添加任务：轮流投递，目标队列满了就投递到下一个，全都满了返回 false
+template<typename T>
+bool Work_Stealing_Pool<T>::append(T* request) {
+    int target = push(request, monotonic_ns());
+    if (target < 0) return false;
+
+    wake(target, 1);
+
+    LOG_DEBUG("work stealing pool append request is ok, connfd: %d, worker: %d", request->m_sockfd, target);
+    return true;
+}
+
+
+// 4. 先把整批任务轮流放进各个队列，最后只做一次唤醒，最多唤醒 min(n, 睡眠的线程数) 个线程
+template<typename T>
+int Work_Stealing_Pool<T>::append_batch(T** requests, int n) {
+    int count = 0, first = -1;
+    long long now = monotonic_ns();
+    for (; count < n; ++count) {
+        int target = push(requests[count], now);
+        if (target < 0) break;
+        if (first < 0) first = target;
+    }
+
+    if (count > 0) wake(first, count);
+
+    LOG_DEBUG("work stealing pool append batch is ok, requests: %d, appended: %d", n, count);
+    return count;
+}
+
+// 4. 线程数固定
+template<typename T>
+void Work_Stealing_Pool<T>::set_adaptive(int min_threads, int max_threads, int target_delay_us, int interval_ms) {
+    LOG_WARN("work stealing pool has a fixed size, ignore adaptive threads: [%d, %d]", min_threads, max_threads);
+}
+
+// 4. 统计快照：忙碌比例没有统计，为 0
+template<typename T>
+void Work_Stealing_Pool<T>::get_stats(Pool_Stats& stats) {
+    memset(&stats, 0, sizeof(stats));
+    stats.threads = stats.min_threads = stats.max_threads = m_thread_num;
+
+    for (int i = 0; i < m_thread_num; ++i) stats.queue_size += (int)m_workers[i].deque->size();
+    stats.queue_size += m_slowqueue.size();
+    stats.delay_p95_us = m_delay_window.p95(m_delay, STATS_INTERVAL_MS);
+    stats.tasks = m_tasks.load();
+}
+
+// 8. 从 m_next 开始轮流投递，目标队列满了就投递到下一个，全都满了返回 -1，否则返回投递到的队列
+template<typename T>
+int Work_Stealing_Pool<T>::push(T* request, long long now) {
+    for (int i = 0; i < m_thread_num; ++i) {
+        int index = m_next;
+        m_next = (m_next + 1 == m_thread_num) ? 0 : m_next + 1;
+
+        if (m_workers[index].deque->push(request, now)) return index;
+    }
+
+    return -1;
+}
+
+
+// 5. 工作线程运行的函数
+template<typename T>
+void* Work_Stealing_Pool<T>::worker(void* arg) {
+    Worker* self = (Worker*)arg;
+    self->pool->run(self);
+    return self->pool;
+}
+
+template<typename T>
+void Work_Stealing_Pool<T>::run(Worker* self) {
+    if (m_thread_init) m_thread_init();
+
+    unsigned int seed = self->index * 2654435761u + 1;
+    long long enqueue_ns = 0;
+
+    while (!m_stop) {
+        // 5.1 查找任务，找不到时先自旋一会儿
+        T* request = find_task(self, seed, enqueue_ns);
+        for (int spin = 0; spin < m_spin_count && request == NULL; ++spin) {
+            request = find_task(self, seed, enqueue_ns);
+            if (request == NULL) cpu_relax();
+        }
+
+        // 5.2 准备睡眠：先登记，再检查一遍，最后才真正睡眠
+        if (request == NULL) {
+            int ticket = self->park.value();
+            self->parked.store(true);
+            m_idle.fetch_add(1);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            request = find_task(self, seed, enqueue_ns);
+            if (request == NULL && !m_stop) {
+                self->park.wait(ticket);
+            }
+
+            self->parked.store(false);
+            m_idle.fetch_sub(1);
+        }
+
+        // 5.3 记录排队延迟；需要放到慢队列的请求，慢队列满时由当前线程直接处理
+        if (request) m_delay.add((monotonic_ns() - enqueue_ns) / 1000);
+        if (request && !request->process()) {
+            Task task = {request, monotonic_ns()};
+            if (m_slowqueue.try_push(task)) {
+                wake(self->index, 1, true);
+            }
+            else {
+                request->process();
+            }
+        }
+        if (request) m_tasks.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if (m_thread_exit) m_thread_exit();
+}
+
+
+// 6. 先取自己的队列，再从随机位置开始窃取其他队列；竞争失败时说明队列中可能还有任务，重新扫描
+template<typename T>
+T* Work_Stealing_Pool<T>::find_task(Worker* self, unsigned int& seed, long long& enqueue_ns) {
+    T* request = NULL;
+
+    while (true) {
+        bool aborted = false;
+
+        typename Chase_Lev_Deque<T*>::STEAL_STATUS status = self->deque->steal(request, &enqueue_ns);
+        if (status == Chase_Lev_Deque<T*>::STEAL_OK) return request;
+        if (status == Chase_Lev_Deque<T*>::STEAL_ABORT) aborted = true;
+
+        seed = seed * 1103515245u + 12345u;
+        int start = (seed >> 16) % m_thread_num;
+        for (int i = 0; i < m_thread_num; ++i) {
+            Worker* victim = m_workers + (start + i) % m_thread_num;
+            if (victim == self) continue;
+
+            status = victim->deque->steal(request, &enqueue_ns);
+            if (status == Chase_Lev_Deque<T*>::STEAL_OK) return request;
+            if (status == Chase_Lev_Deque<T*>::STEAL_ABORT) aborted = true;
+        }
+
+        if (!aborted) break;
+    }
+
+    Task task;
+    if (!self->fast_only && m_slowqueue.try_pop(task)) {
+        enqueue_ns = task.enqueue_ns;
+        return task.request;
+    }
+    return NULL;
+}
+
+
+// 7. 唤醒最多 n 个正在睡眠的线程：优先唤醒拿到任务的那个线程，它没有睡眠时再找其他睡眠的线程来窃取
+// 7. 与 run() 中睡眠前的 ++m_idle 配对：要么这里看到有线程在睡眠，要么那个线程睡眠前能看到新的任务
+template<typename T>
+void Work_Stealing_Pool<T>::wake(int preferred, int n, bool slow) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_idle.load(std::memory_order_relaxed) <= 0) return;
+
+    for (int i = 0; i < m_thread_num && n > 0; ++i) {
+        Worker* w = m_workers + (preferred + i) % m_thread_num;
+        if (slow && w->fast_only) continue;
+
+        bool parked = true;
+        if (w->parked.load(std::memory_order_relaxed) && w->parked.compare_exchange_strong(parked, false)) {
+            w->park.post();
+            --n;
+        }
+    }
+}
+
+
+#endif
@@ -1,4 +1,5 @@
 #include "lst_timer.h"
+#include "../metrics/probes.h"
 
 
 // 1. 析构函数
@@ -45,7 +46,8 @@ void Sort_List_Timer::add_timer(Util_Timer* timer)
     // 4. 插入中间
     else add_timer(timer, head);
 
-    LOG_INFO("add timer is ok, sockfd: %d", timer->user_data->sockfd);
+    SERVER_PROBE2(timer_add, timer->user_data->sockfd, (long)timer->expire_time);
+    LOG_DEBUG("add timer is ok, sockfd: %d", timer->user_data->sockfd);
 }
 
 // 3. 删：将定时器从定时器链表中删除
@@ -80,7 +82,7 @@ void Sort_List_Timer::del_timer(Util_Timer* timer)
         delete timer;
     }
 
-    LOG_INFO("del timer is ok, sockfd: %d", timer->user_data->sockfd);
+    LOG_DEBUG("del timer is ok, sockfd: %d", timer->user_data->sockfd);
 }
 
 // 4. 改：调整定时器在定时器链表中的位置，并且只考虑定时器时间延长的情况
@@ -91,9 +93,11 @@ void Sort_List_Timer::adjust_timer(Util_Timer* timer)
         return;
     }
 
+    SERVER_PROBE2(timer_adjust, timer->user_data->sockfd, (long)timer->expire_time);
+
     Util_Timer* temp = timer->next;
     if ((temp == NULL) || (timer->expire_time < temp->expire_time)) {
-        LOG_INFO("not need adjust timer");
+        LOG_DEBUG("not need adjust timer");
         return;
     }
     if (timer == head) {
@@ -111,7 +115,7 @@ void Sort_List_Timer::adjust_timer(Util_Timer* timer)
         add_timer(timer, temp);
     }
 
-    LOG_INFO("adjust timer is ok, sockfd: %d", timer->user_data->sockfd);
+    LOG_DEBUG("adjust timer is ok, sockfd: %d", timer->user_data->sockfd);
 }
 
 // 5. tick函数: SIGALRM信号每次被触发，就在信号处理函数（主函数）中执行一次tick函数
@@ -120,7 +124,7 @@ void Sort_List_Timer::tick()
     if (head == NULL) return;
 
     // log
-    LOG_INFO("timer tick() once");
+    LOG_DEBUG("timer tick() once");
     int count = 0;
     Util_Timer* temp = head;
     time_t cur = time(NULL);   // 获得系统的当前时间
@@ -129,6 +133,7 @@ void Sort_List_Timer::tick()
         if (cur < temp->expire_time) break;
         ++count;
 
+        SERVER_PROBE2(timer_expire, temp->user_data->sockfd, (long)temp->expire_time);
         temp->cb_func(temp->user_data);
 
         head = temp->next;
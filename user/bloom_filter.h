@@ -0,0 +1,91 @@
+// Bloom 过滤器：回答“一定不存在”，用于注册时的重名检查，避免一次数据库点查
+// 1. 每个元素约 10 bit、7 个哈希函数，误判率约 1%
+// 2. 位数组用 atomic 保存，add 和 may_contain 可以被多个线程同时调用
+
+#ifndef BLOOM_FILTER_H
+#define BLOOM_FILTER_H
+
+#include <atomic>
+#include <string>
+#include <stdint.h>
+
+
+class Bloom_Filter {
+private:
+    // 1. 成员变量
+    std::atomic<uint64_t>* m_bits;      // 1.1 位数组
+    uint64_t m_bit_num;                 // 1.2 位数，2 的整数次幂
+    int m_hash_num;                     // 1.3 哈希函数的个数
+
+
+public:
+    // 2. 构造函数和析构函数，expected 为预计的元素个数
+    Bloom_Filter(uint64_t expected, int bits_per_item = 10, int hash_num = 7) : m_hash_num(hash_num)
+    {
+        uint64_t need = (expected < 1024 ? 1024 : expected) * bits_per_item;
+        m_bit_num = 64;
+        while (m_bit_num < need) m_bit_num <<= 1;
+
+        m_bits = new std::atomic<uint64_t>[m_bit_num / 64];
+        for (uint64_t i = 0; i < m_bit_num / 64; ++i) {
+            m_bits[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    ~Bloom_Filter() {
+        delete[] m_bits;
+    }
+
+    // 3. 添加一个元素
+    void add(const std::string& key) {
+        uint64_t h1 = 0, h2 = 0;
+        hash(key, h1, h2);
+
+        for (int i = 0; i < m_hash_num; ++i) {
+            uint64_t bit = (h1 + i * h2) & (m_bit_num - 1);
+            m_bits[bit >> 6].fetch_or(1ULL << (bit & 63), std::memory_order_relaxed);
+        }
+    }
+
+    // 4. 返回 false 表示一定不存在，返回 true 表示可能存在
+    bool may_contain(const std::string& key) const {
+        uint64_t h1 = 0, h2 = 0;
+        hash(key, h1, h2);
+
+        for (int i = 0; i < m_hash_num; ++i) {
+            uint64_t bit = (h1 + i * h2) & (m_bit_num - 1);
+            if (!(m_bits[bit >> 6].load(std::memory_order_relaxed) & (1ULL << (bit & 63)))) return false;
+        }
+
+        return true;
+    }
+
+    // 5. 占用的字节数
+    uint64_t bytes() const { return m_bit_num / 8; }
+
+
+private:
+    // 6. 双重哈希：FNV-1a 得到 h1，再用 splitmix64 混合得到 h2（奇数，保证能遍历所有位）
+    static void hash(const std::string& key, uint64_t& h1, uint64_t& h2) {
+        uint64_t h = 14695981039346656037ULL;
+        for (size_t i = 0; i < key.size(); ++i) {
+            h ^= (unsigned char)key[i];
+            h *= 1099511628211ULL;
+        }
+
+        uint64_t z = h + 0x9e3779b97f4a7c15ULL;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        z = z ^ (z >> 31);
+
+        h1 = h;
+        h2 = z | 1;
+    }
+
+    Bloom_Filter(const Bloom_Filter&);
+    Bloom_Filter& operator=(const Bloom_Filter&);
+};
+
+
+
+#endif
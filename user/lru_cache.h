@@ -0,0 +1,80 @@
+// 有容量上限的 LRU 缓存，按需加载用户表时缓存最近访问的 用户名 -> 密码
+
+#ifndef LRU_CACHE_H
+#define LRU_CACHE_H
+
+#include <list>
+#include <utility>
+#include <unordered_map>
+#include "../lock/locker.h"
+
+
+template<typename K, typename V>
+class LRU_Cache {
+private:
+    typedef std::list<std::pair<K, V> > Item_List;
+
+    // 1. 成员变量
+    Item_List m_items;                                              // 1.1 最近访问的在表头
+    std::unordered_map<K, typename Item_List::iterator> m_index;    // 1.2 key -> 链表节点
+    size_t m_capacity;                                              // 1.3 最多缓存多少项
+    Adaptive_Mutex m_mutex;                                         // 1.4 互斥锁：临界区只有几次哈希表和链表操作，先自旋再睡眠
+
+
+public:
+    // 2. 构造函数
+    LRU_Cache(size_t capacity) : m_capacity(capacity == 0 ? 1 : capacity) {}
+
+    // 3. 查找，命中时把该项移到表头
+    bool get(const K& key, V& value) {
+        m_mutex.lock();
+
+        typename std::unordered_map<K, typename Item_List::iterator>::iterator it = m_index.find(key);
+        if (it == m_index.end()) {
+            m_mutex.unlock();
+            return false;
+        }
+
+        m_items.splice(m_items.begin(), m_items, it->second);
+        value = it->second->second;
+
+        m_mutex.unlock();
+        return true;
+    }
+
+    // 4. 插入或更新，超过容量时淘汰表尾
+    void put(const K& key, const V& value) {
+        m_mutex.lock();
+
+        typename std::unordered_map<K, typename Item_List::iterator>::iterator it = m_index.find(key);
+        if (it != m_index.end()) {
+            it->second->second = value;
+            m_items.splice(m_items.begin(), m_items, it->second);
+            m_mutex.unlock();
+            return;
+        }
+
+        m_items.push_front(std::make_pair(key, value));
+        m_index[key] = m_items.begin();
+
+        if (m_items.size() > m_capacity) {
+            m_index.erase(m_items.back().first);
+            m_items.pop_back();
+        }
+
+        m_mutex.unlock();
+    }
+
+    // 5. 当前缓存的项数
+    size_t size() {
+        m_mutex.lock();
+        size_t size = m_items.size();
+        m_mutex.unlock();
+
+        return size;
+    }
+};
+
+
+
+#endif
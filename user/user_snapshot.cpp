@@ -0,0 +1,201 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "user_snapshot.h"
+#include "../log/log.h"
+
+
+static const char SNAPSHOT_MAGIC[8] = {'U', 'S', 'E', 'R', 'S', 'N', 'A', 'P'};
+
+
+
+// 1. 打开并校验快照：只检查文件头和各区域的边界，不读取整个文件，所以启动时间与用户数无关
+bool User_Snapshot::open(const char* path) {
+    close();
+
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(Snapshot_Header)) {
+        ::close(fd);
+        return false;
+    }
+
+    char* addr = (char*)mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) return false;
+
+    const Snapshot_Header* header = (const Snapshot_Header*)addr;
+    uint64_t size = st.st_size;
+    bool ok = memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) == 0
+              && header->version == VERSION
+              && header->header_size == sizeof(Snapshot_Header)
+              && header->bucket_num != 0 && (header->bucket_num & (header->bucket_num - 1)) == 0
+              && header->user_num < header->bucket_num
+              && header->index_offset == sizeof(Snapshot_Header)
+              && header->arena_offset == header->index_offset + header->bucket_num * sizeof(Snapshot_Slot)
+              && header->arena_offset + header->arena_size == size;
+
+    if (!ok) {
+        LOG_ERROR("user snapshot %s is invalid", path);
+        munmap(addr, st.st_size);
+        return false;
+    }
+
+    // 查询是随机访问，关闭预读
+    madvise(addr, st.st_size, MADV_RANDOM);
+
+    m_addr = addr;
+    m_size = st.st_size;
+    m_header = header;
+    m_slots = (const Snapshot_Slot*)(addr + header->index_offset);
+    m_arena = addr + header->arena_offset;
+
+    return true;
+}
+
+void User_Snapshot::close() {
+    if (m_addr) {
+        munmap(m_addr, m_size);
+        m_addr = NULL;
+        m_size = 0;
+        m_header = NULL;
+        m_slots = NULL;
+        m_arena = NULL;
+    }
+}
+
+
+// 2. 查询：线性探测，遇到空槽说明不存在；open() 不检查索引，损坏的文件可能没有空槽，最多探测 bucket_num 次
+bool User_Snapshot::find(const string& name, string& password) const {
+    if (m_header == NULL) return false;
+
+    uint64_t h = hash(name.c_str(), name.size());
+    uint64_t mask = m_header->bucket_num - 1;
+
+    uint64_t i = h & mask;
+    for (uint64_t n = 0; n < m_header->bucket_num; ++n, i = (i + 1) & mask) {
+        const Snapshot_Slot& slot = m_slots[i];
+        if (slot.hash == 0) return false;
+
+        if (slot.hash == h && slot.name_len == name.size()
+            && slot.offset + slot.name_len + slot.password_len <= m_header->arena_size
+            && memcmp(m_arena + slot.offset, name.c_str(), slot.name_len) == 0)
+        {
+            password.assign(m_arena + slot.offset + slot.name_len, slot.password_len);
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// 3. FNV-1a
+uint64_t User_Snapshot::hash(const char* str, size_t len) {
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; ++i) {
+        h ^= (unsigned char)str[i];
+        h *= 1099511628211ULL;
+    }
+
+    return h == 0 ? 1 : h;
+}
+
+
+// 4. 写快照
+void Snapshot_Builder::add(uint64_t id, const char* name, size_t name_len, const char* password, size_t password_len) {
+    Snapshot_Slot entry;
+    entry.hash = User_Snapshot::hash(name, name_len);
+    entry.offset = m_arena.size();
+    entry.name_len = name_len;
+    entry.password_len = password_len;
+
+    m_arena.append(name, name_len);
+    m_arena.append(password, password_len);
+    m_entries.push_back(entry);
+
+    if (id > m_high_water_mark) m_high_water_mark = id;
+}
+
+bool Snapshot_Builder::finish(const char* path) {
+    // 4.1 装载因子不超过 0.5
+    uint64_t bucket_num = 16;
+    while (bucket_num < m_entries.size() * 2) bucket_num <<= 1;
+
+    vector<Snapshot_Slot> slots(bucket_num);
+    memset(&slots[0], 0, bucket_num * sizeof(Snapshot_Slot));
+    for (size_t i = 0; i < m_entries.size(); ++i) {
+        uint64_t j = m_entries[i].hash & (bucket_num - 1);
+        while (slots[j].hash != 0) j = (j + 1) & (bucket_num - 1);
+        slots[j] = m_entries[i];
+    }
+
+    Snapshot_Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.version = User_Snapshot::VERSION;
+    header.header_size = sizeof(Snapshot_Header);
+    header.user_num = m_entries.size();
+    header.bucket_num = bucket_num;
+    header.high_water_mark = m_high_water_mark;
+    header.index_offset = sizeof(Snapshot_Header);
+    header.arena_offset = header.index_offset + bucket_num * sizeof(Snapshot_Slot);
+    header.arena_size = m_arena.size();
+
+    // 4.2 先写临时文件，fsync 之后再 rename，崩溃时旧快照仍然完整
+    //     快照中是明文密码，只有属主可以读写；上次留下的临时文件 O_CREAT 不会改它的权限，所以再 fchmod 一次，
+    //     rename 之后替换旧快照的就是这个 0600 的文件
+    string tmp_path = string(path) + ".tmp";
+    int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        LOG_ERROR("open %s is error", tmp_path.c_str());
+        return false;
+    }
+    if (fchmod(fd, 0600) != 0) {
+        LOG_ERROR("chmod %s is error", tmp_path.c_str());
+        ::close(fd);
+        unlink(tmp_path.c_str());
+        return false;
+    }
+
+    struct Write_Part {
+        const void* base;
+        size_t len;
+    } parts[3] = {
+        {&header, sizeof(header)},
+        {&slots[0], bucket_num * sizeof(Snapshot_Slot)},
+        {m_arena.data(), m_arena.size()}
+    };
+
+    bool ok = true;
+    for (int i = 0; i < 3 && ok; ++i) {
+        const char* p = (const char*)parts[i].base;
+        size_t left = parts[i].len;
+        while (left > 0) {
+            ssize_t n = write(fd, p, left);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                ok = false;
+                break;
+            }
+            p += n;
+            left -= n;
+        }
+    }
+
+    if (ok && fsync(fd) != 0) ok = false;
+    ::close(fd);
+
+    if (!ok || rename(tmp_path.c_str(), path) != 0) {
+        LOG_ERROR("write user snapshot %s is error", path);
+        unlink(tmp_path.c_str());
+        return false;
+    }
+
+    return true;
+}
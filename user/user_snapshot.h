@@ -0,0 +1,91 @@
+// 用户表快照文件：启动时 mmap 进来即可查询，不需要再把整张表从数据库读一遍
+// 文件布局（小端）：
+//   Snapshot_Header
+//   Snapshot_Slot[bucket_num]     开放寻址（线性探测）的哈希索引，hash == 0 表示空槽
+//   arena                         字符串区，每个用户是 “用户名 + 密码” 连续存放，不带 '\0'
+// 快照按 user 表的自增列 id 记录高水位 high_water_mark，重启后只需要从数据库补 id > high_water_mark 的行
+
+#ifndef USER_SNAPSHOT_H
+#define USER_SNAPSHOT_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+using namespace std;
+
+
+// 1. 文件头
+struct Snapshot_Header {
+    char magic[8];                  // 1.1 "USERSNAP"
+    uint32_t version;               // 1.2 文件格式版本
+    uint32_t header_size;           // 1.3 sizeof(Snapshot_Header)
+    uint64_t user_num;              // 1.4 用户数
+    uint64_t bucket_num;            // 1.5 哈希索引的槽数，2 的整数次幂
+    uint64_t high_water_mark;       // 1.6 快照包含的最大 id
+    uint64_t index_offset;          // 1.7 哈希索引在文件中的偏移
+    uint64_t arena_offset;          // 1.8 字符串区在文件中的偏移
+    uint64_t arena_size;            // 1.9 字符串区的大小
+};
+
+// 2. 哈希索引的槽
+struct Snapshot_Slot {
+    uint64_t hash;                  // 2.1 用户名的哈希值，0 表示空槽
+    uint64_t offset;                // 2.2 用户名在字符串区中的偏移，密码紧跟在用户名后面
+    uint32_t name_len;              // 2.3 用户名长度
+    uint32_t password_len;          // 2.4 密码长度
+};
+
+
+// 3. 只读的快照，mmap 整个文件
+class User_Snapshot {
+private:
+    char* m_addr;                           // 3.1 mmap 的起始地址
+    size_t m_size;                          // 3.2 文件大小
+    const Snapshot_Header* m_header;        // 3.3 文件头
+    const Snapshot_Slot* m_slots;           // 3.4 哈希索引
+    const char* m_arena;                    // 3.5 字符串区
+
+public:
+    static const uint32_t VERSION = 1;
+
+    User_Snapshot() : m_addr(NULL), m_size(0), m_header(NULL), m_slots(NULL), m_arena(NULL) {}
+    ~User_Snapshot() { close(); }
+
+    // 3.6 打开并校验快照，失败时返回 false
+    bool open(const char* path);
+    void close();
+
+    // 3.7 查询用户名，存在时返回 true 并取出密码
+    bool find(const string& name, string& password) const;
+
+    uint64_t high_water_mark() const { return m_header ? m_header->high_water_mark : 0; }
+    uint64_t user_num() const { return m_header ? m_header->user_num : 0; }
+
+    // 3.8 用户名的哈希值，保证不为 0
+    static uint64_t hash(const char* str, size_t len);
+
+private:
+    User_Snapshot(const User_Snapshot&);
+};
+
+
+// 4. 写快照：逐行 add()，最后 finish() 写到 path.tmp，fsync 后再 rename 成 path，保证文件总是完整的
+class Snapshot_Builder {
+private:
+    string m_arena;                         // 4.1 字符串区
+    vector<Snapshot_Slot> m_entries;        // 4.2 每个用户一项，finish() 时再放进哈希索引
+    uint64_t m_high_water_mark;             // 4.3 最大 id
+
+public:
+    Snapshot_Builder() : m_high_water_mark(0) {}
+
+    void add(uint64_t id, const char* name, size_t name_len, const char* password, size_t password_len);
+    bool finish(const char* path);
+
+    uint64_t user_num() const { return m_entries.size(); }
+};
+
+
+
+#endif
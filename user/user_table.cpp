@@ -0,0 +1,238 @@
+#include "user_table.h"
+
+
+
+// 1. 单例模式
+User_Table* User_Table::get_instance() {
+    static User_Table user_table;
+    return &user_table;
+}
+
+User_Table::~User_Table() {
+    if (m_cache) delete m_cache;
+    // m_bloom 可能仍被后台扫描线程使用，进程退出时由系统回收
+}
+
+
+// 2. 初始化
+void User_Table::init(User_Store* store, bool lazy, int cache_size, const char* snapshot_path, int snapshot_interval) {
+    m_store = store;
+    m_is_lazy = lazy;
+
+    // 2.1 打开快照，并启动定期写快照的线程
+    if (snapshot_path != NULL) {
+        m_snapshot_path = snapshot_path;
+        m_snapshot_interval = snapshot_interval > 0 ? snapshot_interval : 600;
+
+        User_Snapshot* snapshot = new User_Snapshot();
+        if (snapshot->open(snapshot_path)) {
+            m_snapshot = snapshot;
+            LOG_INFO("open user snapshot %s is ok, users: %llu, high water mark: %llu", snapshot_path,
+                     (unsigned long long)m_snapshot->user_num(), (unsigned long long)m_snapshot->high_water_mark());
+        }
+        else {
+            delete snapshot;
+            LOG_INFO("no usable user snapshot %s", snapshot_path);
+        }
+
+        pthread_t tid;
+        if (pthread_create(&tid, NULL, snapshot_thread, this) == 0) pthread_detach(tid);
+        else LOG_ERROR("create user snapshot thread is error");
+    }
+
+    // 2.2 全量模式：有快照时只补读快照之后的行
+    if (!m_is_lazy) {
+        load_all();
+        return;
+    }
+
+    m_cache = new LRU_Cache<string, string>(cache_size);
+
+    // 2.3 用用户数估计 Bloom 过滤器的大小，留出一倍的余量给之后注册的用户
+    unsigned long long count = 0;
+    m_store->count_users(count);
+
+    // 2.4 先分配好 Bloom 过滤器，扫描期间注册的用户也会被加进去，所以不会漏掉
+    m_bloom = new Bloom_Filter(count * 2);
+
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, build_bloom_thread, this) != 0) {
+        LOG_ERROR("create bloom filter thread is error");
+        return;
+    }
+    pthread_detach(tid);
+
+    LOG_INFO("lazy user table, estimated users: %llu, cache size: %d, bloom filter bytes: %llu",
+             count, cache_size, (unsigned long long)m_bloom->bytes());
+}
+
+
+// 3. 全量模式：将所有用户名和密码取出，放入 m_users 中；有快照时只读取 id 大于快照高水位的行
+void User_Table::load_all() {
+    uint64_t after_id = m_snapshot != NULL ? m_snapshot->high_water_mark() : 0;
+
+    m_lock.write_lock();
+    if (!m_store->scan_users(after_id, load_row, this)) {
+        LOG_ERROR("load user table from %s is error", m_store->name());
+    }
+    LOG_INFO("load user table from %s is ok, users: %d, after id: %llu", m_store->name(), (int)m_users.size(),
+             (unsigned long long)after_id);
+    m_lock.unlock();
+}
+
+void User_Table::load_row(void* arg, uint64_t id, const char* name, size_t name_len, const char* password, size_t password_len) {
+    User_Table* user_table = (User_Table*)arg;
+    user_table->m_users[string(name, name_len)] = string(password, password_len);
+}
+
+// 3. 在 m_users 和快照中查找
+bool User_Table::find_local(const string& name, string& password) {
+    map<string, string>::iterator it = m_users.find(name);
+    if (it != m_users.end()) {
+        password = it->second;
+        return true;
+    }
+
+    return m_snapshot != NULL && m_snapshot->find(name, password);
+}
+
+
+// 4. 登录校验
+bool User_Table::verify(const string& name, const string& password) {
+    string real_password;
+
+    // 4.1 全量模式
+    if (!m_is_lazy) {
+        m_lock.read_lock();
+        bool ok = find_local(name, real_password) && (real_password == password);
+        m_lock.unlock();
+
+        return ok;
+    }
+
+    // 4.2 按需模式：缓存 -> 快照 -> Bloom 过滤器 -> 存储后端点查
+    if (m_cache->get(name, real_password)) return real_password == password;
+
+    if (m_snapshot != NULL && m_snapshot->find(name, real_password)) {
+        m_cache->put(name, real_password);
+        return real_password == password;
+    }
+
+    if (definitely_absent(name)) return false;
+
+    bool found = false;
+    if (!m_store->find_user(name, real_password, found) || !found) return false;
+
+    m_cache->put(name, real_password);
+    return real_password == password;
+}
+
+
+// 5. 注册：先检测是否有重名的，没有重名的，再插入存储后端
+//    访问存储后端（按需模式的点查、插入）时不持有 m_lock，全量模式的登录校验不用等数据库的往返
+bool User_Table::add_user(const string& name, const string& password) {
+    string real_password;
+
+    // 5.1 占住用户名：同名的注册正在进行，或者全量模式下内存中已经有这个用户名时失败
+    m_lock.write_lock();
+    bool exists = m_pending.count(name) > 0 || (!m_is_lazy && find_local(name, real_password));
+    if (!exists) m_pending.insert(name);
+    m_lock.unlock();
+
+    if (exists) return false;
+
+    // 5.2 按需模式：缓存 -> 快照 -> Bloom 过滤器 -> 存储后端点查
+    bool ok = true;
+    if (m_is_lazy) {
+        if (m_cache->get(name, real_password) || (m_snapshot != NULL && m_snapshot->find(name, real_password))) {
+            ok = false;
+        }
+        else if (!definitely_absent(name)) {
+            ok = m_store->find_user(name, real_password, exists) && !exists;
+        }
+    }
+
+    // 5.3 插入存储后端：同一个进程中的重名已经由 m_pending 排除，多个进程共用一张表时依靠 username 上的唯一约束
+    if (ok) ok = m_store->insert_user(name, password);
+
+    // 5.4 按需模式：先放进 Bloom 过滤器和缓存，再释放用户名，之后同名的注册一定能查到
+    if (ok && m_is_lazy) {
+        m_bloom->add(name);
+        m_cache->put(name, password);
+    }
+
+    m_lock.write_lock();
+    if (ok && !m_is_lazy) m_users.insert(pair<string, string>(name, password));
+    m_pending.erase(name);
+    m_lock.unlock();
+
+    return ok;
+}
+
+
+// 6. 按需模式：Bloom 过滤器扫描完成之前，不能断定用户名不存在
+bool User_Table::definitely_absent(const string& name) {
+    return m_bloom_ready.load(std::memory_order_acquire) && !m_bloom->may_contain(name);
+}
+
+
+// 7. 按需模式：后台流式扫描，逐行加入 Bloom 过滤器，不会把整张表放进内存
+void* User_Table::build_bloom_thread(void* arg) {
+    User_Table* user_table = (User_Table*)arg;
+    user_table->build_bloom();
+    return NULL;
+}
+
+void User_Table::build_bloom() {
+    unsigned long long count = 0;
+    void* args[2] = {this, &count};
+
+    if (!m_store->scan_users(0, bloom_row, args)) {
+        LOG_ERROR("build bloom filter from %s is error", m_store->name());
+        return;
+    }
+
+    m_bloom_ready.store(true, std::memory_order_release);
+    LOG_INFO("build bloom filter is ok, users: %llu", count);
+}
+
+void User_Table::bloom_row(void* arg, uint64_t id, const char* name, size_t name_len, const char* password, size_t password_len) {
+    void** args = (void**)arg;
+    User_Table* user_table = (User_Table*)args[0];
+
+    user_table->m_bloom->add(string(name, name_len));
+    ++*(unsigned long long*)args[1];
+}
+
+
+// 8. 定期写快照：没有可用的快照时立即写一份
+void* User_Table::snapshot_thread(void* arg) {
+    User_Table* user_table = (User_Table*)arg;
+
+    if (user_table->m_snapshot == NULL) user_table->write_snapshot();
+    while (true) {
+        sleep(user_table->m_snapshot_interval);
+        user_table->write_snapshot();
+    }
+
+    return NULL;
+}
+
+// 8. 流式扫描整张表写快照，进程中已经 mmap 的旧快照不受影响，下次启动时才会用到新快照
+bool User_Table::write_snapshot() {
+    Snapshot_Builder builder;
+    if (!m_store->scan_users(0, snapshot_row, &builder)) {
+        LOG_ERROR("write user snapshot is error, scan %s failed", m_store->name());
+        return false;
+    }
+
+    if (!builder.finish(m_snapshot_path.c_str())) return false;
+
+    LOG_INFO("write user snapshot %s is ok, users: %llu", m_snapshot_path.c_str(), (unsigned long long)builder.user_num());
+    return true;
+}
+
+void User_Table::snapshot_row(void* arg, uint64_t id, const char* name, size_t name_len, const char* password, size_t password_len) {
+    Snapshot_Builder* builder = (Snapshot_Builder*)arg;
+    builder->add(id, name, name_len, password, password_len);
+}
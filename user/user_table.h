@@ -0,0 +1,96 @@
+// 用户表：登录校验和注册，数据来自存储后端 User_Store（MySQL 或本地存储）
+// 1. 全量模式：启动时把整张 user 表读进 std::map（原来 HTTP_Conn::init_mysql_result() 的做法）
+// 2. 按需模式：启动时不读表，查询走有上限的 LRU 缓存，未命中时再到存储后端点查；
+//    后台线程流式扫描用户名建立 Bloom 过滤器，用来直接回答“用户名一定没有注册过”
+// 3. 快照（两种模式都可以打开）：后台线程定期把整张表写成可以 mmap 的快照文件，
+//    重启时 mmap 快照，只从数据库补读 id 大于快照高水位的行；要求 user 表有自增列 id
+
+#ifndef USER_TABLE_H
+#define USER_TABLE_H
+
+#include <map>
+#include <set>
+#include <string>
+#include <atomic>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "lru_cache.h"
+#include "bloom_filter.h"
+#include "user_snapshot.h"
+#include "../lock/locker.h"
+#include "../log/log.h"
+#include "../storage/user_store.h"
+
+using namespace std;
+
+
+
+class User_Table {
+private:
+    // 1. 成员变量
+    User_Store* m_store;                        // 1.1 存储后端
+    bool m_is_lazy;                             // 1.2 是否按需加载
+    map<string, string> m_users;                // 1.3 全量模式：所有的用户名和密码（加载了快照时只存快照之后的行）
+    Lock_Stats m_lock_stats;                    // 1.4 m_lock 的竞争统计
+    RW_Lock m_lock;                             // 1.4 保护 m_users 和 m_pending：登录校验加读锁；注册时只在检查重名、插入内存时加写锁（写优先）
+    set<string> m_pending;                      // 1.4 正在插入存储后端的用户名，同名的注册直接失败；插入存储后端时不持有 m_lock
+    LRU_Cache<string, string>* m_cache;         // 1.5 按需模式：用户名 -> 密码 的缓存
+    Bloom_Filter* m_bloom;                      // 1.6 按需模式：已注册用户名的 Bloom 过滤器
+    std::atomic<bool> m_bloom_ready;            // 1.7 Bloom 过滤器是否已经扫描完整张表
+    User_Snapshot* m_snapshot;                  // 1.8 启动时 mmap 的快照，NULL 表示没有可用的快照
+    string m_snapshot_path;                     // 1.9 快照文件路径，为空表示不使用快照
+    int m_snapshot_interval;                    // 1.10 定期写快照的间隔（秒）
+
+
+public:
+    // 2. 单例模式
+    static User_Table* get_instance();
+    ~User_Table();
+
+    // 3. 初始化，lazy 为 true 时按需加载，cache_size 为 LRU 缓存的容量
+    // 3. snapshot_path 不为 NULL 时使用快照，并每隔 snapshot_interval 秒重写一次
+    void init(User_Store* store, bool lazy = false, int cache_size = 100000,
+              const char* snapshot_path = NULL, int snapshot_interval = 600);
+
+    // 4. 登录校验：用户名存在且密码正确时返回 true
+    bool verify(const string& name, const string& password);
+
+    // 5. 注册：用户名没有重复且插入数据库成功时返回 true
+    bool add_user(const string& name, const string& password);
+
+    // 5. m_lock 的竞争统计
+    const Lock_Stats& lock_stats() { return m_lock_stats; }
+
+
+private:
+    User_Table() : m_store(NULL), m_is_lazy(false), m_lock(&m_lock_stats), m_cache(NULL), m_bloom(NULL), m_bloom_ready(false),
+                   m_snapshot(NULL), m_snapshot_interval(600) {}
+    User_Table(const User_Table&);
+
+    // 6. 全量模式：读取整张表；加载了快照时只读取 id 大于高水位的行
+    void load_all();
+
+    // 6. 在内存中的 m_users 和快照里查找（调用者持有 m_lock）
+    bool find_local(const string& name, string& password);
+
+    // 7. 按需模式：用户名是否一定不存在
+    bool definitely_absent(const string& name);
+
+    // 8. 按需模式：后台流式扫描用户名，建立 Bloom 过滤器
+    static void* build_bloom_thread(void* arg);
+    void build_bloom();
+
+    // 9. 定期写快照
+    static void* snapshot_thread(void* arg);
+    bool write_snapshot();
+
+    // 10. User_Store::scan_users() 的回调
+    static void load_row(void* arg, uint64_t id, const char* name, size_t name_len, const char* password, size_t password_len);
+    static void bloom_row(void* arg, uint64_t id, const char* name, size_t name_len, const char* password, size_t password_len);
+    static void snapshot_row(void* arg, uint64_t id, const char* name, size_t name_len, const char* password, size_t password_len);
+};
+
+
+
+#endif